@@ -67,19 +67,331 @@ MISC:
 --pgd
 	Start the population in a state of pseudo-gynodioecy, and attempt to invade males into it (rather than the default of starting with dioecy and attempting to invade inconstants into it).
 
+--bistable
+	Also run every cell from the other start (PGD as well as DIO, or vice versa) in the same pass, and save
+	a map of where the final state depends on the start: such cells are green in <name>_bistable.bmp, the
+	rest are coloured by regime as usual. The main outputs are unchanged. The grid engine runs both starts
+	as neighbouring lanes of the same tile.
+
+--basins <steps>
+	With --onerun, run the one cell from every start whose genotype frequencies are multiples of 1/<steps>
+	(e.g. 12 gives 125970 starts, and 16 gives 735471), in parallel, instead of from the usual start. Each start stops once it has
+	settled (as with --converge, so see --tolerance). Final states that agree to within 0.001 are taken to
+	be the same attractor; each attractor is listed with its regime and the share of the starts that reach
+	it, and the attractor (numbered as in the list) reached from each start is saved to
+	<name>_Q<Q>_F<F>_basins.txt. Starts that die out (e.g. with no pollen producers) or are still
+	changing at the last generation aren't attractors: they are counted separately, and numbered 0
+	in the file. With the default --tolerance of 0, slowly converging starts may not settle, so give
+	one (e.g. 1e-7). --engine grid runs the starts in tiles, which is much faster.
+
+--trajectory <k>
+	Also record the genotype frequencies every <k> generations (and at the start and the end) of the
+	--onerun cell, or of each cell picked by --trace, to <name>_Q<Q>_F<F>_trajectory.bin or
+	<name>_x<x>_y<y>_trajectory.bin. The records are kept in memory and written out 4096 at a time, so
+	this costs little even for long runs. The file is binary (a header, then for each record the
+	generation as an int and the frequencies as floats, or doubles for the higher precisions); print it
+	with --readtrajectory.
+
+--logtrajectory <n>
+	As --trajectory, but record <n> generations per decade, logarithmically spaced (e.g. with 10: 0, 1, 2,
+	3, 4, 5, 6, 8, 10, 13, 16, 20, 25, 32, 40, 50, 63, 79, 100...), for transients of long runs.
+
+--trace <x>,<y>
+	When drawing a graph with --trajectory or --logtrajectory, record this cell (x and y as in the graph,
+	from 0 at the bottom left). Can be given up to 16 times. The cells are run again after the graph.
+
+--readtrajectory <file>
+	Print a file saved by --trajectory as text (the generation, then the frequencies, one record per
+	line), and exit. The file is read through mmap, so large ones are quick to open.
+
 --iterations
 	Iterations before assuming equilibrium has been reached (default 10000, is usually sufficient).
 
+--precision <float|double|long double>
+	Floating point type to use for the genotype frequencies (default float). Higher precisions are slower,
+	but allow much smaller values of --threshold to be meaningful. ("long double" needs quotes.)
+
+--compareprecision <float|double|long double>
+	Also run every 16th cell in this precision, and report the largest difference in a genotype frequency
+	and the number of cells classified differently, e.g. --precision float --compareprecision double.
+
+--ftz
+	Have the processor treat subnormal (extremely small) numbers as zero. When a genotype is dying out,
+	its frequency eventually becomes subnormal, which can make the rest of that run many times slower.
+	Also sets an extinction limit of 1e-30 unless --extinction is given.
+
+--extinction <value>
+	Set any genotype frequency that falls below <value> to zero (default 0, i.e. never).
+
+--subnormals
+	Count and report the cells in which any genotype frequency became subnormal.
+
+--itermap
+	Also save a map of how many generations each cell took to converge, i.e. after which no genotype
+	frequency changed by more than the tolerance. Slow cells are light, fast ones dark (on a log scale);
+	cells still changing at the last iteration are red. The numbers are also saved as text (same layout
+	as --gnuplot), along with a summary at the end of the run.
+
+--tolerance <value>
+	Convergence tolerance for --itermap and --converge (default 0, i.e. the frequencies stop changing
+	altogether; with 0, --converge never alters the results).
+
+--converge
+	Stop each cell as soon as it has converged, instead of always running for --iterations generations.
+
+--cycles
+	Watch for the genotype frequencies repeating themselves (i.e. a cycle, or a fixed point, which is a
+	cycle of period 1), to within the tolerance (or with a tolerance of 0, to within a few units in the
+	last place, so that rounding errors don't look like a cycle), using Brent's algorithm. A cell stops as soon as this is
+	found; if it's a true cycle, the result is averaged over one turn of it, rather than taken from
+	whatever point of the cycle the last iteration happened to reach. The number of cells in cycles is
+	reported at the end, and their periods are given in --state files.
+
+--noabsorbing
+	Normally, once every genotype carrying M has died out (exactly, which in practice
+	needs --extinction or --ftz), a cell is finished: the population is ordinary dioecy, whose
+	equilibrium (AA mm : Aa mm = 1 : 1) is filled in directly instead of running the remaining iterations. This
+	turns that off. The results differ by rounding error at most.
+
+--lazynorm <value>
+	Use a faster, division-free version of the recursion which only renormalises the genotype frequencies
+	every <value> generations (e.g. 8). Results differ from the usual recursion by rounding error only; to
+	show how much, every 16th cell is also run the usual way, and the differences are reported at the end.
+
+
+FINITE POPULATIONS:
+
+--popsize <N>
+	Add genetic drift: each generation, the frequencies worked out by the recursion (from the pollen, eggs
+	and selfing of the last) are only the expected ones, and the plants of the next generation are a
+	random sample of <N> from them (Wright-Fisher), i.e. the genotype counts are a multinomial draw. This
+	is made as one binomial draw per genotype, by the BTPE algorithm (or inversion, for small means),
+	so it takes the same time for any <N> (up to 1e15; e.g. 1e9 is fine). Genotypes lost by drift are
+	lost for good, so a run often stops early at the absorbing state (see --noabsorbing). Works with
+	--onerun, graphs (--engine cell only) and --basins, but not with --kernel or --lazynorm.
+
+--replicates <n>
+	With --popsize, run <n> replicates of the cell (--onerun) or of every cell of the graph, each until
+	the invader (the inconstants; with --pgd, the males) is lost, or fixes (the type it is invading, the
+	males or with --pgd the inconstants, is lost instead), and give the fixation and loss probabilities
+	with 95% confidence intervals (Wilson). Each replicate has its own random number stream. The
+	replicates of a cell are run in batches of 1024, one generation of a whole batch per pass (the
+	expected frequencies being worked out as for --engine grid, so that they vectorise; compile with -O3
+	-fno-trapping-math), with finished replicates retired every generation, and the batches are shared
+	between threads. For a graph, each cell's results are written to <name>_N<N>_fixation.txt as soon as
+	it is done, and the fixation probabilities are drawn in <name>_N<N>_fixation.bmp (black = 0, white =
+	1) instead of the usual graph.
+
+--individuals <N>
+	With --onerun, run a model of <N> individual plants (e.g. 1e7) for --iterations generations, instead
+	of the recursion, to check it against. Each plant has one of the genotypes; each generation, every
+	inconstant is a cosex (with probability h) or a male. Each plant of the next generation then has a
+	mother, picked from the plants by her seed output (1 for a female; F (1 - S) outcrossed and F S (1 - d)
+	selfed for a cosex; the outcrossed part less under pollen limitation), and unless selfed, a father,
+	picked by his pollen output (1 for a male, Q for a cosex); its genotype is made from an egg of hers
+	and pollen of his (or hers), Y pollen succeeding with probability ppY, and if it's YY, it survives
+	with probability V (or is replaced by another). It takes about 150 ns per plant per generation on
+	one core (more with 1e7 or more plants, whose parents no longer fit in the cache). The final
+	frequencies are given alongside the recursion's, with the largest difference. The plants are held
+	one byte each in two arrays (parents and offspring), allocated once, and worked through in chunks
+	shared between threads, each chunk with its own random number stream, so the results don't depend
+	on the number of threads. Works with --trajectory.
+
+--area <value>
+	Instead of drawing the graph, estimate the fraction of it (the square of Q and F, or of K and k with
+	--oldformat) that ends in each state, to within +/- <value> (e.g. 0.001, as a 95% confidence
+	interval). The points are from a Sobol sequence, in 16 copies, each randomised by its own digital
+	shift (see --seed); the spread of their estimates gives the error bars. The points are doubled
+	until every state is within the precision asked for (or there are 2^20 per copy). This takes far
+	fewer runs than a graph. Uses the cell engine, whatever --engine says.
+
+--vary <name>,<low>,<high>
+	With --area, also vary parameter <name> (h, S, d, V, PSatF) from <low> to <high>, so that the
+	fractions are of a box of more dimensions. Up to 6 parameters can be varied. Also works with
+	--sensitivity.
+
+--sensitivity <N>
+	Instead of drawing the graph, work out which parameters matter most: run a Saltelli design of <N>
+	rows over Q, F and the parameters given by --vary (each row being a pair of points, A and B, from a
+	Sobol sequence randomised as for --area, so a power of 2 is best for <N>, and, for each parameter, A
+	with that parameter taken from B), and give first order and total Sobol indices, with 95% bootstrap
+	confidence intervals, for the final female frequency and for reaching each state. The runs are
+	shared between threads, a batch of rows at a time, and every row is written to
+	<name>_sensitivity.txt as it's done; if that file is already there (from the same settings), the
+	rows in it are read back and the run carries on from where it stopped.
+
+--continuation <name>,<low>,<high>
+	With --onerun, follow the equilibrium reached at <name> = <low> (<name> being Q, F, or one of the
+	parameters --vary can vary) as <name> goes to <high>, by pseudo-arclength continuation: each step
+	predicts the next point along the tangent to the branch, and corrects it by Newton's method, using
+	the Jacobian of one generation of the recursion (exact, as for --jacobian), in double precision
+	(long double if asked for). Genotypes the run leaves below --threshold are held at 0 where they would
+	die out anyway, so that the branch is followed along that face of the simplex. Folds (where the
+	branch turns back), eigenvalues passing through +1 (e.g. transcritical points, where a class
+	that is absent becomes able to invade) or -1 (period doubling), changes of state (a phenotype's
+	frequency passing --threshold) and genotypes dying out (where the branch leaves the simplex, and
+	stops) are each located by bisection, to the precision of a float parameter, and printed; every
+	point is saved to <name>_Q<Q>_F<F>_continuation_<name>.txt. This takes a few thousand
+	generations' worth of work, against a whole run per point for a sweep. The branch is followed
+	even where it is unstable, so beyond a loss of stability the state a run ends in may differ.
+
+--jacobian
+	With --onerun, also print the derivatives of one generation of the recursion at the final state,
+	with respect to each genotype frequency and to each of Q, F, h, S, d, V and PSatF, its
+	spectral radius on the simplex (below 1 if the state is stable), and how the female, male and
+	inconstant frequencies at the equilibrium change per unit change in each parameter. The derivatives
+	are exact (to rounding): the recursion is run on dual numbers, whose second part carries the
+	derivative, in a single pass of one generation with a cell for each direction (frequency or
+	parameter). The extinction limit (--extinction, --ftz) and the absorbing state are left out of
+	that pass, so a class that has died out still gets its true invasion eigenvalue. They are also available to other code as generationjacobian_dual() (see model2_kernel.h).
+
+--lattice <size>
+	With --onerun, run a lattice of <size> x <size> demes (e.g. 4096), each running the recursion, for
+	--iterations generations, with some of each deme's pollen dispersed to others before fertilisation.
+	Every deme starts from the usual start (see --pgd), except a patch in the centre, which starts from
+	the other, so that the front between them can be followed. The fraction of demes in each state, and
+	the mean phenotype frequencies, are printed every --census generations, and the final states saved
+	to <name>_Q<Q>_F<F>_lattice<size>.bmp. Pollen is spread by two passes (along the rows, then down the
+	columns), over strips of rows shared between threads. Dioecious demes aren't treated as absorbing.
+
+--dispersal <value>
+	Fraction (between 0 and 1) of each deme's pollen that is carried to other demes (default 0.5).
+
+--dispersalradius <value>
+	Furthest that pollen is carried, in demes along each axis (default 1; at most 64).
+
+--dispersalshape <box|gaussian>
+	How the carried pollen is spread within the radius: equally over the square (box, the default), or
+	by a Gaussian with a standard deviation of half the radius (along each axis).
+
+--patch <value>
+	Radius of the patch in the centre of the lattice that starts from the other start (default size / 16).
+
+--census <value>
+	Generations between reports on the lattice (default --iterations / 10).
+
+--seed <value>
+	Seed for the random numbers used by --popsize, --replicates, --individuals and --area (default 1). Each run (cell, or start with --basins) has
+	its own stream, worked out from the seed, Q, F and the start, so results are the same whatever the
+	number of threads, and the same cell always gives the same result.
+
+
+CHECKING:
+
+--verify <n>
+	Also run every <n>th cell (1 = all of them) with a frozen copy of the original recursion (see
+	model2_frozen.h), and report the cells classified differently (and where they are) and the largest
+	difference in a genotype frequency. Use this to check a faster build (e.g. -O3 -ffast-math
+	-march=native) or a rewrite of the recursion. The program exits with status 1 if any cell differs.
+
+--state <file>
+	Save the final genotype frequencies and regime of every cell of the graph to <file> (as text).
+
+--verifystate <file>
+	Compare every cell of the graph with a file saved by --state (e.g. by a trusted build, with the same
+	settings), and report differences as for --verify.
+
+
+PERFORMANCE:
+
+--threads <value>
+	Number of threads to share the graph between (default: one per processor). Only has an effect if the
+	program was compiled with OpenMP, e.g. gcc -O2 -fopenmp deterministic_model2.c -lm
+
+--engine <cell|grid>
+	How the graph is run. "cell" (the default) runs each cell in turn, to the end. "grid" runs a tile of
+	cells at once, one generation of every cell in the tile per pass, with the genotype frequencies held
+	in one array per genotype, so that the compiler can vectorise the pass (compile with -O3). Every 8
+	generations, cells that have stopped changing are retired from the tile, so the passes only ever
+	run over live cells. The results are exactly those of "cell", except that generations are counted
+	to the next multiple of 8 (so with --itermap, or --converge and a nonzero --tolerance, they differ a
+	little). Compile with -O3 -fno-trapping-math (which doesn't change the results) for the compiler to
+	vectorise the pass, and add -march=native for it to do so in single precision. Can't be used with
+	--kernel, --lazynorm, --cycles or --subnormals.
+
+--tile <value|auto>
+	Number of cells in a tile, for --engine grid. Each tile is run for all its generations before the next
+	is started, so it should fit in the L2 cache. With auto (the default), the tile sizes that fit are
+	each timed briefly before the graph is drawn, and the fastest is used; the times, and the L1D and
+	last level cache hit rates if the counters are available (see --perfcounters), are shown. Tiles are
+	shared out between threads.
+
+--progress
+	While drawing a graph, show on stderr how many cells are done, cells and generations per second, and
+	an estimate of the time remaining (updated every second or so).
+
+--machineprogress
+	As --progress, but each update is written as a line of JSON, for use by job schedulers, e.g.
+	{"done": 1200, "total": 40401, "elapsed": 2.0, "cells_per_s": 600.0, "generations_per_s": 6000000, "eta": 65.3}
+
+--timing
+	At the end, show how long was spent parsing the command line, allocating memory, in the recursion
+	itself, writing text output (--gnuplot, --itermap) and drawing the .bmp files.
+
+--timingjson <file>
+	As --timing, but save the times (and any --perfcounters results) to <file> as JSON.
+
+--perfcounters
+	Also count cycles, instructions, cache misses, floating point assists (mostly caused by subnormal
+	numbers) and L1D and last level cache reads and misses (giving the hit rates) while the recursion
+	runs, using the processor's counters (Linux only). Counters the system won't allow (see
+	/proc/sys/kernel/perf_event_paranoid) are shown as unavailable.
+
+--fpassistevent <hex>
+	Raw event code used for the FP assists counter (default 1eca, which is FP_ASSIST.ANY on Intel
+	processors from Sandy Bridge to Broadwell; other processors have their own codes).
+
+--benchmark <file>
+	Instead of drawing a graph, time the recursion in a few representative parameter regimes, and save the
+	results to <file> as JSON. For each regime, this gives the cost of one generation (in ns), the cost of
+	one cell at several values of --iterations, and the speed of whole graphs (in cells per second) at
+	several sizes and numbers of threads. Other settings (e.g. -h, -V, --precision, --ftz, --lazynorm,
+	--kernel) apply as usual, so that different builds and options can be compared.
+
+
+USER-DEFINED MODELS:
+
+--kernel <file>
+	Use a kernel generated by modelgen (see modelgen.c) in place of the built-in recursion. The kernel
+	must first be compiled as a shared library, e.g. gcc -O2 -shared -fPIC kernel.c -o kernel.so, and is
+	then given as --kernel ./kernel.so. Everything else (graph, Gnuplot output, --onerun) works as usual.
+
 */
 
 #include <assert.h>
+#include <complex.h>
 #include <ctype.h>
+#include <dlfcn.h>
+#include <float.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef __linux__
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
 
 #define MODEL 2
+#define NGENOTYPES 9
+#define MAXGENOTYPES 64		// Most genotypes a kernel loaded with --kernel may have
 
 #define PGD 1
 #define SSD 2
@@ -87,8 +399,299 @@ MISC:
 #define PAD 4
 #define INC 5
 
+#ifdef __GNUC__
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+#define STRINGIFY(x) STRINGIFY2(x)
+#define STRINGIFY2(x) #x
+
+#define ACCURACYSAMPLE 16		// With --lazynorm or --compareprecision, every this many cells are also run for comparison
+#define LAZYMAX 1e12			// Renormalise early if the total of the plant frequencies goes outside these limits
+#define LAZYMIN 1e-12
+
+#define SUBNORMAL 1				// Flag: a genotype frequency became subnormal during the run
+#define CYCLE 2					// Flag: the frequencies went round a cycle (--cycles), and have been averaged over it
+#define PERIODSHIFT 8			// ...in which case the period of the cycle is stored in the flags above this bit
+
+#define PERIOD(flags) ((flags) >> PERIODSHIFT)
+
+#define REPEATULPS 4			// With --tolerance 0, --cycles takes states this many epsilons apart (or closer) as the same
+
+#define SINGLE 1				// Precisions
+#define DOUBLE 2
+#define LONGDOUBLE 3
+
+const char * precisionnames[] = {"", "float", "double", "long double"};
+
+#define FEMALE 1
+#define MALE 2
+#define INCONSTANT 3
+
+const char * regimenames[] = {"???", "PGD", "SSD", "DIO", "PAD", "INC"};
+
+// Parameter regimes timed by --benchmark (other parameters are as given on the command line)...
+
+struct regime
+{
+	const char * name;
+	float S;
+	float d;
+	float PSatF;
+	float ppY;
+};
+
+const struct regime benchmarkregimes[] = {
+	{"nolimit",		0,		0,		0,		1},		// Defaults: no pollen limitation, no selfing
+	{"psatf",		0,		0,		4,		1},		// Heavy pollen limitation
+	{"selfing",		0.5,	0.5,	0,		1}		// Selfing, with inbreeding depression (ppY isn't implemented in Model 2)
+};
+
+#define PERCELL 1					// Engines (--engine)
+#define GRID 2
+
+#define GRIDCHECK 8					// Generations between compactions of a tile, for --engine grid
+
+#define MINTILE 64					// Smallest tile size tried by --tile auto
+#define TUNEGENERATIONS 64			// Generations each tile size is timed for
+#define TUNETIME 0.1				// ...repeated for at least this many seconds
+#define DEFAULTL2 262144			// Size of the L2 cache, if the system can't say
+
+#define MAXBASINSTARTS 20000000	// Most starts --basins will run
+#define MAXATTRACTORS 32			// Most attractors --basins will tell apart
+#define ATTRACTORMATCH 1e-3			// Final states this close (in every genotype frequency) count as the same attractor
+#define DIEDOUT -1					// In place of an attractor: the start died out (e.g. it had no females, or nothing to pollinate them)
+#define UNSETTLED -2				// ...or was still changing at the last generation
+
+#define MAXPOPSIZE 1e15			// Largest --popsize (so that counts are exact in a double)
+#define INVERSIONMEAN 30			// Binomial draws with a smaller mean than this are made by inversion, others by BTPE
+
+#define REPLICATEBATCH 1024			// Replicates run together (as the lanes of a tile) by --replicates
+#define LOST 1						// Outcomes of a replicate: the invader was lost...
+#define FIXED 2						// ...or fixed (0 = neither yet)
+#define WILSONZ 1.96				// Confidence intervals are 95% (Wilson score intervals)
+
+#define IBMCHUNK 65536				// Individuals handled at a time (by one thread, with one random number stream) by --individuals
+#define COSEX 0x80					// Bit set in an individual's byte if it's an inconstant expressing as a cosex this generation
+
+#define AREASHIFTS 16				// Independent randomisations of the Sobol sequence, for --area...
+#define AREAT 2.131					// ...so that the 95% confidence intervals use Student's t with 15 degrees of freedom
+#define AREAFIRST 64				// Points per randomisation in the first round (doubled each round after)
+#define AREAMAXPOINTS 1048576		// Most points per randomisation
+#define SOBOLDIMENSIONS 8			// Dimensions of a point: Q, F, and up to MAXVARY parameters
+#define SOBOLSEQUENCE 16			// Dimensions of the Sobol sequence (twice the above, for --sensitivity's A and B)
+#define SOBOLBITS 32
+#define MAXVARY 6					// Most parameters --vary can vary
+#define NPARAMETERS 6				// Parameters passed to simulate_parameters(): h, S, d, V, PSatF and ppY
+
+#define SENSITIVITYBATCH 256		// Rows of the Saltelli design run at a time (and then written out) by --sensitivity
+#define SENSITIVITYBLOCKS 1000		// Blocks of rows resampled by the bootstrap...
+#define BOOTSTRAPS 1000				// ...this many times
+#define SENSITIVITYOUTPUTS 6		// Outputs analysed: the female frequency, then whether each state (PGD to INC) was reached
+
+#define CONTINUATIONSTEPS 100000	// Most steps --continuation takes along the branch
+#define FIRSTSTEP 0.01				// First step along the branch (the parameter being scaled to run from 0 to 1)...
+#define LARGESTSTEP 0.05			// ...the largest it grows to...
+#define SMALLESTSTEP 1e-6			// ...and the smallest it shrinks to before giving up
+#define NEWTONITERATIONS 12			// Most Newton iterations of the corrector at each step...
+#define NEWTONTOLERANCE 1e-12		// ...which has converged once nothing changes by more than this
+#define DUALSTEP 1e-200				// Imaginary part that marks a direction for the derivatives (see generationjacobian_dual())
+#define BISECTIONS 40				// Halvings of the step to locate a bifurcation or change of state
+#define SQUARINGS 20				// The spectral radius is worked out from the 2^SQUARINGS th power of the Jacobian...
+#define NEUTRALBAND 1e-4			// ...and an equilibrium counts as neutral if it's this close to 1
+#define DETERMINANTNOISE 1e-8		// Determinants smaller than this are taken to be 0
+#define NTESTS 7					// Test functions watched along the branch (see continuationtests())
+#define EDGE 1e-12					// The branch has left the simplex once a genotype frequency is below -EDGE
+
+#define MAXRADIUS 64				// Largest --dispersalradius
+#define BOXKERNEL 1					// Dispersal kernels (--dispersalshape)
+#define GAUSSIANKERNEL 2
+
+#define TRAJECTORYRING 4096		// Records held in memory before they're written out, for --trajectory
+#define TRAJECTORYMAGIC "EBTRAJ1"	// First 8 bytes of a trajectory file
+#define MAXTRACES 16				// Most cells of a graph that --trace can record
+
+#define VERIFYLIST 20				// Most differently classified cells to list for --verify
+
+#define PROGRESSINTERVAL 1.0		// Seconds between --progress updates
+
+#define HUMAN 1						// --progress formats
+#define MACHINE 2
+
+#define PARSING 0					// Phases timed by --timing
+#define ALLOCATION 1
+#define RECURSION 2
+#define TEXTOUTPUT 3
+#define BMPOUTPUT 4
+#define NPHASES 5
+
+const char * phasenames[NPHASES] = {"Parsing", "Allocation", "Recursion", "Text output", "drawbmp"};
+const char * phasekeys[NPHASES] = {"parsing", "allocation", "recursion", "text_output", "drawbmp"};
+
+#define CYCLES 0					// Hardware counters for --perfcounters
+#define INSTRUCTIONS 1
+#define CACHEMISSES 2
+#define FPASSISTS 3
+#define L1DREADS 4
+#define L1DMISSES 5
+#define LLREADS 6
+#define LLMISSES 7
+#define NCOUNTERS 8
+
+#define MAXTHREADS 256				// Most threads whose counters can be kept
+
+const char * counternames[NCOUNTERS] = {"Cycles", "Instructions", "Cache misses", "FP assists",
+	"L1D reads", "L1D read misses", "LL reads", "LL read misses"};
+const char * counterkeys[NCOUNTERS] = {"cycles", "instructions", "cache_misses", "fp_assists",
+	"l1d_reads", "l1d_read_misses", "ll_reads", "ll_read_misses"};
+
+#define BENCHMARKTIME 0.25		// Repeat each single-cell timing for at least this many seconds
+
+const int benchmarkendpoints[] = {100, 1000, 10000, 100000};	// Values of --iterations for the single-cell timings
+const int benchmarksizes[] = {8, 16, 32};						// Values of --subdivisions for the graph timings
+
 
 int ** result;
+int ** iterations;				// Generations until each cell converged, for --itermap
+int ** altresult;				// Final state of each cell from the other start, for --bistable
+double * fixation;				// Fixation probability of each cell (y * subdivisions + x), for --replicates
+
+// All the built-in recursions have this form (see simulate_body() in model2_kernel.h)...
+
+typedef int (* simulate_function) (double * f, float Q, float F, int * flags);
+
+// ...and the grid engine has this form (see simulate_tile())...
+
+typedef void (* tile_function) (int cells, const float * Q, const float * F, double * f, int * generations);
+
+// ...as do the --replicates runs (see simulate_replicates())...
+
+typedef void (* replicate_function) (float Q, float F, const double * start, long long first, int count, long long * counts, long long * generations);
+
+// ...and --area and --sensitivity, which take the other parameters as well (see simulate_parameters())...
+
+typedef int (* parameter_function) (double * f, float Q, float F, int * flags, const float * parameters);
+
+// ...and the --lattice runs (see simulate_lattice())...
+
+typedef void (* lattice_function) (int size, float Q, float F, const double * outside, const double * inside, double patchradius,
+	void (* census) (int generation, int x, int y, double * f));
+
+// ...and --continuation, which needs just one generation (see generation()).
+
+typedef void (* generation_function) (double * f, float Q, float F);
+
+// Genotypes of the built-in model, in E&B order. These are replaced if a kernel is loaded with --kernel.
+
+const char * builtin_genotypenames[NGENOTYPES] = {"AA MM", "AA Mm", "AA mm", "Aa MM", "Aa Mm", "Aa mm", "aa MM", "aa Mm", "aa mm"};
+const int builtin_phenotypes[NGENOTYPES] = {FEMALE, FEMALE, FEMALE, INCONSTANT, INCONSTANT, MALE, INCONSTANT, INCONSTANT, MALE};
+const double builtin_start_dio[NGENOTYPES] = {0, 0, 0.499, 0, 0.002, 0.499, 0, 0, 0};		// Start with DIOECY, try inconstant invasion
+const double builtin_start_pgd[NGENOTYPES] = {0.499, 0, 0, 0.499, 0, 0.002, 0, 0, 0};		// Start with PSEUDO-GYNODIOECY, try male invasion
+
+// Genetics of the built-in model, for the individual-based model (--individuals): the gametes (one
+// allele of each locus) each genotype makes, and in what proportions, the loci being unlinked; which
+// gametes carry the Y (none here, as ppY isn't implemented in this model); the genotype formed by
+// each egg and pollen; and which genotypes are YY (viability V).
+
+#define NGAMETES 4
+
+const double builtin_segregation[NGENOTYPES][NGAMETES] = {
+	{1, 0, 0, 0},				// AA MM:	A M
+	{0.5, 0.5, 0, 0},			// AA Mm:	A M, A m
+	{0, 1, 0, 0},				// AA mm:	A m
+	{0.5, 0, 0.5, 0},			// Aa MM:	A M, a M
+	{0.25, 0.25, 0.25, 0.25},	// Aa Mm:	all four
+	{0, 0.5, 0, 0.5},			// Aa mm:	A m, a m
+	{0, 0, 1, 0},				// aa MM:	a M
+	{0, 0, 0.5, 0.5},			// aa Mm:	a M, a m
+	{0, 0, 0, 1}};				// aa mm:	a m
+const int builtin_ygamete[NGAMETES] = {0, 0, 0, 0};
+const int builtin_zygote[NGAMETES][NGAMETES] = {
+	{0, 1, 3, 4},				// Egg A M, with pollen A M, A m, a M, a m
+	{1, 2, 4, 5},				// Egg A m
+	{3, 4, 6, 7},				// Egg a M
+	{4, 5, 7, 8}};				// Egg a m
+const int builtin_yy[NGENOTYPES] = {0, 0, 0, 0, 0, 0, 1, 1, 1};
+
+int ngenotypes = NGENOTYPES;
+const char * const * genotypenames = builtin_genotypenames;
+const int * phenotypes = builtin_phenotypes;
+const double * start_dio = builtin_start_dio;
+const double * start_pgd = builtin_start_pgd;
+
+// Set by loadkernel() if --kernel is used...
+
+void (* kernel_simulate) (float * f, int endpoint, float Q, float F, float h, float S, float d, float V, float PSatF, float ppY) = NULL;
+const char * kernel_name;
+const char * kernel_description;
+const int * kernel_genotypes;
+double kernel_start_dio[MAXGENOTYPES];
+double kernel_start_pgd[MAXGENOTYPES];
+
+// Set by choosespecialisation() otherwise...
+
+simulate_function builtin_simulate = NULL;
+simulate_function reference_simulate = NULL;		// Set if results are to be compared with another recursion
+tile_function builtin_simulatetile = NULL;			// Used instead of builtin_simulate by --engine grid
+replicate_function builtin_simulatereplicates = NULL;	// Used by --replicates
+lattice_function builtin_simulatelattice = NULL;		// Used by --lattice
+parameter_function builtin_simulateparameters = NULL;	// Used by --area and --sensitivity
+generation_function builtin_generation = NULL;		// Used by --continuation
+const char * specialisation;
+char comparisonname[200];
+
+// Tallies for the accuracy reports...
+
+// For --state and --verifystate, the final states of all the cells (in the same order as the
+// Gnuplot file), and for --verify and --verifystate, the tallies of differences...
+
+double * states = NULL;
+int * stateregimes = NULL;
+int * stateperiods = NULL;
+double * goldenstates = NULL;
+int * goldenregimes = NULL;
+
+const char * verifyname;
+int verify_cells = 0;
+int verify_mismatches = 0;
+double verify_maxerror = 0;
+float verify_maxQ, verify_maxF;
+float verify_listQ[VERIFYLIST], verify_listF[VERIFYLIST];
+int verify_listregime[VERIFYLIST], verify_listexpected[VERIFYLIST];
+
+// Time spent in each phase, for --timing, and the hardware counters (one set per thread), for
+// --perfcounters. A counter that couldn't be opened has a value of -1, and the reason in countererror.
+
+double phasetime[NPHASES];
+
+int counterfd[MAXTHREADS][NCOUNTERS];
+int counterthreads = 0;
+long long countervalue[NCOUNTERS];
+const char * countererror[NCOUNTERS];
+
+// For --engine grid, the final states of all the cells (in the same order again), and the generation
+// at which each was retired...
+
+double * gridstates = NULL;
+int * gridgenerations = NULL;
+
+// Progress of the graph, for --progress...
+
+int progress_cells;
+int progress_total;
+long long progress_generations;
+double progress_start;
+double progress_next;
+
+int subnormalcells = 0;			// Cells flagged SUBNORMAL, if countsubnormals is set
+int cyclecells = 0;				// Cells flagged CYCLE
+int longestperiod = 0;
+
+int compared_cells = 0;
+int compared_mismatches = 0;
+double compared_maxerror = 0;
 
 // The following values are defaults that can be changed with command-line options.
 
@@ -102,6 +705,8 @@ float PSatF = 0;				// Pollen saturation point for female receivers
 float ppY = 1.0;				// Viability of Y pollen
 
 int pgd = 0;					// Start off in PGD and see if males invade? (Instead of starting with DIO)
+int bistable = 0;				// Also run every cell from the other start, and map where the results differ?
+int basins = 0;					// With --onerun, run from every start with frequencies in steps of 1/basins (0 = don't)
 
 int subdivisions = 201;			// Width and height of the output graphics file
 int gnuplot = 0;				// Output text of female frequencies suitable for GNU plot in 3D mode
@@ -112,7 +717,113 @@ int onerun = 0;					// Just running once with user-specified Q and F parameters?
 int oldformat = 0;				// Old style graph of k and K = 0 to 4?
 int oldformatlimit = 4;			// Axis size if drawing graph in old (E&B style) format
 
+int flushtozero = 0;			// Set the processor to flush subnormals to zero (FTZ and DAZ)?
+float extinction = 0;			// Genotype frequencies below this are set to 0 each generation (0 = never)
+int countsubnormals = 0;		// Count the cells in which any genotype frequency becomes subnormal?
+int precision = SINGLE;			// Floating point type used by the recursion
+int compareprecision = 0;		// Also run a sample of cells in this precision, and report differences (0 = don't)
+int itermap = 0;				// Also save a map of how many generations each cell took to converge?
+int stopearly = 0;				// Stop each cell once it has converged, rather than running to endpoint?
+float tolerance = 0;			// Largest change in a genotype frequency (per generation) that counts as converged
+int absorbing = 1;				// Jump straight to the equilibrium once the population is in the absorbing dioecious state?
+int cycles = 0;					// Detect cycles (and fixed points) and stop there?
+int lazynorm = 0;				// Renormalise plant frequencies only every this many generations (0 = exact recursion)
+int verify = 0;					// Check every this many cells against the frozen recursion (0 = don't)
+char * statefile = NULL;		// Save the final state of every cell here
+char * verifystatefile = NULL;	// Check every cell against the states saved in this file
+int timing = 0;					// Show the time taken by each phase of the run?
+char * timingfile = NULL;		// Save the times as JSON here
+int perfcounters = 0;			// Also use the hardware counters while the recursion runs?
+unsigned long fpassistevent = 0x1eca;		// Raw event code for the FP assists counter
+int progress = 0;				// Report progress of the graph on stderr (HUMAN or MACHINE, 0 = don't)
+int threads = 0;				// Threads to use for the graph, if compiled with OpenMP (0 = one per processor)
+int engine = PERCELL;			// Run the graph a cell at a time, or a tile of cells at a time (GRID)?
+int tilesize = 0;				// Cells in a tile, for the grid engine (0 = choose automatically)
+char * benchmarkfile = NULL;	// Run the benchmarks and save them here, instead of drawing a graph
+char * kernelfile = NULL;		// Shared library made from modelgen output, used instead of the built-in model
+int trajectoryevery = 0;		// Record the genotype frequencies every this many generations (0 = don't)...
+int trajectorydecade = 0;		// ...or this many times per decade of generations (log spacing)
+int traces = 0;					// Number of cells of the graph to record (--trace), and which
+int tracex[MAXTRACES];
+int tracey[MAXTRACES];
+char * trajectoryin = NULL;		// Print this trajectory file and exit (--readtrajectory)
+double popsize = 0;				// Plants in the population, for Wright-Fisher sampling (0 = infinite, i.e. deterministic)
+unsigned long long seed = 1;	// Seed for the random number streams
+int replicates = 0;				// Run this many replicates of each cell, and estimate the fixation probability (0 = don't)
+long long individuals = 0;		// Run the individual-based model with this many plants instead of the recursion (0 = don't)
+double area = 0;				// Estimate the fraction of the graph in each state, to within this (0 = don't)
+int sensitivity = 0;			// Run a Saltelli design with this many rows, for Sobol sensitivity indices (0 = don't)
+int varies = 0;					// Parameters varied by --area and --sensitivity as well as Q and F (--vary), which, and over what range
+int varywhich[MAXVARY];
+float varylow[MAXVARY];
+float varyhigh[MAXVARY];
+int lattice = 0;				// Run a lattice of this many demes square, with pollen dispersal between them (0 = don't)
+float dispersal = 0.5;			// Fraction of each deme's pollen that goes to other demes
+int dispersalradius = 1;		// Furthest (in demes, along each axis) that pollen goes
+int dispersalshape = BOXKERNEL;	// How the dispersed pollen is spread over that distance
+double patchradius = -1;		// Demes within this distance of the centre start from the other start (-1 = lattice / 16)
+int censusevery = 0;			// Generations between reports on the lattice (0 = endpoint / 10)
+double dispersalweights[2 * MAXRADIUS + 1];		// The dispersal kernel along each axis (see latticesweep())
+int continuation = 0;			// Follow the equilibrium as a parameter changes (0 = don't), which, and over what range
+int continuationwhich;
+float continuationlow;
+float continuationhigh;
+int jacobian = 0;				// With --onerun, print the derivatives of one generation at the final state?
 
+// Parameters that --vary can vary, in the order simulate_parameters() takes them (not ppY, which
+// isn't implemented in this model)...
+
+const char * varynames[] = {"h", "S", "d", "V", "PSatF"};
+
+#define NVARYABLES ((int) (sizeof(varynames) / sizeof(char *)))
+
+// Parameters that --continuation can follow the equilibrium along, and where they're kept (also the
+// parameters that generationjacobian_dual() gives the derivatives with respect to, in this order)...
+
+const char * continuationnames[] = {"Q", "F", "h", "S", "d", "V", "PSatF"};
+float * const continuationvalues[] = {&Q, &F, &h, &S, &d, &V, &PSatF};
+
+#define NCONTINUABLES ((int) (sizeof(continuationnames) / sizeof(char *)))
+#define JACOBIANCOLUMNS (NGENOTYPES + NCONTINUABLES)		// Derivatives of each genotype frequency from generationjacobian_dual()
+
+// The trajectory file starts with this header, followed by one record per generation recorded: the
+// generation (an int), then the genotype frequencies (as floats or doubles, see valuebytes)...
+
+struct trajectoryheader
+{
+	char magic[8];				// TRAJECTORYMAGIC
+	int model;
+	int genotypes;
+	int valuebytes;				// Size of each genotype frequency: 4 (float) or 8 (double, for higher precisions)
+	int every;					// Generations between records, or 0 with...
+	int perdecade;				// ...records per decade of generations (log spacing)
+	int endpoint;
+	float Q, F, h, S, d, V, PSatF, ppY;
+};
+
+// ...which are kept in a ring buffer while the recursion runs, and written out whenever it fills.
+// recording is set while a run is being recorded (only ever one at a time).
+
+int recording = 0;
+FILE * recordfile;
+unsigned char * recordring = NULL;
+int recordbytes;
+int recordvaluebytes;
+int recordused;
+int recordstep;
+long long recordcount;
+
+
+
+int parseprecision (char * name)
+{
+	if (strcmp(name, "float") == 0 || strcmp(name, "single") == 0) return SINGLE;
+	if (strcmp(name, "double") == 0) return DOUBLE;
+	if (strcmp(name, "long double") == 0 || strcmp(name, "longdouble") == 0 || strcmp(name, "long") == 0) return LONGDOUBLE;
+	
+	printf("Unrecognised precision %s (should be float, double or long double)\n", name);
+	exit(1);
+}
 
 void parsecommandline (int argc, char * argv[])
 {
@@ -153,6 +864,12 @@ void parsecommandline (int argc, char * argv[])
 			continue;
 		}
 		
+		if (strcmp(argv[n], "--ppY") == 0 && n < argc - 1)
+		{
+			ppY = atof(argv[n + 1]);
+			continue;
+		}
+		
 		if ((strcmp(argv[n], "-V") == 0 || strcmp(argv[n], "-v") == 0) && n < argc - 1)
 		{
 			V = atof(argv[n + 1]);
@@ -243,12 +960,195 @@ void parsecommandline (int argc, char * argv[])
 			continue;
 		}
 		
+		if (strcmp(argv[n], "--trajectory") == 0 && n < argc - 1)
+		{
+			trajectoryevery = atoi(argv[n + 1]);		// atoi!
+			if (trajectoryevery <= 0) trajectoryevery = -1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--logtrajectory") == 0 && n < argc - 1)
+		{
+			trajectorydecade = atoi(argv[n + 1]);		// atoi!
+			if (trajectorydecade <= 0) trajectorydecade = -1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--trace") == 0 && n < argc - 1)
+		{
+			if (traces == MAXTRACES || sscanf(argv[n + 1], "%d,%d", &tracex[traces], &tracey[traces]) != 2)
+			{
+				printf("--trace needs a cell as x,y (at most %d of them).\n", MAXTRACES);
+				exit(1);
+			}
+			traces++;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--readtrajectory") == 0 && n < argc - 1)
+		{
+			trajectoryin = argv[n + 1];
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--popsize") == 0 && n < argc - 1)
+		{
+			popsize = floor(atof(argv[n + 1]));		// atof, so that e.g. 1e9 can be given
+			if (popsize < 1 || popsize > MAXPOPSIZE) popsize = -1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--replicates") == 0 && n < argc - 1)
+		{
+			replicates = atoi(argv[n + 1]);			// atoi!
+			if (replicates <= 0) replicates = -1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--individuals") == 0 && n < argc - 1)
+		{
+			individuals = (long long) floor(atof(argv[n + 1]));		// atof, so that e.g. 1e7 can be given
+			if (individuals <= 0) individuals = -1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--area") == 0 && n < argc - 1)
+		{
+			area = atof(argv[n + 1]);
+			if (area <= 0) area = -1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--sensitivity") == 0 && n < argc - 1)
+		{
+			sensitivity = atoi(argv[n + 1]);
+			if (sensitivity <= 0) sensitivity = -1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--vary") == 0 && n < argc - 1)
+		{
+			char name[20];
+			
+			if (varies == MAXVARY || sscanf(argv[n + 1], "%19[^,],%f,%f", name, &varylow[varies], &varyhigh[varies]) != 3)
+			{
+				printf("--vary needs a parameter and its range as name,low,high (at most %d of them).\n", MAXVARY);
+				exit(1);
+			}
+			for (varywhich[varies] = 0; varywhich[varies] < NVARYABLES; varywhich[varies]++)
+			{
+				if (strcmp(name, varynames[varywhich[varies]]) == 0) break;
+			}
+			if (varywhich[varies] == NVARYABLES)
+			{
+				printf("--vary can't vary %s (should be one of:", name);
+				for (varywhich[varies] = 0; varywhich[varies] < NVARYABLES; varywhich[varies]++) printf(" %s", varynames[varywhich[varies]]);
+				printf(")\n");
+				exit(1);
+			}
+			varies++;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--continuation") == 0 && n < argc - 1)
+		{
+			char name[20];
+			
+			if (sscanf(argv[n + 1], "%19[^,],%f,%f", name, &continuationlow, &continuationhigh) != 3)
+			{
+				printf("--continuation needs a parameter and its range as name,low,high.\n");
+				exit(1);
+			}
+			for (continuationwhich = 0; continuationwhich < NCONTINUABLES; continuationwhich++)
+			{
+				if (strcmp(name, continuationnames[continuationwhich]) == 0) break;
+			}
+			if (continuationwhich == NCONTINUABLES)
+			{
+				printf("--continuation can't follow %s (should be one of:", name);
+				for (continuationwhich = 0; continuationwhich < NCONTINUABLES; continuationwhich++) printf(" %s", continuationnames[continuationwhich]);
+				printf(")\n");
+				exit(1);
+			}
+			continuation = 1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--jacobian") == 0)
+		{
+			jacobian = 1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--lattice") == 0 && n < argc - 1)
+		{
+			lattice = atoi(argv[n + 1]);
+			if (lattice <= 0) lattice = -1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--dispersal") == 0 && n < argc - 1)
+		{
+			dispersal = atof(argv[n + 1]);
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--dispersalradius") == 0 && n < argc - 1)
+		{
+			dispersalradius = atoi(argv[n + 1]);
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--dispersalshape") == 0 && n < argc - 1)
+		{
+			if (strcmp(argv[n + 1], "box") == 0)
+			{
+				dispersalshape = BOXKERNEL;
+			} else if (strcmp(argv[n + 1], "gaussian") == 0) {
+				dispersalshape = GAUSSIANKERNEL;
+			} else {
+				printf("Unrecognised dispersal kernel %s (should be box or gaussian)\n", argv[n + 1]);
+				exit(1);
+			}
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--patch") == 0 && n < argc - 1)
+		{
+			patchradius = atof(argv[n + 1]);
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--census") == 0 && n < argc - 1)
+		{
+			censusevery = atoi(argv[n + 1]);
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--seed") == 0 && n < argc - 1)
+		{
+			seed = strtoull(argv[n + 1], NULL, 0);
+			continue;
+		}
+		
 		if (strcmp(argv[n], "--pgd") == 0)
 		{
 			pgd = 1;
 			continue;
 		}
 		
+		if (strcmp(argv[n], "--basins") == 0 && n < argc - 1)
+		{
+			basins = atoi(argv[n + 1]);				// atoi!
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--bistable") == 0)
+		{
+			bistable = 1;
+			continue;
+		}
+		
 		if (strcmp(argv[n], "--oldformat") == 0)
 		{
 			oldformat = 1;
@@ -261,17 +1161,244 @@ void parsecommandline (int argc, char * argv[])
 			continue;
 		}
 		
-		if (argv[n][0] == '-' && isdigit(argv[n][1]) == 0)
+		if (strcmp(argv[n], "--ftz") == 0)
 		{
-			printf("Unrecognised option %s\n", argv[n]);
-			exit(1);
+			flushtozero = 1;
+			continue;
 		}
-	}
+		
+		if (strcmp(argv[n], "--extinction") == 0 && n < argc - 1)
+		{
+			extinction = atof(argv[n + 1]);
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--subnormals") == 0)
+		{
+			countsubnormals = 1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--precision") == 0 && n < argc - 1)
+		{
+			precision = parseprecision(argv[n + 1]);
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--compareprecision") == 0 && n < argc - 1)
+		{
+			compareprecision = parseprecision(argv[n + 1]);
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--itermap") == 0)
+		{
+			itermap = 1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--tolerance") == 0 && n < argc - 1)
+		{
+			tolerance = atof(argv[n + 1]);
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--converge") == 0)
+		{
+			stopearly = 1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--noabsorbing") == 0)
+		{
+			absorbing = 0;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--cycles") == 0)
+		{
+			cycles = 1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--lazynorm") == 0 && n < argc - 1)
+		{
+			lazynorm = atoi(argv[n + 1]);			// atoi!
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--threads") == 0 && n < argc - 1)
+		{
+			threads = atoi(argv[n + 1]);			// atoi!
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--verify") == 0 && n < argc - 1)
+		{
+			verify = atoi(argv[n + 1]);				// atoi!
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--state") == 0 && n < argc - 1)
+		{
+			statefile = argv[n + 1];
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--verifystate") == 0 && n < argc - 1)
+		{
+			verifystatefile = argv[n + 1];
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--timing") == 0)
+		{
+			timing = 1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--timingjson") == 0 && n < argc - 1)
+		{
+			timing = 1;
+			timingfile = argv[n + 1];
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--perfcounters") == 0)
+		{
+			timing = 1;
+			perfcounters = 1;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--fpassistevent") == 0 && n < argc - 1)
+		{
+			fpassistevent = strtoul(argv[n + 1], NULL, 16);
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--progress") == 0)
+		{
+			progress = HUMAN;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--machineprogress") == 0)
+		{
+			progress = MACHINE;
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--engine") == 0 && n < argc - 1)
+		{
+			if (strcmp(argv[n + 1], "grid") == 0)
+			{
+				engine = GRID;
+			} else if (strcmp(argv[n + 1], "cell") == 0) {
+				engine = PERCELL;
+			} else {
+				printf("Unrecognised engine %s (should be cell or grid)\n", argv[n + 1]);
+				exit(1);
+			}
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--tile") == 0 && n < argc - 1)
+		{
+			if (strcmp(argv[n + 1], "auto") == 0)
+			{
+				tilesize = 0;
+			} else {
+				tilesize = atoi(argv[n + 1]);		// atoi!
+				if (tilesize < 1) tilesize = -1;
+			}
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--benchmark") == 0 && n < argc - 1)
+		{
+			benchmarkfile = argv[n + 1];
+			continue;
+		}
+		
+		if (strcmp(argv[n], "--kernel") == 0 && n < argc - 1)
+		{
+			kernelfile = argv[n + 1];
+			continue;
+		}
+		
+		if (argv[n][0] == '-' && isdigit(argv[n][1]) == 0)
+		{
+			printf("Unrecognised option %s\n", argv[n]);
+			exit(1);
+		}
+	}
+	
+	return;
+}
+
+// Colours for drawbmp()...
+
+void regimecolour (int x, int y, int * red, int * green, int * blue)
+{
+	*red = 0; *green = 0; *blue = 0;
+	
+	if (result[x][y] == PGD)
+	{
+		*red = 255; *green = 127; *blue = 127;
+	}
+	if (result[x][y] == DIO)
+	{
+		*red = 127; *green = 0; *blue = 255;
+	}
+	if (result[x][y] == SSD)
+	{
+		*red = 255; *green = 255; *blue = 0;
+	}
+	if (result[x][y] == PAD)
+	{
+		*red = 180; *green = 180; *blue = 255;
+	}
+	if (result[x][y] == INC)
+	{
+		*red = 255; *green = 255; *blue = 255;
+	}
+	
+	return;
+}
+
+// For --bistable: cells whose final state depends on the start are green, the rest as usual.
+
+void bistablecolour (int x, int y, int * red, int * green, int * blue)
+{
+	if (altresult[x][y] != result[x][y])
+	{
+		*red = 0; *green = 255; *blue = 0;
+		return;
+	}
+	
+	regimecolour(x, y, red, green, blue);
+	
+	return;
+}
+
+void iterationcolour (int x, int y, int * red, int * green, int * blue)
+{
+	int grey;
+	
+	if (iterations[x][y] >= endpoint)		// Never converged
+	{
+		*red = 255; *green = 0; *blue = 0;
+		return;
+	}
+	
+	grey = 255 * log(1 + iterations[x][y]) / log(1 + endpoint);
+	*red = grey; *green = grey; *blue = grey;
 	
 	return;
 }
 
-void drawbmp (char * filename, int magnify)
+void drawbmp (char * filename, int magnify, void (* colour) (int x, int y, int * red, int * green, int * blue))
 {
 	unsigned int headers[13];
 	FILE * outfile;
@@ -356,28 +1483,7 @@ void drawbmp (char * filename, int magnify)
 		{
 			for (x = 0; x < subdivisions; x++)
 			{
-				red = 0; green = 0; blue = 0;
-			
-				if (result[x][y] == PGD)
-				{
-					red = 255; green = 127; blue = 127;
-				}
-				if (result[x][y] == DIO)
-				{
-					red = 127; green = 0; blue = 255;
-				}
-				if (result[x][y] == SSD)
-				{
-					red = 255; green = 255; blue = 0;
-				}
-				if (result[x][y] == PAD)
-				{
-					red = 180; green = 180; blue = 255;
-				}
-				if (result[x][y] == INC)
-				{
-					red = 255; green = 255; blue = 255;
-				}
+				colour(x, y, &red, &green, &blue);
 				
 				// Also, it's written in (b,g,r) format...
 
@@ -401,488 +1507,4767 @@ void drawbmp (char * filename, int magnify)
 	return;
 }
 
-int main (int argc, char * argv[])
+void loadkernel (void)
 {
-	// Plant frequencies... (zeroed here just to suppress a -Wall warning)
-	float f_AA_MM = 0;
-	float f_AA_Mm = 0;
-	float f_AA_mm = 0;
-	float f_Aa_MM = 0;
-	float f_Aa_Mm = 0;
-	float f_Aa_mm = 0;
-	float f_aa_MM = 0;
-	float f_aa_Mm = 0;
-	float f_aa_mm = 0;
-
-	float next_f_AA_MM;
-	float next_f_AA_Mm;
-	float next_f_AA_mm;
-	float next_f_Aa_MM;
-	float next_f_Aa_Mm;
-	float next_f_Aa_mm;
-	float next_f_aa_MM;
-	float next_f_aa_Mm;
-	float next_f_aa_mm;
-
-	// Pollen frequencies...
-	float p_A_M;
-	float p_A_m;
-	float p_a_M;
-	float p_a_m;
-	
-	// Egg frequencies...
-	float e_A_M;
-	float e_A_m;
-	float e_a_M;
-	float e_a_m;
-	
-	float male = 0;
-	float female = 0;
-	float inconstant = 0;
-	
-	float PSatC;				// Pollen saturation point for cosex receivers
+	void * library;
+	float * loaded_dio;
+	float * loaded_pgd;
+	int n;
 	
-	float K;
-	float k;
+	library = dlopen(kernelfile, RTLD_NOW);
+	if (library == NULL)
+	{
+		printf("Failed to load kernel: %s\n", dlerror());
+		exit(1);
+	}
 	
-	float totalpollen;
-	float totalplants;
-	int n;
-	int x;
-	int y;
+	kernel_simulate = (void (*) (float *, int, float, float, float, float, float, float, float, float)) dlsym(library, "kernel_simulate");
+	kernel_name = dlsym(library, "kernel_name");
+	kernel_description = dlsym(library, "kernel_description");
+	kernel_genotypes = dlsym(library, "kernel_genotypes");
+	genotypenames = dlsym(library, "kernel_genotype_names");
+	phenotypes = dlsym(library, "kernel_phenotypes");
+	loaded_dio = dlsym(library, "kernel_start_dio");
+	loaded_pgd = dlsym(library, "kernel_start_pgd");
 	
-	char bmp_filename[1024];
-	char txt_filename[1024];
+	if (kernel_simulate == NULL || kernel_name == NULL || kernel_description == NULL || kernel_genotypes == NULL
+	 || genotypenames == NULL || phenotypes == NULL || loaded_dio == NULL || loaded_pgd == NULL)
+	{
+		printf("%s is not a kernel produced by modelgen!\n", kernelfile);
+		exit(1);
+	}
 	
-	FILE * textfile = NULL;
+	ngenotypes = *kernel_genotypes;
+	if (ngenotypes < 1 || ngenotypes > MAXGENOTYPES)
+	{
+		printf("Kernel has %d genotypes, but the most that can be handled is %d!\n", ngenotypes, MAXGENOTYPES);
+		exit(1);
+	}
+	
+	for (n = 0; n < ngenotypes; n++)
+	{
+		kernel_start_dio[n] = loaded_dio[n];
+		kernel_start_pgd[n] = loaded_pgd[n];
+	}
+	start_dio = kernel_start_dio;
+	start_pgd = kernel_start_pgd;
+	
+	return;
+}
 
+// Trajectories (--trajectory and --logtrajectory). startrecording() opens the file and sets recording,
+// which makes the recursion call recordstate() for the start, for each generation wanted and for the
+// final frequencies. recordstate() returns the next generation wanted: the next multiple of
+// trajectoryevery, or the next of 10^(i / trajectorydecade) (rounded) for i = 0, 1, 2...
+
+int nextrecord (int generation)
+{
+	int next;
 	
-	parsecommandline(argc, argv);
+	if (trajectoryevery) return generation - generation % trajectoryevery + trajectoryevery;
 	
-	result = malloc(subdivisions * sizeof(int*));
-	if (result == NULL)
+	do
 	{
-		printf("Out of memory!\n");
+		next = (int) floor(pow(10, (double) recordstep++ / trajectorydecade) + 0.5);
+	} while (next <= generation);
+	
+	return next;
+}
+
+void flushrecords (void)
+{
+	if (fwrite(recordring, recordbytes, recordused, recordfile) != (size_t) recordused)
+	{
+		printf("Failed to write trajectory file!\n");
 		exit(1);
 	}
-	for (n = 0; n < subdivisions; n++)
+	recordused = 0;
+	
+	return;
+}
+
+int recordstate (int generation, double * f)
+{
+	unsigned char * record;
+	float single;
+	int n;
+	
+	if (recordused == TRAJECTORYRING) flushrecords();
+	
+	record = recordring + (size_t) recordused * recordbytes;
+	memcpy(record, &generation, sizeof(int));
+	record += sizeof(int);
+	for (n = 0; n < ngenotypes; n++)
 	{
-		result[n] = malloc(subdivisions * sizeof(int));
-		if (result[n] == NULL)
+		if (recordvaluebytes == sizeof(float))
 		{
-			printf("Out of memory!\n");
-			exit(1);
+			single = f[n];
+			memcpy(record, &single, sizeof(float));
+		} else {
+			memcpy(record, &f[n], sizeof(double));
 		}
+		record += recordvaluebytes;
 	}
+	recordused++;
+	recordcount++;
 	
-	// Print all settings...
+	return nextrecord(generation);
+}
+
+void startrecording (char * filename, float Q, float F)
+{
+	struct trajectoryheader header;
 	
-	printf("\nModel %d\n\n", MODEL);
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TRAJECTORYMAGIC, sizeof(header.magic));
+	header.model = MODEL;
+	header.genotypes = ngenotypes;
+	header.valuebytes = (precision == SINGLE) ? sizeof(float) : sizeof(double);
+	header.every = trajectoryevery;
+	header.perdecade = trajectorydecade;
+	header.endpoint = endpoint;
+	header.Q = Q; header.F = F; header.h = h; header.S = S;
+	header.d = d; header.V = V; header.PSatF = PSatF; header.ppY = ppY;
 	
-	if (onerun)
+	recordfile = fopen(filename, "wb");
+	if (recordfile == NULL)
 	{
-		printf("Q = %G (K = %G, pi = %G)\n", Q, (1 / Q) - 1, 1 / Q);
-		printf("F = %G (k = %G, \"omega\" = %G)\n\n", F, (1 / F) - 1, 1 / F);
+		printf("Failed to create output file!\n");
+		exit(1);
 	}
+	fwrite(&header, sizeof(header), 1, recordfile);
 	
-	printf("h = %G\n", h);
-	printf("Selfing rate = %G\n", S);
-	printf("Inbreeding depression = %G\n", d);
-	printf("YY viability = %G (YY penalty = %G)\n", V, 1 - V);
-	printf("PSatF = %G\n\n", PSatF);
-	
-	printf("Iterations = %d\n\n", endpoint);
+	recordvaluebytes = header.valuebytes;
+	recordbytes = sizeof(int) + ngenotypes * recordvaluebytes;
+	if (recordring == NULL) recordring = malloc((size_t) TRAJECTORYRING * sizeof(int) + TRAJECTORYRING * MAXGENOTYPES * sizeof(double));
+	if (recordring == NULL)
+	{
+		printf("Out of memory!\n");
+		exit(1);
+	}
+	recordused = 0;
+	recordstep = 0;
+	recordcount = 0;
+	recording = 1;
 	
-	if (onerun == 0)
+	return;
+}
+
+void stoprecording (char * filename)
+{
+	flushrecords();
+	if (fclose(recordfile) != 0)
 	{
-		printf("Warning: --onerun option not received, therefore program will\n");
-		printf("use %d Q and F combinations and produce a graph. This may\n", subdivisions * subdivisions);
-		printf("take a long time. If this was not your intention, terminate now.\n\n");
-		
-		printf("                       %d |\n", oldformat ? oldformatlimit : 1);
-		printf("Output format:       %s   |\n", oldformat ? "k" : "F");
-		printf("                       0 |\n");
-		printf("                          -----\n");
-		printf("                          0   %d\n", oldformat ? oldformatlimit : 1);
-		printf("                            %s\n\n", oldformat ? "K" : "Q");
+		printf("Failed to write trajectory file!\n");
+		exit(1);
 	}
+	recording = 0;
 	
-	// Choose names for .bmp and .txt output files (if needed)...
+	printf("Saved %s (%lld generations recorded)\n", filename, recordcount);
+	
+	return;
+}
+
+// For --readtrajectory: map a trajectory file into memory and print it as text, one line per record.
+
+void readtrajectory (char * filename)
+{
+	struct trajectoryheader header;
+	struct stat info;
+	unsigned char * data;
+	unsigned char * record;
+	long long records;
+	long long r;
+	int bytes;
+	int generation;
+	float single;
+	double value;
+	int fd;
+	int n;
 	
-	sprintf(bmp_filename, "model%d_start%s_V%G_S%G_d%G_h%G_PSatF%G_ppY%G.bmp", MODEL, pgd ? "PGD" : "DIO", V, S, d, h, PSatF, ppY);
-	sprintf(txt_filename, "model%d_start%s_V%G_S%G_d%G_h%G_PSatF%G_ppY%G.txt", MODEL, pgd ? "PGD" : "DIO", V, S, d, h, PSatF, ppY);
+	fd = open(filename, O_RDONLY);
+	if (fd < 0 || fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(header))
+	{
+		printf("Failed to open %s, or it's too short to be a trajectory!\n", filename);
+		exit(1);
+	}
 	
-	// Open .txt output file (if needed)...
+	data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+	{
+		printf("Failed to map %s into memory!\n", filename);
+		exit(1);
+	}
+	close(fd);
 	
-	if (onerun == 0 && gnuplot)
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, TRAJECTORYMAGIC, sizeof(header.magic)) != 0 || header.genotypes < 1 || header.genotypes > MAXGENOTYPES
+	 || (header.valuebytes != sizeof(float) && header.valuebytes != sizeof(double)))
 	{
-		textfile = fopen(txt_filename, "w");
+		printf("%s is not a trajectory file!\n", filename);
+		exit(1);
 	}
 	
+	bytes = sizeof(int) + header.genotypes * header.valuebytes;
+	records = (info.st_size - sizeof(header)) / bytes;
 	
-	for (y = 0; y < subdivisions; y++)
+	printf("# model %d genotypes %d records %lld Q %G F %G h %G S %G d %G V %G PSatF %G ppY %G\n", header.model, header.genotypes, records,
+		header.Q, header.F, header.h, header.S, header.d, header.V, header.PSatF, header.ppY);
+	
+	for (r = 0; r < records; r++)
 	{
-		for (x = 0; x < subdivisions; x++)
+		record = data + sizeof(header) + r * bytes;
+		memcpy(&generation, record, sizeof(int));
+		printf("%d", generation);
+		for (n = 0; n < header.genotypes; n++)
 		{
-			if (onerun == 0)
+			if (header.valuebytes == sizeof(float))
 			{
-			
-				// Here we map the X,Y coordinates of our output .bmp file onto Q and F parameters...
-			
-				if (oldformat == 0)
-				{
-					Q = (float) x / (subdivisions - 1);						// X axis: Q values 0 to 1
-					F = (float) y / (subdivisions - 1);						// Y axis: F values 0 to 1
-				} else {
-					K = ((float) x / (subdivisions - 1)) * oldformatlimit;	// X axis: K values 0 to oldformatlimit
-					k = ((float) y / (subdivisions - 1)) * oldformatlimit;	// Y axis: k values 0 to oldformatlimit
-					
-					// But Q and F are the parameters actually used by the code, so calculate them:
-					Q = 1 / (1 + K);
-					F = 1 / (1 + k);
-				}
+				memcpy(&single, record + sizeof(int) + n * sizeof(float), sizeof(float));
+				value = single;
+			} else {
+				memcpy(&value, record + sizeof(int) + n * sizeof(double), sizeof(double));
 			}
+			printf(" %.9G", value);
+		}
+		printf("\n");
+	}
 	
-			// Set start plant frequencies...
-			
-			if (pgd == 0)				// Start with DIOECY, try inconstant invasion
-			{
-				f_AA_MM = 0;
-				f_AA_Mm = 0;
-				f_AA_mm = 0.499;
-				f_Aa_MM = 0;
-				f_Aa_Mm = 0.002;
-				f_Aa_mm = 0.499;
-				f_aa_MM = 0;
-				f_aa_Mm = 0;
-				f_aa_mm = 0;
-			} else {					// Start with PSEUDO-GYNODIOECY, try male invasion
-				f_AA_MM = 0.499;
-				f_AA_Mm = 0;
-				f_AA_mm = 0;
-				f_Aa_MM = 0.499;
-				f_Aa_Mm = 0;
-				f_Aa_mm = 0.002;
-				f_aa_MM = 0;
-				f_aa_Mm = 0;
-				f_aa_mm = 0;
-			}
-	
-			for (n = 0; n < endpoint; n++)
-			{
-				// Outcrossed pollen frequencies....................................................
-				//
-				// Here we sum up the 4 types of pollen (containing the 4 possible allele combinations)
-				// from the various possible sources. We could do this in 4 equations (as in the paper)
-				// but it's simpler to consider each source in turn and add to the totals.
-				
-				p_A_M = 0;
-				p_A_m = 0;
-				p_a_M = 0;
-				p_a_m = 0;
-				
-				// From AA MM pure females (genotype 1)
-				;
-				
-				// From AA Mm pure females (genotype 2)
-				;
-				
-				// From AA mm pure females (genotype 3)
-				;
-				
-				// From Aa MM inconstants (genotype 4) as cosexes
-				p_A_M += f_Aa_MM * 0.5 * h * Q;
-				p_a_M += f_Aa_MM * 0.5 * h * Q;
-				
-				// From Aa MM inconstants (genotype 4) as males
-				p_A_M += f_Aa_MM * 0.5 * (1 - h);
-				p_a_M += f_Aa_MM * 0.5 * (1 - h);
-				
-				// From Aa Mm inconstants (genotype 5) as cosexes
-				p_A_M += f_Aa_Mm * 0.25 * h * Q;
-				p_A_m += f_Aa_Mm * 0.25 * h * Q;
-				p_a_M += f_Aa_Mm * 0.25 * h * Q;
-				p_a_m += f_Aa_Mm * 0.25 * h * Q;
-				
-				// From Aa Mm inconstants (genotype 5) as males
-				p_A_M += f_Aa_Mm * 0.25 * (1 - h);
-				p_A_m += f_Aa_Mm * 0.25 * (1 - h);
-				p_a_M += f_Aa_Mm * 0.25 * (1 - h);
-				p_a_m += f_Aa_Mm * 0.25 * (1 - h);
-				
-				// From Aa mm pure males (genotype 6)
-				p_A_m += f_Aa_mm * 0.5;
-				p_a_m += f_Aa_mm * 0.5;
-				
-				// From aa MM inconstants (genotype 7) as cosexes
-				p_a_M += f_aa_MM * h * Q;
-				
-				// From aa MM inconstants (genotype 7) as males
-				p_a_M += f_aa_MM * (1 - h);
-				
-				// From aa Mm inconstants (genotype 8) as cosexes
-				p_a_M += f_aa_Mm * 0.5 * h * Q;
-				p_a_m += f_aa_Mm * 0.5 * h * Q;
-				
-				// From aa Mm inconstants (genotype 8) as males
-				p_a_M += f_aa_Mm * 0.5 * (1 - h);
-				p_a_m += f_aa_Mm * 0.5 * (1 - h);
-				
-				// From aa mm pure males (genotype 9)
-				p_a_m += f_aa_mm;
-				
-				// Normalise pollen frequencies to add up to 1......................................
-				
-				totalpollen = p_A_M + p_A_m + p_a_M + p_a_m;
-				if (totalpollen > 0)
-				{
-					p_A_M /= totalpollen;
-					p_A_m /= totalpollen;
-					p_a_M /= totalpollen;
-					p_a_m /= totalpollen;
-				}
-				
-				// Outcrossed egg frequencies.......................................................
-				
-				// Calculate pollen required to fertilise a cosex's outcrossing ovules:
-				PSatC = PSatF * F * (1 - S);
-				
-				e_A_M = 0;
-				e_A_m = 0;
-				e_a_M = 0;
-				e_a_m = 0;
-				
-				// From AA MM pure females (genotype 1)
-				if (totalpollen >= PSatF)
-				{
-					e_A_M += f_AA_MM;
-				} else {
-					e_A_M += f_AA_MM * totalpollen / PSatF;
-				}
-				
-				// From AA Mm pure females (genotype 2)
-				if (totalpollen >= PSatF)
-				{
-					e_A_M += f_AA_Mm * 0.5;
-					e_A_m += f_AA_Mm * 0.5;
-				} else {
-					e_A_M += f_AA_Mm * 0.5 * totalpollen / PSatF;
-					e_A_m += f_AA_Mm * 0.5 * totalpollen / PSatF;
-				}
-				
-				// From AA mm pure females (genotype 3)
-				if (totalpollen >= PSatF)
-				{
-					e_A_m += f_AA_mm;
-				} else {
-					e_A_m += f_AA_mm * totalpollen / PSatF;
-				}
-				
-				// From Aa MM inconstants (genotype 4) as cosexes
-				if (totalpollen >= PSatC)
-				{
-					e_A_M += f_Aa_MM * h * 0.5 * (1 - S) * F;
-					e_a_M += f_Aa_MM * h * 0.5 * (1 - S) * F;
-				} else {
-					e_A_M += f_Aa_MM * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
-					e_a_M += f_Aa_MM * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
-				}
-				
-				// From Aa Mm inconstants (genotype 5) as cosexes
-				if (totalpollen >= PSatC)
-				{
-					e_A_M += f_Aa_Mm * h * 0.25 * (1 - S) * F;
-					e_A_m += f_Aa_Mm * h * 0.25 * (1 - S) * F;
-					e_a_M += f_Aa_Mm * h * 0.25 * (1 - S) * F;
-					e_a_m += f_Aa_Mm * h * 0.25 * (1 - S) * F;
-				} else {
-					e_A_M += f_Aa_Mm * h * 0.25 * (1 - S) * F * totalpollen / PSatC;
-					e_A_m += f_Aa_Mm * h * 0.25 * (1 - S) * F * totalpollen / PSatC;
-					e_a_M += f_Aa_Mm * h * 0.25 * (1 - S) * F * totalpollen / PSatC;
-					e_a_m += f_Aa_Mm * h * 0.25 * (1 - S) * F * totalpollen / PSatC;
-				}
-				
-				// From Aa mm pure males (genotype 6)
-				;
-				
-				// From aa MM inconstants (genotype 7) as cosexes
-				if (totalpollen >= PSatC)
-				{
-					e_a_M += f_aa_MM * h * (1 - S) * F;
-				} else {
-					e_a_M += f_aa_MM * h * (1 - S) * F * totalpollen / PSatC;
-				}
-				
-				// From aa Mm inconstants (genotype 8) as cosexes
-				if (totalpollen >= PSatC)
-				{
-					e_a_M += f_aa_Mm * h * 0.5 * (1 - S) * F;
-					e_a_m += f_aa_Mm * h * 0.5 * (1 - S) * F;
-				} else {
-					e_a_M += f_aa_Mm * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
-					e_a_m += f_aa_Mm * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
-				}
-				
-				// From aa mm pure males (genotype 9)
-				;
-				
-				// WE CANNOT AND MUST NOT NORMALISE THE EGG FREQUENCIES, AS WE HAVEN'T
-				// YET CONSIDERED THE SELFED EGGS. BUT WE DON'T NEED TO NORMALISE.
-				
-				// Plant frequencies from outcrossing...............................................
-				
-				next_f_AA_MM = p_A_M * e_A_M;
-				next_f_AA_Mm = p_A_M * e_A_m + p_A_m * e_A_M;
-				next_f_AA_mm = p_A_m * e_A_m;
-				next_f_Aa_MM = p_A_M * e_a_M + p_a_M * e_A_M;
-				next_f_Aa_Mm = p_A_M * e_a_m + p_A_m * e_a_M + p_a_M * e_A_m + p_a_m * e_A_M;
-				next_f_Aa_mm = p_A_m * e_a_m + p_a_m * e_A_m;
-				next_f_aa_MM = p_a_M * e_a_M;
-				next_f_aa_Mm = p_a_M * e_a_m + p_a_m * e_a_M;
-				next_f_aa_mm = p_a_m * e_a_m;
-				
-				// Additional plants from selfing...................................................
-				
-				// From AA MM pure females (genotype 1)
-				;
-				
-				// From AA Mm pure females (genotype 2)
-				;
-				
-				// From AA mm pure females (genotype 3)
-				;
-				
-				// From Aa MM inconstants (genotype 4)
-				next_f_AA_MM += f_Aa_MM * 0.25 * S * (1 - d) * h * F;
-				next_f_Aa_MM += f_Aa_MM * 0.5 * S * (1 - d) * h * F;
-				next_f_aa_MM += f_Aa_MM * 0.25 * S * (1 - d) * h * F;
-				
-				// From Aa Mm inconstants (genotype 5)
-				next_f_AA_MM += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
-				next_f_AA_Mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
-				next_f_AA_mm += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
-				next_f_Aa_MM += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
-				next_f_Aa_Mm += f_Aa_Mm * 0.25 * S * (1 - d) * h * F;
-				next_f_Aa_mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
-				next_f_aa_MM += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
-				next_f_aa_Mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
-				next_f_aa_mm += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
-				
-				// From Aa mm pure males (genotype 6)
-				;
-				
-				// From aa MM inconstants (genotype 7)
-				next_f_aa_MM += f_aa_MM * S * (1 - d) * h * F;
-				
-				// From aa Mm inconstants (genotype 8)
-				next_f_aa_MM += f_aa_Mm * 0.25 * S * (1 - d) * h * F;
-				next_f_aa_Mm += f_aa_Mm * 0.5 * S * (1 - d) * h * F;
-				next_f_aa_mm += f_aa_Mm * 0.25 * S * (1 - d) * h * F;
-				
-				// From aa mm pure males (genotype 9)
-				;
+	munmap(data, info.st_size);
+	
+	return;
+}
 
-				// Apply YY penalty.................................................................
-				
-				next_f_aa_MM *= V;
-				next_f_aa_Mm *= V;
-				next_f_aa_mm *= V;
-				
-				// Copy.............................................................................
-				
-				f_AA_MM = next_f_AA_MM;
-				f_AA_Mm = next_f_AA_Mm;
-				f_AA_mm = next_f_AA_mm;
-				f_Aa_MM = next_f_Aa_MM;
-				f_Aa_Mm = next_f_Aa_Mm;
-				f_Aa_mm = next_f_Aa_mm;
-				f_aa_MM = next_f_aa_MM;
-				f_aa_Mm = next_f_aa_Mm;
-				f_aa_mm = next_f_aa_mm;
-			
-				// Normalise plant frequencies to add up to 1.......................................
-				
-				totalplants = f_AA_MM + f_AA_Mm + f_AA_mm + f_Aa_MM + f_Aa_Mm + f_Aa_mm + f_aa_MM + f_aa_Mm + f_aa_mm;
-				if (totalplants > 0)
-				{
-					f_AA_MM /= totalplants;
-					f_AA_Mm /= totalplants;
-					f_AA_mm /= totalplants;
-					f_Aa_MM /= totalplants;
-					f_Aa_Mm /= totalplants;
-					f_Aa_mm /= totalplants;
-					f_aa_MM /= totalplants;
-					f_aa_Mm /= totalplants;
-					f_aa_mm /= totalplants;
-				}
-			}
+// Random numbers, for --popsize. Each run has its own stream, keyed by the seed, Q, F and the start
+// frequencies, so that results don't depend on the number of threads or the order cells are run in.
+// The generator is counter-based (SplitMix64): the nth number of a stream is a hash of key + n.
+
+struct rngstream
+{
+	uint64_t key;
+	uint64_t counter;
+};
+
+static inline uint64_t mix64 (uint64_t x)
+{
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+void startstream (struct rngstream * stream, float Q, float F, double * f)
+{
+	uint32_t bits[2];
+	uint64_t value;
+	int n;
 	
-			// Calculate and save results...
-			
-			female = f_AA_MM + f_AA_Mm + f_AA_mm;
-			male = f_Aa_mm + f_aa_mm;
-			inconstant = f_Aa_MM + f_Aa_Mm + f_aa_MM + f_aa_Mm;
-			
-			if (male > threshold && female > threshold && inconstant > threshold)
-			{
-				result[x][y] = SSD;
-			} else if (male > threshold && female > threshold) {
-				result[x][y] = DIO;
-			} else if (female > threshold && inconstant > threshold) {
-				result[x][y] = PGD;
-			} else if (male > threshold && inconstant > threshold) {
-				result[x][y] = PAD;
-			} else if (inconstant > threshold) {
-				result[x][y] = INC;
-			} else {
-				result[x][y] = 0;
-			}
-			
-			if (onerun == 0 && gnuplot)
+	memcpy(&bits[0], &Q, sizeof(float));
+	memcpy(&bits[1], &F, sizeof(float));
+	stream->key = mix64(seed) ^ mix64(((uint64_t) bits[0] << 32) | bits[1]);
+	for (n = 0; n < ngenotypes; n++)
+	{
+		memcpy(&value, &f[n], sizeof(double));
+		stream->key = mix64(stream->key ^ value);
+	}
+	stream->counter = 0;
+	
+	return;
+}
+
+// A uniform random number in (0, 1)...
+
+static inline double uniform (struct rngstream * stream)
+{
+	return ((mix64(stream->key + 0x9e3779b97f4a7c15ULL * ++stream->counter) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+// A draw from the binomial distribution with n trials and probability p (n is a whole number, held as
+// a double). Small means are done by inversion; larger ones by the BTPE algorithm of Kachitvichyanukul
+// and Schmeiser (1988), which takes about the same time whatever the mean.
+
+double binomial (struct rngstream * stream, double n, double p)
+{
+	double q, np, qn, px, u, v, bound;
+	double fm, m, p1, xm, xl, xr, c, laml, lamr, p2, p3, p4;
+	double a, s, ratio, rho, t, logv, nrq, x, y, k, i;
+	double x1, x2, f1, f2, z, z2, w, w2;
+	
+	if (n <= 0 || p <= 0) return 0;
+	if (p >= 1) return n;
+	if (p > 0.5) return n - binomial(stream, n, 1 - p);
+	
+	q = 1 - p;
+	np = n * p;
+	
+	if (np < INVERSIONMEAN)
+	{
+		qn = exp(n * log1p(-p));
+		bound = fmin(n, np + 10 * sqrt(np * q + 1));
+		
+		for (;;)
+		{
+			x = 0;
+			px = qn;
+			u = uniform(stream);
+			while (u > px)
 			{
-				fprintf(textfile, "%f", female);
-				if (x == subdivisions - 1)
-				{
-					fprintf(textfile, "\n");
-				} else {
-					fprintf(textfile, "\t");
-				}
+				x++;
+				if (x > bound) break;
+				u -= px;
+				px = px * (n - x + 1) * p / (x * q);
 			}
-			
-			if (onerun) break;
+			if (x <= bound) return x;
 		}
-		if (onerun) break;
 	}
 	
-	if (onerun == 0)
+	// BTPE: the distribution is covered by a triangle (where a draw is accepted at once), two
+	// parallelograms and two exponential tails; draws outside the triangle are accepted or rejected
+	// by comparing with the ratio of probabilities, using a squeeze where that would be slow...
+	
+	nrq = np * q;
+	fm = np + p;
+	m = floor(fm);
+	p1 = floor(2.195 * sqrt(nrq) - 4.6 * q) + 0.5;
+	xm = m + 0.5;
+	xl = xm - p1;
+	xr = xm + p1;
+	c = 0.134 + 20.5 / (15.3 + m);
+	a = (fm - xl) / (fm - xl * p);
+	laml = a * (1 + a / 2);
+	a = (xr - fm) / (xr * q);
+	lamr = a * (1 + a / 2);
+	p2 = p1 * (1 + 2 * c);
+	p3 = p2 + c / laml;
+	p4 = p3 + c / lamr;
+	
+	for (;;)
 	{
-		drawbmp(bmp_filename, 1);
-		printf("Saved %s\n", bmp_filename);
-	} else {
-		printf("Females       Males         Inconstants\n");
-		printf("%.6f      %.6f      %.6f\n\n", female, male, inconstant);
-
-		printf("Genotype frequencies, as notated by E&B (2007), or C&C (2012):\n\n");
+		u = uniform(stream) * p4;
+		v = uniform(stream);
+		
+		if (u <= p1) return floor(xm - p1 * v + u);
+		
+		if (u <= p2)
+		{
+			x = xl + (u - p1) / c;
+			v = v * c + 1 - fabs(m - x + 0.5) / p1;
+			if (v > 1) continue;
+			y = floor(x);
+		} else if (u <= p3) {
+			y = floor(xl + log(v) / laml);
+			if (y < 0) continue;
+			v = v * (u - p2) * laml;
+		} else {
+			y = floor(xr - log(v) / lamr);
+			if (y > n) continue;
+			v = v * (u - p3) * lamr;
+		}
+		
+		k = fabs(y - m);
+		if (k <= 20 || k >= nrq / 2 - 1)
+		{
+			// Explicit ratio of probabilities, f(y) / f(m)...
+			
+			s = p / q;
+			a = s * (n + 1);
+			ratio = 1;
+			if (m < y)
+			{
+				for (i = m + 1; i <= y; i++) ratio *= a / i - s;
+			} else if (m > y) {
+				for (i = y + 1; i <= m; i++) ratio /= a / i - s;
+			}
+			if (v <= ratio) return y;
+			continue;
+		}
+		
+		// Squeeze, and failing that, Stirling's formula for the log of the ratio...
 		
-		printf("E&B:  AA MM     AA Mm     AA mm     Aa MM     Aa Mm     Aa mm     aa MM     aa Mm     aa mm\n");
-		printf("C&C:  mm AA     mm Aa     mm aa     Mm AA     Mm Aa     Mm aa     MM AA     MM Aa     MM aa\n");
-		printf("      %.6f  %.6f  %.6f  %.6f  %.6f  %.6f  %.6f  %.6f  %.6f\n\n", f_AA_MM, f_AA_Mm, f_AA_mm, f_Aa_MM, f_Aa_Mm, f_Aa_mm, f_aa_MM, f_aa_Mm, f_aa_mm);
+		rho = (k / nrq) * ((k * (k / 3 + 0.625) + 1.0 / 6) / nrq + 0.5);
+		t = -k * k / (2 * nrq);
+		logv = log(v);
+		if (logv < t - rho) return y;
+		if (logv > t + rho) continue;
 		
-		if (male > threshold && female > threshold && inconstant > threshold)
+		x1 = y + 1;
+		f1 = m + 1;
+		z = n + 1 - m;
+		w = n - y + 1;
+		x2 = x1 * x1;
+		f2 = f1 * f1;
+		z2 = z * z;
+		w2 = w * w;
+		if (logv <= xm * log(f1 / x1) + (n - m + 0.5) * log(z / w) + (y - m) * log(w * p / (x1 * q))
+			+ (13680 - (462 - (132 - (99 - 140 / f2) / f2) / f2) / f2) / f1 / 166320
+			+ (13680 - (462 - (132 - (99 - 140 / z2) / z2) / z2) / z2) / z / 166320
+			+ (13680 - (462 - (132 - (99 - 140 / x2) / x2) / x2) / x2) / x1 / 166320
+			+ (13680 - (462 - (132 - (99 - 140 / w2) / w2) / w2) / w2) / w / 166320)
+		{
+			return y;
+		}
+	}
+}
+
+// One Wright-Fisher generation: replace the expected frequencies f[] with those of popsize plants
+// drawn from them, i.e. a multinomial draw, made as a binomial draw for each genotype in turn from
+// the plants not yet accounted for. If there are no plants to draw from, all the frequencies are 0.
+
+void drawgeneration (double * f, struct rngstream * stream)
+{
+	double total = 0;
+	double left = popsize;
+	double count;
+	int n;
+	
+	for (n = 0; n < ngenotypes; n++)
+	{
+		if (f[n] > 0) total += f[n];		// (Not NaN)
+	}
+	
+	for (n = 0; n < ngenotypes; n++)
+	{
+		if (total > 0 && f[n] > 0 && left > 0)
 		{
-			printf("Final state: SSD\n");
-		} else if (male > threshold && female > threshold) {
-			printf("Final state: DIO\n");
-		} else if (female > threshold && inconstant > threshold) {
-			printf("Final state: PGD\n");
-		} else if (male > threshold && inconstant > threshold) {
-			printf("Final state: PAD\n");
-		} else if (inconstant > threshold) {
-			printf("Final state: INC\n");
+			count = (f[n] >= total) ? left : binomial(stream, left, f[n] / total);
+			total -= f[n];
 		} else {
-			printf("Final state: ???\n");
+			count = 0;
 		}
+		left -= count;
+		f[n] = count / popsize;
+	}
+	
+	return;
+}
+
+// For --replicates: each replicate's own stream (replicate r of a cell)...
+
+void replicatestream (struct rngstream * stream, float Q, float F, const double * start, long long r)
+{
+	startstream(stream, Q, F, (double *) start);
+	stream->key = mix64(stream->key + r);
+	
+	return;
+}
+
+// ...and what has become of the invader in it (the inconstants, or with --pgd the males, which
+// start out rare): LOST, FIXED (the type it was invading, the males or with --pgd the inconstants,
+// has gone instead), or neither yet (0).
+
+int replicateoutcome (double * f)
+{
+	double invader = 0;
+	double resident = 0;
+	int n;
+	
+	for (n = 0; n < ngenotypes; n++)
+	{
+		if (phenotypes[n] == (pgd ? MALE : INCONSTANT)) invader += f[n];
+		if (phenotypes[n] == (pgd ? INCONSTANT : MALE)) resident += f[n];
 	}
 	
+	if (invader == 0) return LOST;
+	if (resident == 0) return FIXED;
+	
 	return 0;
 }
+
+// Position along an axis of the lattice (--lattice) that index i (up to size beyond either edge) stands
+// for: beyond the edges, the lattice is reflected, so that no pollen is lost there.
+
+static inline int reflectindex (int i, int size)
+{
+	if (i < 0) return -i - 1;
+	if (i >= size) return 2 * size - i - 1;
+	return i;
+}
+
+// The built-in recursion, in each of the available precisions (see model2_kernel.h)...
+
+#define real float
+#define REAL_MIN FLT_MIN
+#define REAL_EPSILON FLT_EPSILON
+#define wide double
+#define KERNEL(name) name##_float
+#include "model2_kernel.h"
+#undef real
+#undef REAL_MIN
+#undef REAL_EPSILON
+#undef wide
+#undef KERNEL
+
+#define real double
+#define REAL_MIN DBL_MIN
+#define REAL_EPSILON DBL_EPSILON
+#define wide double
+#define KERNEL(name) name##_double
+#include "model2_kernel.h"
+#undef real
+#undef REAL_MIN
+#undef REAL_EPSILON
+#undef wide
+#undef KERNEL
+
+#define real long double
+#define REAL_MIN LDBL_MIN
+#define REAL_EPSILON LDBL_EPSILON
+#define wide long double
+#define KERNEL(name) name##_longdouble
+#include "model2_kernel.h"
+#undef real
+#undef REAL_MIN
+#undef REAL_EPSILON
+#undef wide
+#undef KERNEL
+
+// ...and once more with dual numbers, for the derivatives of a generation (see generationjacobian_dual())...
+
+#define real double complex
+#define REAL_MIN DBL_MIN
+#define REAL_EPSILON DBL_EPSILON
+#define wide double complex
+#define KERNEL(name) name##_dual
+#define DERIVATIVES
+#include "model2_kernel.h"
+#undef real
+#undef REAL_MIN
+#undef REAL_EPSILON
+#undef wide
+#undef KERNEL
+#undef DERIVATIVES
+
+#include "model2_frozen.h"
+
+simulate_function specialise (int whichprecision, const char ** description)
+{
+	if (whichprecision == DOUBLE) return specialise_double(description);
+	if (whichprecision == LONGDOUBLE) return specialise_longdouble(description);
+	return specialise_float(description);
+}
+
+// Pick the specialisation, in the chosen precision, for the current parameters. If the results are
+// to be compared with something else (--lazynorm or --compareprecision), also set reference_simulate.
+
+void choosespecialisation (void)
+{
+	const char * referencedescription;
+	
+	builtin_simulate = specialise(precision, &specialisation);
+	
+	if (precision == DOUBLE) builtin_simulatetile = simulate_tile_double;
+	else if (precision == LONGDOUBLE) builtin_simulatetile = simulate_tile_longdouble;
+	else builtin_simulatetile = simulate_tile_float;
+	
+	if (precision == DOUBLE) builtin_simulatereplicates = simulate_replicates_double;
+	else if (precision == LONGDOUBLE) builtin_simulatereplicates = simulate_replicates_longdouble;
+	else builtin_simulatereplicates = simulate_replicates_float;
+	
+	if (precision == DOUBLE) builtin_simulateparameters = simulate_parameters_double;
+	else if (precision == LONGDOUBLE) builtin_simulateparameters = simulate_parameters_longdouble;
+	else builtin_simulateparameters = simulate_parameters_float;
+	
+	if (precision == DOUBLE) builtin_simulatelattice = simulate_lattice_double;
+	else if (precision == LONGDOUBLE) builtin_simulatelattice = simulate_lattice_longdouble;
+	else builtin_simulatelattice = simulate_lattice_float;
+	
+	if (precision == LONGDOUBLE) builtin_generation = generation_longdouble;		// Never float, which is too coarse for Newton's method
+	else builtin_generation = generation_double;
+	
+	if (lazynorm)
+	{
+		reference_simulate = builtin_simulate;
+		if (precision == DOUBLE) builtin_simulate = simulate_lazy_double;
+		else if (precision == LONGDOUBLE) builtin_simulate = simulate_lazy_longdouble;
+		else builtin_simulate = simulate_lazy_float;
+		specialisation = "division-free, with lazy normalisation";
+		sprintf(comparisonname, "lazy normalisation, against the exact recursion");
+	}
+	
+	if (compareprecision)
+	{
+		reference_simulate = specialise(compareprecision, &referencedescription);
+		sprintf(comparisonname, "%s%s, against the exact recursion in %s", precisionnames[precision], lazynorm ? " with lazy normalisation" : "", precisionnames[compareprecision]);
+	}
+	
+	return;
+}
+
+void startcellfrom (double * f, int frompgd)
+{
+	int n;
+	
+	for (n = 0; n < ngenotypes; n++)
+	{
+		f[n] = frompgd ? start_pgd[n] : start_dio[n];
+	}
+	
+	return;
+}
+
+void startcell (double * f)
+{
+	startcellfrom(f, pgd);
+	
+	return;
+}
+
+// Run whichever recursion is in use, from the frequencies already in f[]. Any noteworthy events
+// (e.g. SUBNORMAL) are recorded in flags. Returns the number of generations until the frequencies
+// converged (see simulate_body()), if that's being checked, otherwise endpoint.
+
+int runstart (double * f, float Q, float F, int * flags)
+{
+	float loaded[MAXGENOTYPES];
+	int generations = endpoint;
+	int n;
+	
+	*flags = 0;
+	
+	if (kernel_simulate)
+	{
+		for (n = 0; n < ngenotypes; n++) loaded[n] = f[n];
+		kernel_simulate(loaded, endpoint, Q, F, h, S, d, V, PSatF, ppY);
+		for (n = 0; n < ngenotypes; n++) f[n] = loaded[n];
+	} else {
+		generations = builtin_simulate(f, Q, F, flags);
+	}
+	
+	return generations;
+}
+
+// ...from the PGD or DIO start...
+
+int runcellfrom (double * f, float Q, float F, int * flags, int frompgd)
+{
+	startcellfrom(f, frompgd);
+	
+	return runstart(f, Q, F, flags);
+}
+
+// ...or from the one given by --pgd.
+
+int runcell (double * f, float Q, float F, int * flags)
+{
+	return runcellfrom(f, Q, F, flags, pgd);
+}
+
+// Total frequencies of females, males and inconstants. These are added up in the precision in use,
+// so that single precision results are exactly as they always were.
+
+void phenotypesums (double * f, double * female, double * male, double * inconstant)
+{
+	float single[4] = {0, 0, 0, 0};
+	long double extended[4] = {0, 0, 0, 0};
+	int n;
+	
+	for (n = 0; n < ngenotypes; n++)
+	{
+		single[phenotypes[n]] += (float) f[n];
+		extended[phenotypes[n]] += f[n];
+	}
+	
+	if (precision == SINGLE)
+	{
+		*female = single[FEMALE];
+		*male = single[MALE];
+		*inconstant = single[INCONSTANT];
+	} else {
+		*female = extended[FEMALE];
+		*male = extended[MALE];
+		*inconstant = extended[INCONSTANT];
+	}
+	
+	return;
+}
+
+int classify (double female, double male, double inconstant)
+{
+	if (male > threshold && female > threshold && inconstant > threshold)
+	{
+		return SSD;
+	} else if (male > threshold && female > threshold) {
+		return DIO;
+	} else if (female > threshold && inconstant > threshold) {
+		return PGD;
+	} else if (male > threshold && inconstant > threshold) {
+		return PAD;
+	} else if (inconstant > threshold) {
+		return INC;
+	} else {
+		return 0;
+	}
+}
+
+// Accuracy reports. comparecell() is given the frequencies from the recursion in use and from the
+// exact (reference) recursion for the same cell, and keeps a tally of the differences.
+
+void comparecell (double * f, double * reference)
+{
+	double female, male, inconstant;
+	int regime;
+	int n;
+	
+	for (n = 0; n < ngenotypes; n++)
+	{
+		if (fabs(f[n] - reference[n]) > compared_maxerror) compared_maxerror = fabs(f[n] - reference[n]);
+	}
+	
+	phenotypesums(f, &female, &male, &inconstant);
+	regime = classify(female, male, inconstant);
+	phenotypesums(reference, &female, &male, &inconstant);
+	if (regime != classify(female, male, inconstant)) compared_mismatches++;
+	
+	compared_cells++;
+	
+	return;
+}
+
+void printaccuracy (char * sampling)
+{
+	printf("Accuracy of %s%s:\n", comparisonname, sampling);
+	printf("  Cells compared = %d\n", compared_cells);
+	printf("  Largest difference in a genotype frequency = %G\n", compared_maxerror);
+	printf("  Cells classified differently = %d\n\n", compared_mismatches);
+	
+	return;
+}
+
+double seconds (void)
+{
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+#ifdef __linux__
+int opencounter (int which)
+{
+	struct perf_event_attr attr;
+	
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;		// Only user space, which is all that most systems allow
+	attr.exclude_hv = 1;
+	
+	if (which == CYCLES) attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	if (which == INSTRUCTIONS) attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	if (which == CACHEMISSES) attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	if (which == FPASSISTS)
+	{
+		attr.type = PERF_TYPE_RAW;
+		attr.config = fpassistevent;
+	}
+	if (which >= L1DREADS && which <= LLMISSES)
+	{
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = (which <= L1DMISSES ? PERF_COUNT_HW_CACHE_L1D : PERF_COUNT_HW_CACHE_LL)
+			| (PERF_COUNT_HW_CACHE_OP_READ << 8)
+			| ((which == L1DMISSES || which == LLMISSES ? PERF_COUNT_HW_CACHE_RESULT_MISS : PERF_COUNT_HW_CACHE_RESULT_ACCESS) << 16);
+	}
+	
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+// Open the counters for --perfcounters. Each counter only counts the thread that opened it, so with
+// OpenMP every thread of the team opens its own (the same threads are used again for the sweep).
+
+void opencounters (void)
+{
+	int c;
+	
+	for (c = 0; c < NCOUNTERS; c++)
+	{
+		countervalue[c] = 0;
+		countererror[c] = NULL;
+	}
+	
+#ifdef __linux__
+#ifdef _OPENMP
+	#pragma omp parallel private(c)
+#endif
+	{
+		int t = 0;
+		int fd;
+		
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+		#pragma omp critical (counters)
+		if (omp_get_num_threads() > counterthreads) counterthreads = omp_get_num_threads();
+#else
+		counterthreads = 1;
+#endif
+		
+		for (c = 0; c < NCOUNTERS && t < MAXTHREADS; c++)
+		{
+			fd = opencounter(c);
+			counterfd[t][c] = fd;
+			if (fd < 0)
+			{
+#ifdef _OPENMP
+				#pragma omp critical (counters)
+#endif
+				countererror[c] = strerror(errno);
+			}
+		}
+	}
+	
+	if (counterthreads > MAXTHREADS) counterthreads = MAXTHREADS;
+#else
+	for (c = 0; c < NCOUNTERS; c++)
+	{
+		countererror[c] = "not supported on this system";
+	}
+#endif
+	
+	for (c = 0; c < NCOUNTERS; c++)
+	{
+		if (countererror[c]) countervalue[c] = -1;
+	}
+	
+	return;
+}
+
+// Start and stop the counters (of every thread), adding the counts so far to countervalue[].
+
+void startcounters (void)
+{
+#ifdef __linux__
+	int c; int t;
+	
+	for (t = 0; t < counterthreads; t++)
+	{
+		for (c = 0; c < NCOUNTERS; c++)
+		{
+			if (countererror[c] == NULL)
+			{
+				ioctl(counterfd[t][c], PERF_EVENT_IOC_RESET, 0);
+				ioctl(counterfd[t][c], PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+	}
+#endif
+	return;
+}
+
+void stopcounters (void)
+{
+#ifdef __linux__
+	long long value;
+	int c; int t;
+	
+	for (t = 0; t < counterthreads; t++)
+	{
+		for (c = 0; c < NCOUNTERS; c++)
+		{
+			if (countererror[c] == NULL)
+			{
+				ioctl(counterfd[t][c], PERF_EVENT_IOC_DISABLE, 0);
+				if (read(counterfd[t][c], &value, sizeof(value)) == sizeof(value)) countervalue[c] += value;
+			}
+		}
+	}
+#endif
+	return;
+}
+
+// Reports for --timing and --perfcounters, in the same style as the settings at the start...
+
+// Percentage of cache reads that hit, from the counts (-1 if either couldn't be counted).
+
+double hitrate (long long reads, long long misses)
+{
+	if (reads > 0 && misses >= 0) return 100 - 100.0 * misses / reads;
+	
+	return -1;
+}
+
+void printtiming (void)
+{
+	double total = 0;
+	int n;
+	
+	for (n = 0; n < NPHASES; n++) total += phasetime[n];
+	
+	printf("Timing:\n");
+	for (n = 0; n < NPHASES; n++)
+	{
+		printf("  %s = %.6f s (%.1f%%)\n", phasenames[n], phasetime[n], total > 0 ? 100 * phasetime[n] / total : 0);
+	}
+	printf("  Total = %.6f s\n\n", total);
+	
+	if (perfcounters)
+	{
+		printf("Hardware counters (recursion only, all threads):\n");
+		for (n = 0; n < NCOUNTERS; n++)
+		{
+			if (countererror[n])
+			{
+				printf("  %s = unavailable (%s)\n", counternames[n], countererror[n]);
+			} else {
+				printf("  %s = %lld\n", counternames[n], countervalue[n]);
+			}
+		}
+		if (countervalue[CYCLES] > 0 && countervalue[INSTRUCTIONS] >= 0)
+		{
+			printf("  Instructions per cycle = %.2f\n", (double) countervalue[INSTRUCTIONS] / countervalue[CYCLES]);
+		}
+		if (hitrate(countervalue[L1DREADS], countervalue[L1DMISSES]) >= 0)
+		{
+			printf("  L1D hit rate = %.2f%%\n", hitrate(countervalue[L1DREADS], countervalue[L1DMISSES]));
+		}
+		if (hitrate(countervalue[LLREADS], countervalue[LLMISSES]) >= 0)
+		{
+			printf("  LL hit rate = %.2f%%\n", hitrate(countervalue[LLREADS], countervalue[LLMISSES]));
+		}
+		printf("\n");
+	}
+	
+	return;
+}
+
+void savetiming (char * filename)
+{
+	FILE * outfile;
+	int n;
+	
+	outfile = fopen(filename, "w");
+	if (outfile == NULL)
+	{
+		printf("Failed to create output file!\n");
+		exit(1);
+	}
+	
+	fprintf(outfile, "{\n  \"phases\": {");
+	for (n = 0; n < NPHASES; n++)
+	{
+		fprintf(outfile, "%s\"%s\": %.6f", n ? ", " : "", phasekeys[n], phasetime[n]);
+	}
+	fprintf(outfile, "}");
+	
+	if (perfcounters)
+	{
+		fprintf(outfile, ",\n  \"counters\": {");
+		for (n = 0; n < NCOUNTERS; n++)
+		{
+			if (countererror[n])
+			{
+				fprintf(outfile, "%s\"%s\": null", n ? ", " : "", counterkeys[n]);
+			} else {
+				fprintf(outfile, "%s\"%s\": %lld", n ? ", " : "", counterkeys[n], countervalue[n]);
+			}
+		}
+		fprintf(outfile, "}");
+	}
+	
+	fprintf(outfile, "\n}\n");
+	fclose(outfile);
+	
+	printf("Saved %s\n\n", filename);
+	
+	return;
+}
+
+// Called by sweep() as each cell is finished (by any thread). The counts, and the time of the next
+// report, are only touched with atomic operations outside the critical section; the report itself is
+// only made by a thread that finds the interval has passed. Once the final line (with the time taken)
+// is out, progress_next is set to infinity, so that no thread still on its way in reports after it.
+
+void reportprogress (long long generations)
+{
+	int done;
+	int total = progress_total;
+	double now;
+	double elapsed;
+	double rate;
+	double eta;
+	double next;
+	long long summed;
+	int shown;
+	
+#ifdef _OPENMP
+	#pragma omp atomic
+#endif
+	progress_generations += generations;
+	
+#ifdef _OPENMP
+	#pragma omp atomic capture
+#endif
+	done = ++progress_cells;
+	
+#ifdef _OPENMP
+	#pragma omp atomic read
+#endif
+	next = progress_next;
+	
+	now = seconds();
+	if (now < next && done < total) return;
+	
+#ifdef _OPENMP
+	#pragma omp critical (progress)
+#endif
+	{
+		next = progress_next;		// (Only ever written in here, so no atomic needed to read it)
+		if (next < INFINITY && (now >= next || done == total))
+		{
+			next = (done == total) ? INFINITY : now + PROGRESSINTERVAL;
+#ifdef _OPENMP
+			#pragma omp atomic write
+#endif
+			progress_next = next;
+			
+#ifdef _OPENMP
+			#pragma omp atomic read
+#endif
+			summed = progress_generations;
+			
+			elapsed = now - progress_start;
+			rate = elapsed > 0 ? done / elapsed : 0;
+			eta = rate > 0 ? (total - done) / rate : 0;
+			
+			if (progress == MACHINE)
+			{
+				fprintf(stderr, "{\"done\": %d, \"total\": %d, \"elapsed\": %.1f, \"cells_per_s\": %.1f, \"generations_per_s\": %.0f, \"eta\": %.1f}\n",
+					done, total, elapsed, rate, elapsed > 0 ? summed / elapsed : 0, eta);
+			} else {
+				shown = (int) (done == total ? elapsed : eta + 0.5);		// Time taken at the end, otherwise time left
+				fprintf(stderr, "\r%d of %d cells (%.1f%%), %.0f cells/s, %.3G generations/s, %s %d:%02d:%02d   ",
+					done, total, 100.0 * done / total, rate, elapsed > 0 ? summed / elapsed : 0,
+					done == total ? "took" : "ETA", shown / 3600, shown / 60 % 60, shown % 60);
+				if (done == total) fprintf(stderr, "\n");
+			}
+			fflush(stderr);
+		}
+	}
+	
+	return;
+}
+
+int ** allocategrid (int size)
+{
+	int ** grid;
+	int n;
+	
+	grid = malloc(size * sizeof(int*));
+	if (grid == NULL)
+	{
+		printf("Out of memory!\n");
+		exit(1);
+	}
+	for (n = 0; n < size; n++)
+	{
+		grid[n] = malloc(size * sizeof(int));
+		if (grid[n] == NULL)
+		{
+			printf("Out of memory!\n");
+			exit(1);
+		}
+	}
+	
+	return grid;
+}
+
+void allocateresult (int size)
+{
+	result = allocategrid(size);
+	if (itermap) iterations = allocategrid(size);
+	if (bistable) altresult = allocategrid(size);
+	
+	return;
+}
+
+// Tally the differences between one cell's results (f[] and regime) and what they should be (expected[]
+// and expectedregime), for --verify and --verifystate.
+
+void verifycell (float Q, float F, double * f, int regime, double * expected, int expectedregime)
+{
+	int n;
+	
+	for (n = 0; n < ngenotypes; n++)
+	{
+		if (fabs(f[n] - expected[n]) > verify_maxerror)
+		{
+			verify_maxerror = fabs(f[n] - expected[n]);
+			verify_maxQ = Q;
+			verify_maxF = F;
+		}
+	}
+	
+	if (regime != expectedregime)
+	{
+		if (verify_mismatches < VERIFYLIST)
+		{
+			verify_listQ[verify_mismatches] = Q;
+			verify_listF[verify_mismatches] = F;
+			verify_listregime[verify_mismatches] = regime;
+			verify_listexpected[verify_mismatches] = expectedregime;
+		}
+		verify_mismatches++;
+	}
+	
+	verify_cells++;
+	
+	return;
+}
+
+void printverify (char * sampling)
+{
+	int n;
+	
+	printf("Verification against %s%s:\n", verifyname, sampling);
+	printf("  Cells compared = %d\n", verify_cells);
+	printf("  Largest difference in a genotype frequency = %G", verify_maxerror);
+	if (verify_maxerror > 0) printf(" (at Q = %G, F = %G)", verify_maxQ, verify_maxF);
+	printf("\n");
+	printf("  Cells classified differently = %d\n", verify_mismatches);
+	for (n = 0; n < verify_mismatches && n < VERIFYLIST; n++)
+	{
+		printf("    Q = %G, F = %G: %s (should be %s)\n", verify_listQ[n], verify_listF[n], regimenames[verify_listregime[n]], regimenames[verify_listexpected[n]]);
+	}
+	if (verify_mismatches > VERIFYLIST) printf("    (and %d more)\n", verify_mismatches - VERIFYLIST);
+	printf("\n");
+	
+	return;
+}
+
+// --state files. The first line gives the size of the graph and the number of genotypes; then there's
+// a line per cell, with its coordinates in the graph, the regime, the period of the cycle it ended
+// up in (0 if none was found, or --cycles wasn't used; 1 for a fixed point) and the genotype frequencies.
+
+void savestates (char * filename)
+{
+	FILE * outfile;
+	int x; int y; int n;
+	
+	outfile = fopen(filename, "w");
+	if (outfile == NULL)
+	{
+		printf("Failed to create output file!\n");
+		exit(1);
+	}
+	
+	fprintf(outfile, "# subdivisions %d genotypes %d\n", subdivisions, ngenotypes);
+	
+	for (y = 0; y < subdivisions; y++)
+	{
+		for (x = 0; x < subdivisions; x++)
+		{
+			fprintf(outfile, "%d %d %s %d", x, y, regimenames[stateregimes[y * subdivisions + x]], stateperiods[y * subdivisions + x]);
+			for (n = 0; n < ngenotypes; n++)
+			{
+				fprintf(outfile, " %.17G", states[(y * subdivisions + x) * ngenotypes + n]);
+			}
+			fprintf(outfile, "\n");
+		}
+	}
+	fclose(outfile);
+	
+	printf("Saved %s\n", filename);
+	
+	return;
+}
+
+void loadstates (char * filename)
+{
+	FILE * infile;
+	char line[4096];
+	char regime[16];
+	char * position;
+	int size, genotypes;
+	int x, y, offset;
+	int period;
+	int cells = 0;
+	int n;
+	
+	infile = fopen(filename, "r");
+	if (infile == NULL)
+	{
+		printf("Failed to open %s!\n", filename);
+		exit(1);
+	}
+	
+	if (fgets(line, sizeof(line), infile) == NULL || sscanf(line, "# subdivisions %d genotypes %d", &size, &genotypes) != 2)
+	{
+		printf("%s is not a file saved by --state!\n", filename);
+		exit(1);
+	}
+	if (size != subdivisions || genotypes != ngenotypes)
+	{
+		printf("%s is for a %dx%d graph of %d genotypes; this run is %dx%d, of %d.\n", filename, size, size, genotypes, subdivisions, subdivisions, ngenotypes);
+		exit(1);
+	}
+	
+	goldenstates = malloc(subdivisions * subdivisions * ngenotypes * sizeof(double));
+	goldenregimes = malloc(subdivisions * subdivisions * sizeof(int));
+	if (goldenstates == NULL || goldenregimes == NULL)
+	{
+		printf("Out of memory!\n");
+		exit(1);
+	}
+	
+	while (fgets(line, sizeof(line), infile))
+	{
+		if (sscanf(line, "%d %d %15s %d%n", &x, &y, regime, &period, &offset) != 4 || x < 0 || x >= size || y < 0 || y >= size)
+		{
+			printf("Bad line in %s: %s", filename, line);
+			exit(1);
+		}
+		
+		goldenregimes[y * size + x] = 0;
+		for (n = 1; n <= INC; n++)
+		{
+			if (strcmp(regime, regimenames[n]) == 0) goldenregimes[y * size + x] = n;
+		}
+		
+		position = line + offset;
+		for (n = 0; n < ngenotypes; n++)
+		{
+			goldenstates[(y * size + x) * ngenotypes + n] = strtod(position, &position);
+		}
+		cells++;
+	}
+	fclose(infile);
+	
+	if (cells != size * size)
+	{
+		printf("%s has %d cells, but should have %d!\n", filename, cells, size * size);
+		exit(1);
+	}
+	
+	return;
+}
+
+// Here we map the X,Y coordinates of our output .bmp file onto Q and F parameters...
+
+void cellparameters (int x, int y, float * Q, float * F)
+{
+	float K;
+	float k;
+	
+	if (oldformat == 0)
+	{
+		*Q = (float) x / (subdivisions - 1);						// X axis: Q values 0 to 1
+		*F = (float) y / (subdivisions - 1);						// Y axis: F values 0 to 1
+	} else {
+		K = ((float) x / (subdivisions - 1)) * oldformatlimit;	// X axis: K values 0 to oldformatlimit
+		k = ((float) y / (subdivisions - 1)) * oldformatlimit;	// Y axis: k values 0 to oldformatlimit
+		
+		// But Q and F are the parameters actually used by the code, so calculate them:
+		*Q = 1 / (1 + K);
+		*F = 1 / (1 + k);
+	}
+	
+	return;
+}
+
+// For --engine grid: run every cell of the graph a tile at a time (see simulate_tile() in
+// model2_kernel.h), leaving the results in gridstates[] for sweep() to go through as usual. With
+// --bistable, each cell has two lanes, side by side: the usual start, then the other one. If
+// compiled with OpenMP, the tiles are shared out between threads.
+
+void gridsweep (void)
+{
+	int starts = bistable ? 2 : 1;
+	int lanes = subdivisions * subdivisions * starts;
+	int tilelanes = (tilesize < starts) ? starts : tilesize - tilesize % starts;		// Never splitting a cell's lanes
+	int tiles = (lanes + tilelanes - 1) / tilelanes;
+	float * Q;
+	float * F;
+	int tile;
+	int first;
+	int count;
+	int lane;
+	int n;
+	int x;
+	int y;
+	
+	Q = malloc(lanes * sizeof(float));
+	F = malloc(lanes * sizeof(float));
+	gridstates = malloc(lanes * ngenotypes * sizeof(double));
+	gridgenerations = malloc(lanes * sizeof(int));
+	if (Q == NULL || F == NULL || gridstates == NULL || gridgenerations == NULL)
+	{
+		printf("Out of memory!\n");
+		exit(1);
+	}
+	
+	for (y = 0; y < subdivisions; y++)
+	{
+		for (x = 0; x < subdivisions; x++)
+		{
+			for (n = 0; n < starts; n++)
+			{
+				lane = (y * subdivisions + x) * starts + n;
+				cellparameters(x, y, &Q[lane], &F[lane]);
+				startcellfrom(&gridstates[lane * ngenotypes], n ? !pgd : pgd);
+			}
+		}
+	}
+	
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic) private(first, count, n)
+#endif
+	for (tile = 0; tile < tiles; tile++)
+	{
+		first = tile * tilelanes;
+		count = (lanes - first < tilelanes) ? lanes - first : tilelanes;
+		
+		builtin_simulatetile(count, &Q[first], &F[first], &gridstates[first * ngenotypes], &gridgenerations[first]);
+		
+		if (progress)
+		{
+			for (n = 0; n < count; n += starts) reportprogress(gridgenerations[first + n] + (bistable ? gridgenerations[first + n + 1] : 0));
+		}
+	}
+	
+	free(Q);
+	free(F);
+	
+	return;
+}
+
+// Size of the L2 cache (of one core), in bytes.
+
+long l2cachesize (void)
+{
+	long size = 0;
+	
+#if defined(__linux__) && defined(_SC_LEVEL2_CACHE_SIZE)
+	size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+	
+	return size > 0 ? size : DEFAULTL2;
+}
+
+// For --tile auto (the default): choose the tile size for --engine grid. Each tile is run to the end
+// before the next is started, so its state (the frequencies of each genotype, the copy of them used
+// to check for convergence, Q, F and the cell numbers) should stay in the L2 cache throughout. Every
+// power of 2 from MINTILE cells up to what fits is timed for TUNEGENERATIONS generations, on cells
+// spread over the whole graph, along with the largest tile that fits, and the fastest is used. The
+// L1D and last level cache hit rates of each are shown too, if the counters are available.
+
+void tunetile (void)
+{
+	int realsize = (precision == DOUBLE) ? sizeof(double) : ((precision == LONGDOUBLE) ? sizeof(long double) : sizeof(float));
+	int cellbytes = 2 * ngenotypes * realsize + 2 * sizeof(float) + sizeof(int);
+	long l2 = l2cachesize();
+	int cells = subdivisions * subdivisions;
+	int fit = l2 / cellbytes;
+	int userendpoint = endpoint;
+	int fd[NCOUNTERS];
+	long long value[NCOUNTERS];
+	float * Q;
+	float * F;
+	double * f;
+	int * generations;
+	double best = 0;
+	double cost;
+	double start;
+	double elapsed;
+	int runs;
+	int size;
+	int cell;
+	int c;
+	int n;
+	
+	if (fit > cells) fit = cells;
+	if (fit < 1) fit = 1;
+	
+	Q = malloc(fit * sizeof(float));
+	F = malloc(fit * sizeof(float));
+	f = malloc(fit * ngenotypes * sizeof(double));
+	generations = malloc(fit * sizeof(int));
+	if (Q == NULL || F == NULL || f == NULL || generations == NULL)
+	{
+		printf("Out of memory!\n");
+		exit(1);
+	}
+	
+	for (c = L1DREADS; c <= LLMISSES; c++)
+	{
+#ifdef __linux__
+		fd[c] = opencounter(c);
+#else
+		fd[c] = -1;
+#endif
+	}
+	
+	printf("Tile sizes (L2 cache = %ld KiB, %d bytes per cell):\n", l2 / 1024, cellbytes);
+	
+	endpoint = TUNEGENERATIONS;
+	for (size = MINTILE; ; size *= 2)
+	{
+		if (size > fit) size = fit;
+		
+		for (n = 0; n < size; n++)
+		{
+			cell = (long long) n * cells / size;
+			cellparameters(cell % subdivisions, cell / subdivisions, &Q[n], &F[n]);
+		}
+		
+#ifdef __linux__
+		for (c = L1DREADS; c <= LLMISSES; c++)
+		{
+			if (fd[c] >= 0)
+			{
+				ioctl(fd[c], PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd[c], PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+#endif
+		
+		runs = 0;
+		start = seconds();
+		do
+		{
+			for (n = 0; n < size; n++) startcell(&f[n * ngenotypes]);
+			builtin_simulatetile(size, Q, F, f, generations);
+			runs++;
+			elapsed = seconds() - start;
+		} while (elapsed < TUNETIME);
+		
+		for (c = L1DREADS; c <= LLMISSES; c++)
+		{
+			value[c] = -1;
+#ifdef __linux__
+			if (fd[c] >= 0)
+			{
+				ioctl(fd[c], PERF_EVENT_IOC_DISABLE, 0);
+				if (read(fd[c], &value[c], sizeof(value[c])) != sizeof(value[c])) value[c] = -1;
+			}
+#endif
+		}
+		
+		cost = 1e9 * elapsed / ((double) runs * size * TUNEGENERATIONS);
+		printf("  %d cells (%d KiB) = %.3f ns per cell per generation", size, (int) ((long long) size * cellbytes / 1024), cost);
+		if (hitrate(value[L1DREADS], value[L1DMISSES]) >= 0 && hitrate(value[LLREADS], value[LLMISSES]) >= 0)
+		{
+			printf(", hit rates: L1D %.2f%%, LL %.2f%%\n", hitrate(value[L1DREADS], value[L1DMISSES]), hitrate(value[LLREADS], value[LLMISSES]));
+		} else {
+			printf(", hit rates unavailable\n");
+		}
+		
+		if (best == 0 || cost < best)
+		{
+			best = cost;
+			tilesize = size;
+		}
+		
+		if (size == fit) break;
+	}
+	endpoint = userendpoint;
+	
+#ifdef __linux__
+	for (c = L1DREADS; c <= LLMISSES; c++)
+	{
+		if (fd[c] >= 0) close(fd[c]);
+	}
+#endif
+	
+	free(Q);
+	free(F);
+	free(f);
+	free(generations);
+	
+	return;
+}
+
+// Run every combination of Q and F, filling in result[][] (and the Gnuplot file, if open). If compiled
+// with OpenMP, the rows are shared out between threads; the Gnuplot text is then written at the end,
+// so that it comes out in order. With --engine grid, the recursion has already been run, by gridsweep().
+
+void sweep (FILE * textfile)
+{
+	double f[MAXGENOTYPES];
+	double reference[MAXGENOTYPES];
+	double other[MAXGENOTYPES];
+	float frozen[MAXGENOTYPES];
+	double * females = NULL;
+	int starts = bistable ? 2 : 1;
+	int flags;
+	int otherflags;
+	int referenceflags;				// Kept apart, so that the reference run doesn't change the cell's period
+	int generations;
+	int othergenerations;
+	int regime;
+	int n;
+	double male;
+	double female;
+	double inconstant;
+	float Q;
+	float F;
+	int x;
+	int y;
+	double start;
+	
+	if (progress)
+	{
+		progress_cells = 0;
+		progress_total = subdivisions * subdivisions;
+		progress_generations = 0;
+		progress_start = seconds();
+		progress_next = progress_start + PROGRESSINTERVAL;
+	}
+	
+	if (textfile)
+	{
+		females = malloc(subdivisions * subdivisions * sizeof(double));
+		if (females == NULL)
+		{
+			printf("Out of memory!\n");
+			exit(1);
+		}
+	}
+	
+	start = seconds();
+	if (perfcounters) startcounters();
+	
+	if (engine == GRID) gridsweep();
+	
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic) private(f, reference, other, frozen, flags, otherflags, referenceflags, generations, othergenerations, regime, n, male, female, inconstant, Q, F, x)
+#endif
+	for (y = 0; y < subdivisions; y++)
+	{
+		for (x = 0; x < subdivisions; x++)
+		{
+			cellparameters(x, y, &Q, &F);
+			
+			if (gridstates)
+			{
+				for (n = 0; n < ngenotypes; n++) f[n] = gridstates[(y * subdivisions + x) * starts * ngenotypes + n];
+				generations = gridgenerations[(y * subdivisions + x) * starts];
+				flags = 0;
+			} else {
+				generations = runcell(f, Q, F, &flags);
+			}
+			if (itermap) iterations[x][y] = generations;
+			if (flags & SUBNORMAL)
+			{
+#ifdef _OPENMP
+				#pragma omp atomic
+#endif
+				subnormalcells++;
+			}
+			if (flags & CYCLE)
+			{
+#ifdef _OPENMP
+				#pragma omp critical (cycles)
+#endif
+				{
+					cyclecells++;
+					if (PERIOD(flags) > longestperiod) longestperiod = PERIOD(flags);
+				}
+			}
+			
+			// With --bistable, the same cell from the other start...
+			
+			othergenerations = 0;
+			if (bistable)
+			{
+				if (gridstates)
+				{
+					for (n = 0; n < ngenotypes; n++) other[n] = gridstates[((y * subdivisions + x) * 2 + 1) * ngenotypes + n];
+					othergenerations = gridgenerations[(y * subdivisions + x) * 2 + 1];
+				} else {
+					othergenerations = runcellfrom(other, Q, F, &otherflags, !pgd);
+				}
+				phenotypesums(other, &female, &male, &inconstant);
+				altresult[x][y] = classify(female, male, inconstant);
+			}
+			
+			// Calculate and save results...
+			
+			phenotypesums(f, &female, &male, &inconstant);
+			result[x][y] = classify(female, male, inconstant);
+			
+			if (reference_simulate && (y * subdivisions + x) % ACCURACYSAMPLE == 0)
+			{
+				startcell(reference);
+				referenceflags = 0;
+				reference_simulate(reference, Q, F, &referenceflags);
+#ifdef _OPENMP
+				#pragma omp critical
+#endif
+				comparecell(f, reference);
+			}
+			
+			if (females) females[y * subdivisions + x] = female;
+			
+			if (verify && (y * subdivisions + x) % verify == 0)
+			{
+				regime = frozen_reference(Q, F, frozen);
+				for (n = 0; n < ngenotypes; n++) reference[n] = frozen[n];
+#ifdef _OPENMP
+				#pragma omp critical (verify)
+#endif
+				verifycell(Q, F, f, result[x][y], reference, regime);
+			}
+			
+			if (goldenstates)
+			{
+#ifdef _OPENMP
+				#pragma omp critical (verify)
+#endif
+				verifycell(Q, F, f, result[x][y], &goldenstates[(y * subdivisions + x) * ngenotypes], goldenregimes[y * subdivisions + x]);
+			}
+			
+			if (states)
+			{
+				for (n = 0; n < ngenotypes; n++) states[(y * subdivisions + x) * ngenotypes + n] = f[n];
+				stateregimes[y * subdivisions + x] = result[x][y];
+				stateperiods[y * subdivisions + x] = PERIOD(flags);
+			}
+			
+			if (progress && gridstates == NULL) reportprogress(stopearly || cycles ? generations + othergenerations : endpoint * starts);
+		}
+	}
+	
+	if (perfcounters) stopcounters();
+	phasetime[RECURSION] += seconds() - start;
+	
+	if (gridstates)
+	{
+		free(gridstates);
+		free(gridgenerations);
+		gridstates = NULL;
+		gridgenerations = NULL;
+	}
+	
+	start = seconds();
+	if (textfile)
+	{
+		for (y = 0; y < subdivisions; y++)
+		{
+			for (x = 0; x < subdivisions; x++)
+			{
+				fprintf(textfile, "%f", females[y * subdivisions + x]);
+				if (x == subdivisions - 1)
+				{
+					fprintf(textfile, "\n");
+				} else {
+					fprintf(textfile, "\t");
+				}
+			}
+		}
+		free(females);
+	}
+	phasetime[TEXTOUTPUT] += seconds() - start;
+	
+	return;
+}
+
+// Summary of the --bistable results: how many cells end differently from the two starts, and in
+// which pairs of states.
+
+void printbistable (void)
+{
+	int pairs[6][6];
+	int differing = 0;
+	int dio = pgd ? 0 : 1;		// Which of result[][] and altresult[][] is from the DIO start
+	int a;
+	int b;
+	int x;
+	int y;
+	
+	memset(pairs, 0, sizeof(pairs));
+	for (x = 0; x < subdivisions; x++)
+	{
+		for (y = 0; y < subdivisions; y++)
+		{
+			a = dio ? result[x][y] : altresult[x][y];
+			b = dio ? altresult[x][y] : result[x][y];
+			pairs[a][b]++;
+			if (a != b) differing++;
+		}
+	}
+	
+	printf("\nCells whose final state depends on the start = %d (of %d)\n", differing, subdivisions * subdivisions);
+	for (a = 0; a < 6; a++)
+	{
+		for (b = 0; b < 6; b++)
+		{
+			if (a != b && pairs[a][b])
+			{
+				printf("  %s from DIO, %s from PGD = %d\n", regimenames[a], regimenames[b], pairs[a][b]);
+			}
+		}
+	}
+	
+	return;
+}
+
+// Summary of the --itermap results, and the numbers themselves (as text, in the same layout
+// as the Gnuplot file).
+
+void saveiterations (char * filename)
+{
+	FILE * outfile;
+	double total = 0;
+	int converged = 0;
+	int slowest = 0;
+	int x; int y;
+	
+	outfile = fopen(filename, "w");
+	if (outfile == NULL)
+	{
+		printf("Failed to create output file!\n");
+		exit(1);
+	}
+	
+	for (y = 0; y < subdivisions; y++)
+	{
+		for (x = 0; x < subdivisions; x++)
+		{
+			fprintf(outfile, "%d%s", iterations[x][y], x == subdivisions - 1 ? "\n" : "\t");
+			
+			if (iterations[x][y] < endpoint)
+			{
+				converged++;
+				total += iterations[x][y];
+				if (iterations[x][y] > slowest) slowest = iterations[x][y];
+			}
+		}
+	}
+	fclose(outfile);
+	
+	printf("Saved %s\n\n", filename);
+	
+	printf("Convergence (tolerance %G):\n", tolerance);
+	printf("  Cells converged = %d (of %d)\n", converged, subdivisions * subdivisions);
+	if (converged)
+	{
+		printf("  Generations taken by the slowest = %d\n", slowest);
+		printf("  Mean generations taken = %.1f\n", total / converged);
+	}
+	printf("\n");
+	
+	return;
+}
+
+// For --basins: the number of starts, i.e. of ways to share basins steps of 1/basins between the
+// genotypes (basins + ngenotypes - 1 choose ngenotypes - 1), and the start after k[] (the steps
+// given to each genotype) in reverse lexicographic order, returning 0 after the last.
+
+double countstarts (void)
+{
+	double count = 1;
+	int n;
+	
+	for (n = 1; n < ngenotypes; n++) count = count * (basins + n) / n;
+	
+	return count;
+}
+
+int nextstart (int * k)
+{
+	int last = k[ngenotypes - 1];
+	int n;
+	
+	k[ngenotypes - 1] = 0;
+	for (n = ngenotypes - 2; n >= 0; n--)
+	{
+		if (k[n] > 0)
+		{
+			k[n]--;
+			k[n + 1] = last + 1;
+			return 1;
+		}
+	}
+	
+	return 0;
+}
+
+// Run the one cell (Q and F) from every start, in parallel, and group the final states into
+// attractors. Each start stops once it has settled (see --converge). Which attractor each start
+// reached is saved to filename, and a summary is printed.
+
+void basinsweep (char * filename)
+{
+	int starts = countstarts();
+	double attractors[MAXATTRACTORS][MAXGENOTYPES];
+	int basinsize[MAXATTRACTORS + 1];
+	int nattractors = 0;
+	int unsettled = 0;
+	int diedout = 0;
+	int k[MAXGENOTYPES];
+	double * f;
+	int * generations;
+	int * attractor;
+	float * tileQ = NULL;
+	float * tileF = NULL;
+	int tiles;
+	int tile;
+	int first;
+	int count;
+	int flags;
+	double male;
+	double female;
+	double inconstant;
+	double total;
+	double start;
+	FILE * outfile;
+	int s;
+	int a;
+	int n;
+	
+	f = malloc((size_t) starts * ngenotypes * sizeof(double));
+	generations = malloc(starts * sizeof(int));
+	attractor = malloc(starts * sizeof(int));
+	if (engine == GRID)
+	{
+		tileQ = malloc(tilesize * sizeof(float));
+		tileF = malloc(tilesize * sizeof(float));
+	}
+	if (f == NULL || generations == NULL || attractor == NULL || (engine == GRID && (tileQ == NULL || tileF == NULL)))
+	{
+		printf("Out of memory!\n");
+		exit(1);
+	}
+	
+	k[0] = basins;
+	for (n = 1; n < ngenotypes; n++) k[n] = 0;
+	s = 0;
+	do
+	{
+		for (n = 0; n < ngenotypes; n++) f[s * ngenotypes + n] = (double) k[n] / basins;
+		s++;
+	} while (nextstart(k));
+	
+	if (progress)
+	{
+		progress_cells = 0;
+		progress_total = starts;
+		progress_generations = 0;
+		progress_start = seconds();
+		progress_next = progress_start + PROGRESSINTERVAL;
+	}
+	
+	start = seconds();
+	if (perfcounters) startcounters();
+	
+	if (engine == GRID)
+	{
+		for (n = 0; n < tilesize; n++)
+		{
+			tileQ[n] = Q;
+			tileF[n] = F;
+		}
+		tiles = (starts + tilesize - 1) / tilesize;
+		
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic) private(first, count, n)
+#endif
+		for (tile = 0; tile < tiles; tile++)
+		{
+			first = tile * tilesize;
+			count = (starts - first < tilesize) ? starts - first : tilesize;
+			
+			builtin_simulatetile(count, tileQ, tileF, &f[(size_t) first * ngenotypes], &generations[first]);
+			
+			if (progress)
+			{
+				for (n = 0; n < count; n++) reportprogress(generations[first + n]);
+			}
+		}
+	} else {
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic, 64) private(flags)
+#endif
+		for (s = 0; s < starts; s++)
+		{
+			generations[s] = runstart(&f[(size_t) s * ngenotypes], Q, F, &flags);
+			if (progress) reportprogress(generations[s]);
+		}
+	}
+	
+	if (perfcounters) stopcounters();
+	phasetime[RECURSION] = seconds() - start;
+	
+	// Group the final states: each is compared with the attractors found so far, and becomes a new
+	// one if it matches none of them (any beyond MAXATTRACTORS are counted together at the end).
+	// Starts that died out, or hadn't settled, aren't attractors, and are counted separately...
+	
+	for (a = 0; a <= MAXATTRACTORS; a++) basinsize[a] = 0;
+	
+	for (s = 0; s < starts; s++)
+	{
+		total = 0;
+		for (n = 0; n < ngenotypes; n++) total += f[s * ngenotypes + n];
+		if (!(total > 0))
+		{
+			attractor[s] = DIEDOUT;
+			diedout++;
+			continue;
+		}
+		if (stopearly && generations[s] >= endpoint)
+		{
+			attractor[s] = UNSETTLED;
+			unsettled++;
+			continue;
+		}
+		
+		for (a = 0; a < nattractors; a++)
+		{
+			for (n = 0; n < ngenotypes; n++)
+			{
+				if (!(fabs(f[s * ngenotypes + n] - attractors[a][n]) <= ATTRACTORMATCH)) break;
+			}
+			if (n == ngenotypes) break;
+		}
+		
+		if (a == nattractors && nattractors < MAXATTRACTORS)
+		{
+			for (n = 0; n < ngenotypes; n++) attractors[a][n] = f[s * ngenotypes + n];
+			nattractors++;
+		}
+		
+		attractor[s] = a;
+		basinsize[a]++;
+	}
+	
+	// Save which attractor each start reached (the starts are made again, in the same order)...
+	
+	start = seconds();
+	outfile = fopen(filename, "w");
+	if (outfile == NULL)
+	{
+		printf("Failed to create output file!\n");
+		exit(1);
+	}
+	
+	fprintf(outfile, "# starts %d genotypes %d steps %d Q %G F %G\n", starts, ngenotypes, basins, Q, F);
+	
+	k[0] = basins;
+	for (n = 1; n < ngenotypes; n++) k[n] = 0;
+	s = 0;
+	do
+	{
+		for (n = 0; n < ngenotypes; n++) fprintf(outfile, "%G ", (double) k[n] / basins);
+		if (attractor[s] == DIEDOUT)
+		{
+			fprintf(outfile, "0 none %d\n", generations[s]);
+		} else if (attractor[s] == UNSETTLED) {
+			fprintf(outfile, "0 unsettled %d\n", generations[s]);
+		} else if (attractor[s] < nattractors) {
+			phenotypesums(attractors[attractor[s]], &female, &male, &inconstant);
+			fprintf(outfile, "%d %s %d\n", attractor[s] + 1, regimenames[classify(female, male, inconstant)], generations[s]);
+		} else {
+			fprintf(outfile, "0 ??? %d\n", generations[s]);
+		}
+		s++;
+	} while (nextstart(k));
+	fclose(outfile);
+	phasetime[TEXTOUTPUT] = seconds() - start;
+	
+	printf("Saved %s\n\n", filename);
+	
+	printf("Attractors reached from %d starts (genotype frequencies in steps of 1/%d):\n\n", starts, basins);
+	for (a = 0; a < nattractors; a++)
+	{
+		phenotypesums(attractors[a], &female, &male, &inconstant);
+		printf("  %d: %s, from %d starts (%.2f%%)\n      ", a + 1, regimenames[classify(female, male, inconstant)], basinsize[a], 100.0 * basinsize[a] / starts);
+		for (n = 0; n < ngenotypes; n++) printf("%.6f  ", attractors[a][n]);
+		printf("\n");
+	}
+	if (basinsize[MAXATTRACTORS])
+	{
+		printf("  0: others (more than %d attractors), from %d starts (%.2f%%)\n", MAXATTRACTORS, basinsize[MAXATTRACTORS], 100.0 * basinsize[MAXATTRACTORS] / starts);
+	}
+	printf("\n");
+	printf("Starts that died out (not counted as an attractor) = %d\n", diedout);
+	if (stopearly) printf("Starts still changing after %d generations (tolerance %G; not counted as an attractor) = %d\n", endpoint, tolerance, unsettled);
+	printf("\n");
+	
+	free(f);
+	free(generations);
+	free(attractor);
+	free(tileQ);
+	free(tileF);
+	
+	return;
+}
+
+// The seed and pollen output of each class of plant, for the individual-based model: class g is plants
+// of genotype g expressing as females or males, class NGENOTYPES + g those expressing as cosexes...
+
+struct matingweights
+{
+	double mother[2 * NGENOTYPES];			// Seeds (outcrossed and selfed, each less any pollen limitation)
+	double selfed[2 * NGENOTYPES];			// The fraction of those that are selfed
+	double father[2 * NGENOTYPES];			// Pollen
+	double maxmother;						// The largest of mother[]...
+	double maxfather;						// ...and of father[]
+	double selfpool[NGENOTYPES][NGAMETES];	// Each genotype's own pollen, for selfing (Y pollen competing with ppY)
+};
+
+static inline int plantclass (unsigned char plant)
+{
+	return (plant & COSEX) ? NGENOTYPES + (plant & ~COSEX) : plant;
+}
+
+// A plant picked from the parents with probability proportional to weights[] of its class (by
+// rejection: a plant at random, kept with probability its weight over the largest, maxweight)...
+
+static inline unsigned char drawparent (const unsigned char * parents, const double * weights, double maxweight, struct rngstream * stream)
+{
+	unsigned char plant;
+	long long i;
+	
+	do
+	{
+		i = (long long) (uniform(stream) * individuals);
+		if (i >= individuals) i = individuals - 1;
+		plant = parents[i];
+	}
+	while (uniform(stream) * maxweight >= weights[plantclass(plant)]);
+	
+	return plant;
+}
+
+// ...and one of the gametes in proportions[] (a row of builtin_segregation, or of selfpool)...
+
+static inline int drawgamete (const double * proportions, struct rngstream * stream)
+{
+	double u = uniform(stream);
+	int last = 0;
+	int k;
+	
+	for (k = 0; k < NGAMETES; k++)
+	{
+		if (proportions[k] > 0) last = k;
+		if (u < proportions[k]) return k;
+		u -= proportions[k];
+	}
+	
+	return last;		// (Rounding error only)
+}
+
+// ...which make one viable offspring: a mother by her seed output, selfed in proportion to her selfed
+// seeds, or else a father by his pollen output; an egg from her, and pollen from him (or her), Y pollen
+// succeeding with probability ppY (if it doesn't, the father is picked again, as the pollen that does
+// succeed is from the pool as a whole); and, if the offspring is YY, survival with probability V (if it
+// doesn't survive, everything is drawn again).
+
+static unsigned char drawoffspring (const unsigned char * parents, const struct matingweights * weights, struct rngstream * stream)
+{
+	unsigned char mother;
+	unsigned char father;
+	int egg;
+	int pollen;
+	int child;
+	
+	do
+	{
+		mother = drawparent(parents, weights->mother, weights->maxmother, stream);
+		egg = drawgamete(builtin_segregation[mother & ~COSEX], stream);
+		
+		if (uniform(stream) < weights->selfed[plantclass(mother)])
+		{
+			pollen = drawgamete(weights->selfpool[mother & ~COSEX], stream);
+		} else {
+			do
+			{
+				father = drawparent(parents, weights->father, weights->maxfather, stream);
+				pollen = drawgamete(builtin_segregation[father & ~COSEX], stream);
+			}
+			while (builtin_ygamete[pollen] && uniform(stream) >= ppY);
+		}
+		
+		child = builtin_zygote[egg][pollen];
+	}
+	while (builtin_yy[child] && uniform(stream) >= V);
+	
+	return child;
+}
+
+// A random number stream for one chunk of individuals in one pass of one generation...
+
+void chunkstream (struct rngstream * stream, uint64_t key, int generation, int chunk, int pass)
+{
+	stream->key = mix64(key ^ mix64(((uint64_t) generation << 32) + ((uint64_t) chunk << 1) + pass));
+	stream->counter = 0;
+	
+	return;
+}
+
+// The individual-based model (--individuals). Each plant is one byte in a flat array: its genotype,
+// with the COSEX bit set if it's an inconstant expressing as a cosex this generation. There are two
+// arrays, allocated once, the offspring being written into one while the parents are read from the
+// other, and then they swap. Each generation is two passes over the plants, in chunks of IBMCHUNK
+// shared between threads:
+//
+// 1. Every inconstant decides to be a cosex (with probability h) or a male, and the plants of each
+//    genotype and expression are counted. From the counts come the pollen output of the population
+//    (males give 1, cosexes Q, Y pollen counting ppY), and so the pollen limitation of females and
+//    cosexes, and the weights of each class as mothers (outcrossed eggs of females, 1 each, and of
+//    cosexes, F (1 - S) each, both less under pollen limitation and none without pollen; and selfed
+//    seeds of cosexes, F S (1 - d) each) and as fathers (1 for males, Q for cosexes).
+//
+// 2. Each offspring is made by particular parents, picked from the array by those weights (see
+//    drawoffspring()), so its genotype comes from theirs.
+//
+// The expected offspring of each genotype are also summed over the classes, but only to see whether
+// any can survive (if not, the population has died out, and drawoffspring() would never return).
+// This takes about 150 ns per plant per generation on one core for 1e6 plants, or 400 ns for 1e7 (whose
+// arrays don't fit in the cache), in the random numbers (a handful per offspring, more where many plants
+// are rejected as parents), the unpredictable branches on them, and the random reads of the parents. On entry, f[] holds the start frequencies; on exit, the final ones. Returns
+// the generations run (fewer than endpoint if the population died out, in which case f[] is all 0).
+
+int runindividuals (double * f, float Q, float F)
+{
+	unsigned char * parents;
+	unsigned char * offspring;
+	unsigned char * swap;
+	long long * chunkcounts;
+	long long counts[2 * NGENOTYPES];
+	struct matingweights weights;
+	struct rngstream stream;
+	double pool[NGAMETES];
+	double seeds;
+	double totalpollen;
+	double outcrossed;
+	double selfed;
+	double limitF;
+	double limitC;
+	double PSatC = PSatF * F * (1 - S);
+	double remainder[NGENOTYPES];
+	uint64_t key;
+	long long placed;
+	long long i;
+	long long last;
+	int chunks = (individuals + IBMCHUNK - 1) / IBMCHUNK;
+	int record = recording ? 0 : -1;
+	int chunk;
+	int egg;
+	int pollen;
+	int g;
+	int k;
+	int n;
+	
+	parents = malloc(individuals);
+	offspring = malloc(individuals);
+	chunkcounts = malloc((size_t) chunks * 2 * NGENOTYPES * sizeof(long long));
+	if (parents == NULL || offspring == NULL || chunkcounts == NULL)
+	{
+		printf("Out of memory!\n");
+		exit(1);
+	}
+	
+	// Each genotype's own pollen, for selfing (Y pollen competing with ppY, except where all of it is Y)...
+	
+	for (g = 0; g < NGENOTYPES; g++)
+	{
+		for (k = 0, totalpollen = 0; k < NGAMETES; k++)
+		{
+			weights.selfpool[g][k] = builtin_segregation[g][k] * (builtin_ygamete[k] ? ppY : 1);
+			totalpollen += weights.selfpool[g][k];
+		}
+		for (k = 0; k < NGAMETES; k++)
+		{
+			weights.selfpool[g][k] = (totalpollen > 0) ? weights.selfpool[g][k] / totalpollen : builtin_segregation[g][k];
+		}
+	}
+	
+	// The start: as near the start frequencies as whole plants allow (largest remainders)...
+	
+	for (g = 0, placed = 0; g < NGENOTYPES; g++)
+	{
+		counts[g] = (long long) floor(f[g] * individuals);
+		remainder[g] = f[g] * individuals - counts[g];
+		placed += counts[g];
+	}
+	while (placed < individuals)
+	{
+		for (g = 0, k = 0; g < NGENOTYPES; g++) if (remainder[g] > remainder[k]) k = g;
+		counts[k]++;
+		remainder[k] = -1;
+		placed++;
+	}
+	for (g = 0, placed = 0; g < NGENOTYPES; g++)
+	{
+		memset(parents + placed, g, counts[g]);
+		placed += counts[g];
+	}
+	
+	startstream(&stream, Q, F, f);
+	key = stream.key;
+	
+	for (n = 0; ; n++)
+	{
+		// 1. Expression, and counts...
+		
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static) private(stream, i, last, g, k)
+#endif
+		for (chunk = 0; chunk < chunks; chunk++)
+		{
+			long long * count = &chunkcounts[(size_t) chunk * 2 * NGENOTYPES];
+			
+			chunkstream(&stream, key, n, chunk, 0);
+			for (k = 0; k < 2 * NGENOTYPES; k++) count[k] = 0;
+			
+			last = (chunk + 1 == chunks) ? individuals : (long long) (chunk + 1) * IBMCHUNK;
+			for (i = (long long) chunk * IBMCHUNK; i < last; i++)
+			{
+				g = parents[i] & ~COSEX;
+				if (builtin_phenotypes[g] == INCONSTANT && uniform(&stream) < h)
+				{
+					parents[i] = g | COSEX;
+					count[NGENOTYPES + g]++;
+				} else {
+					parents[i] = g;
+					count[g]++;
+				}
+			}
+		}
+		
+		for (k = 0; k < 2 * NGENOTYPES; k++) counts[k] = 0;
+		for (chunk = 0; chunk < chunks; chunk++)
+		{
+			for (k = 0; k < 2 * NGENOTYPES; k++) counts[k] += chunkcounts[(size_t) chunk * 2 * NGENOTYPES + k];
+		}
+		
+		for (g = 0; g < NGENOTYPES; g++) f[g] = (double) (counts[g] + counts[NGENOTYPES + g]) / individuals;
+		if (n == record) record = recordstate(n, f);
+		if (n == endpoint) break;
+		
+		// ...which give the pollen pool (counts[g] are males, or females, which make none; counts[NGENOTYPES + g]
+		// are cosexes)...
+		
+		for (k = 0, totalpollen = 0; k < NGAMETES; k++)
+		{
+			pool[k] = 0;
+			for (g = 0; g < NGENOTYPES; g++)
+			{
+				if (builtin_phenotypes[g] != FEMALE) pool[k] += (counts[g] + counts[NGENOTYPES + g] * Q) * builtin_segregation[g][k];
+			}
+			if (builtin_ygamete[k]) pool[k] *= ppY;
+			totalpollen += pool[k];
+		}
+		for (k = 0; k < NGAMETES; k++) pool[k] = (totalpollen > 0) ? pool[k] / totalpollen : 0;
+		totalpollen /= individuals;
+		
+		// ...and the weight of each class as a mother and as a father...
+		
+		limitF = (PSatF == 0 || totalpollen >= PSatF) ? 1 : totalpollen / PSatF;
+		limitC = (PSatF == 0 || totalpollen >= PSatC) ? 1 : totalpollen / PSatC;
+		
+		weights.maxmother = 0;
+		weights.maxfather = 0;
+		seeds = 0;
+		
+		for (k = 0; k < 2 * NGENOTYPES; k++)
+		{
+			g = k % NGENOTYPES;
+			if (k >= NGENOTYPES)
+			{
+				outcrossed = (totalpollen > 0) ? F * (1 - S) * limitC : 0;
+				selfed = F * S * (1 - d);
+				weights.father[k] = Q;
+			} else {
+				outcrossed = (builtin_phenotypes[g] == FEMALE && totalpollen > 0) ? limitF : 0;
+				selfed = 0;
+				weights.father[k] = (builtin_phenotypes[g] == FEMALE) ? 0 : 1;
+			}
+			weights.mother[k] = outcrossed + selfed;
+			weights.selfed[k] = (weights.mother[k] > 0) ? selfed / weights.mother[k] : 0;
+			
+			// (Only classes with plants count, so that every pick of a parent can succeed)
+			
+			if (counts[k] == 0) weights.mother[k] = weights.father[k] = 0;
+			if (weights.mother[k] > weights.maxmother) weights.maxmother = weights.mother[k];
+			if (weights.father[k] > weights.maxfather) weights.maxfather = weights.father[k];
+			
+			for (egg = 0; egg < NGAMETES; egg++)
+			{
+				for (pollen = 0; pollen < NGAMETES; pollen++)
+				{
+					seeds += counts[k] * builtin_segregation[g][egg] * (outcrossed * pool[pollen] + selfed * weights.selfpool[g][pollen])
+						* (builtin_yy[builtin_zygote[egg][pollen]] ? V : 1);
+				}
+			}
+		}
+		
+		if (!(seeds > 0)) break;		// The population has died out (e.g. V = 0, and only YY offspring possible)
+		
+		// 2. The offspring...
+		
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static) private(stream, i, last)
+#endif
+		for (chunk = 0; chunk < chunks; chunk++)
+		{
+			chunkstream(&stream, key, n, chunk, 1);
+			
+			last = (chunk + 1 == chunks) ? individuals : (long long) (chunk + 1) * IBMCHUNK;
+			for (i = (long long) chunk * IBMCHUNK; i < last; i++) offspring[i] = drawoffspring(parents, &weights, &stream);
+		}
+		
+		swap = parents;
+		parents = offspring;
+		offspring = swap;
+	}
+	
+	if (n < endpoint)		// Died out: generation n made no offspring
+	{
+		for (g = 0; g < NGENOTYPES; g++) f[g] = 0;
+		n++;
+		if (record >= 0) recordstate(n, f);
+	}
+	
+	free(parents);
+	free(offspring);
+	free(chunkcounts);
+	
+	return n;
+}
+
+// Sobol sequence, for --area and --sensitivity: the direction numbers of each dimension (after the first, which is the
+// van der Corput sequence), from the primitive polynomials and initial numbers of Joe and Kuo (2008):
+// the degree s, the coefficients a, and the initial m_1 to m_s...
+
+const unsigned int sobolpolynomials[SOBOLSEQUENCE - 1][8] = {
+	{1, 0, 1},
+	{2, 1, 1, 3},
+	{3, 1, 1, 3, 1},
+	{3, 2, 1, 1, 1},
+	{4, 1, 1, 1, 3, 3},
+	{4, 4, 1, 3, 5, 13},
+	{5, 2, 1, 1, 5, 5, 17},
+	{5, 4, 1, 1, 5, 5, 5},
+	{5, 7, 1, 1, 7, 11, 19},
+	{5, 11, 1, 1, 5, 1, 1},
+	{5, 13, 1, 1, 1, 3, 11},
+	{5, 14, 1, 3, 5, 5, 31},
+	{6, 1, 1, 3, 3, 9, 7, 49},
+	{6, 13, 1, 1, 1, 15, 21, 21},
+	{6, 16, 1, 3, 1, 13, 27, 49}};
+
+uint32_t sobolvectors[SOBOLSEQUENCE][SOBOLBITS];
+
+void startsobol (void)
+{
+	unsigned int s;
+	unsigned int a;
+	int i;
+	int j;
+	int k;
+	
+	for (i = 0; i < SOBOLBITS; i++) sobolvectors[0][i] = (uint32_t) 1 << (SOBOLBITS - 1 - i);
+	
+	for (j = 1; j < SOBOLSEQUENCE; j++)
+	{
+		s = sobolpolynomials[j - 1][0];
+		a = sobolpolynomials[j - 1][1];
+		
+		for (i = 0; i < SOBOLBITS; i++)
+		{
+			if (i < (int) s)
+			{
+				sobolvectors[j][i] = (uint32_t) sobolpolynomials[j - 1][2 + i] << (SOBOLBITS - 1 - i);
+			} else {
+				sobolvectors[j][i] = sobolvectors[j][i - s] ^ (sobolvectors[j][i - s] >> s);
+				for (k = 1; k < (int) s; k++)
+				{
+					if ((a >> (s - 1 - k)) & 1) sobolvectors[j][i] ^= sobolvectors[j][i - k];
+				}
+			}
+		}
+	}
+	
+	return;
+}
+
+// Point n of the sequence in dimension j, as 32 bits of a fraction. This is the Gray code ordering,
+// worked out directly (rather than from point n - 1), so that points can be run in any order; its
+// first 2^m points are the same as in the usual ordering, just shuffled.
+
+uint32_t sobol (uint32_t n, int j)
+{
+	uint32_t gray = n ^ (n >> 1);
+	uint32_t x = 0;
+	int i;
+	
+	for (i = 0; gray; i++, gray >>= 1)
+	{
+		if (gray & 1) x ^= sobolvectors[j][i];
+	}
+	
+	return x;
+}
+
+// A point of the parameter space explored by --area and --sensitivity: u[0] and u[1] (from 0 to 1)
+// give Q and F, as the axes of the graph do, and u[2] on give the parameters varied by --vary. The
+// parameters are put in parameters[] (see simulate_parameters()), the rest being as given.
+
+void pointparameters (const double * u, float * pointQ, float * pointF, float * parameters)
+{
+	int i;
+	
+	if (oldformat == 0)
+	{
+		*pointQ = u[0];
+		*pointF = u[1];
+	} else {
+		*pointQ = 1 / (1 + (float) (u[0] * oldformatlimit));
+		*pointF = 1 / (1 + (float) (u[1] * oldformatlimit));
+	}
+	
+	parameters[0] = h;
+	parameters[1] = S;
+	parameters[2] = d;
+	parameters[3] = V;
+	parameters[4] = PSatF;
+	parameters[5] = ppY;
+	for (i = 0; i < varies; i++) parameters[varywhich[i]] = varylow[i] + u[2 + i] * (varyhigh[i] - varylow[i]);
+	
+	return;
+}
+
+// Run a point, from the start in use, and return its final state (with its final frequencies in f[]).
+
+int runpoint (double * f, float pointQ, float pointF, const float * parameters)
+{
+	float loaded[MAXGENOTYPES];
+	double female;
+	double male;
+	double inconstant;
+	int flags;
+	int n;
+	
+	startcell(f);
+	if (kernel_simulate)
+	{
+		for (n = 0; n < ngenotypes; n++) loaded[n] = f[n];
+		kernel_simulate(loaded, endpoint, pointQ, pointF, parameters[0], parameters[1], parameters[2], parameters[3], parameters[4], parameters[5]);
+		for (n = 0; n < ngenotypes; n++) f[n] = loaded[n];
+	} else {
+		builtin_simulateparameters(f, pointQ, pointF, &flags, parameters);
+	}
+	
+	phenotypesums(f, &female, &male, &inconstant);
+	
+	return classify(female, male, inconstant);
+}
+
+// Estimate the fraction of the graph (and, with --vary, of the other parameters' ranges) that ends
+// in each state, by randomised quasi-Monte Carlo. There are AREASHIFTS copies of the Sobol sequence,
+// each XORed with its own random digital shift (which keeps its evenness), and each gives its own
+// estimate; their spread gives the error bars. Each round doubles the points of every copy, until
+// every state's 95% confidence interval is within +/- area (and the points number at least 1 / area,
+// so that a state that hasn't been hit yet can't look certain), or AREAMAXPOINTS is reached.
+
+void areasweep (void)
+{
+	struct rngstream stream;
+	uint32_t shifts[AREASHIFTS][SOBOLDIMENSIONS];
+	long long tallies[AREASHIFTS][6];
+	double fraction[6];
+	double halfwidth[6];
+	double deviation;
+	double widest;
+	double start;
+	double f[MAXGENOTYPES];
+	double u[SOBOLDIMENSIONS];
+	float parameters[NPARAMETERS];
+	float pointQ;
+	float pointF;
+	long long done = 0;
+	long long points = AREAFIRST;
+	long long task;
+	long long n;
+	int regime;
+	int r;
+	int i;
+	int j;
+	
+	startsobol();
+	
+	startcell(f);
+	startstream(&stream, 0, 0, f);
+	for (r = 0; r < AREASHIFTS; r++)
+	{
+		for (j = 0; j < SOBOLDIMENSIONS; j++) shifts[r][j] = (uint32_t) (uniform(&stream) * 4294967296.0);
+		for (i = 0; i < 6; i++) tallies[r][i] = 0;
+	}
+	
+	printf("Points    ");
+	for (i = 1; i <= 5; i++) printf("%-23s", regimenames[i]);
+	printf("%s\n", regimenames[0]);
+	
+	start = seconds();
+	
+	for (;;)
+	{
+		// Points done to points - 1 of every copy...
+		
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic, 16) private(n, r, j, u, pointQ, pointF, parameters, f, regime)
+#endif
+		for (task = 0; task < AREASHIFTS * (points - done); task++)
+		{
+			r = task % AREASHIFTS;
+			n = done + task / AREASHIFTS;
+			
+			for (j = 0; j < 2 + varies; j++) u[j] = ((sobol(n, j) ^ shifts[r][j]) + 0.5) / 4294967296.0;
+			pointparameters(u, &pointQ, &pointF, parameters);
+			regime = runpoint(f, pointQ, pointF, parameters);
+			
+#ifdef _OPENMP
+			#pragma omp atomic
+#endif
+			tallies[r][regime]++;
+		}
+		
+		done = points;
+		
+		// ...and the estimates so far...
+		
+		widest = 0;
+		for (i = 0; i < 6; i++)
+		{
+			fraction[i] = 0;
+			for (r = 0; r < AREASHIFTS; r++) fraction[i] += (double) tallies[r][i] / done;
+			fraction[i] /= AREASHIFTS;
+			
+			deviation = 0;
+			for (r = 0; r < AREASHIFTS; r++) deviation += pow((double) tallies[r][i] / done - fraction[i], 2);
+			halfwidth[i] = AREAT * sqrt(deviation / (AREASHIFTS - 1) / AREASHIFTS);
+			
+			if (halfwidth[i] > widest) widest = halfwidth[i];
+		}
+		
+		printf("%-10lld", done * AREASHIFTS);
+		for (i = 1; i <= 5; i++) printf("%.6f +/- %.6f  ", fraction[i], halfwidth[i]);
+		printf("%.6f +/- %.6f\n", fraction[0], halfwidth[0]);
+		fflush(stdout);
+		
+		if ((widest <= area && done * AREASHIFTS >= 1 / area) || done >= AREAMAXPOINTS) break;
+		points = done * 2;
+	}
+	
+	phasetime[RECURSION] = seconds() - start;
+	
+	printf("\n");
+	if (widest > area || done * AREASHIFTS < 1 / area)
+	{
+		printf("Stopped at %d points per randomisation, short of the precision asked for\n\n", AREAMAXPOINTS);
+	}
+	
+	printf("Fractions of the %s, from %lld points in %.1f s (95%% confidence intervals):\n\n", varies ? "parameter box" : "graph", done * AREASHIFTS, phasetime[RECURSION]);
+	for (i = 1; i <= 6; i++)
+	{
+		printf("  %s  %.6f +/- %.6f\n", regimenames[i % 6], fraction[i % 6], halfwidth[i % 6]);
+	}
+	
+	return;
+}
+
+// --sensitivity: Sobol sensitivity indices from a Saltelli design. Row j of the design is a pair of
+// points, A and B, over the D = varies + 2 dimensions, and D more: A with dimension i taken from B
+// (AB_i). A and B are point j of the Sobol sequence, A from its dimensions 0 to D - 1 and B from D to
+// 2D - 1, with a random digital shift (from --seed) as for --area; sobol() gives any point directly,
+// so rows can be run in any order. With f the
+// output, the first order index of dimension i is E[f(B) (f(AB_i) - f(A))] / Var f (Saltelli et al.
+// 2010), and the total index E[(f(A) - f(AB_i))^2] / 2 Var f (Jansen). These are found from sums
+// over the rows, which are kept in SENSITIVITYBLOCKS blocks, so that the bootstrap can resample the
+// blocks (rather than millions of rows) for the confidence intervals.
+//
+// Each run of the design is given as its final female frequency and final state, in order: A, B,
+// then AB_1 to AB_D. A row of the text file is the row number, then each run as "frequency state".
+
+struct sensitivitysums
+{
+	double rows;
+	double sumA;
+	double sumB;
+	double squaresA;
+	double squaresB;
+	double first[SOBOLDIMENSIONS];
+	double total[SOBOLDIMENSIONS];
+};
+
+const char * sensitivitynames[SENSITIVITYOUTPUTS] = {"Female frequency", "Reaching PGD", "Reaching SSD", "Reaching DIO", "Reaching PAD", "Reaching INC"};
+
+// The point (from 0 to 1 in each dimension) of the given run of a row of the design...
+
+void designpoint (const uint32_t * shifts, int row, int run, int dimensions, double * u)
+{
+	int j;
+	int k;
+	
+	for (j = 0; j < dimensions; j++)
+	{
+		k = (run == 1 || run == j + 2) ? dimensions + j : j;		// B's coordinate for B, or for AB_j; otherwise A's
+		u[j] = ((sobol(row, k) ^ shifts[k]) + 0.5) / 4294967296.0;
+	}
+	
+	return;
+}
+
+// ...output o (see SENSITIVITYOUTPUTS) of a run...
+
+double sensitivityoutput (int o, float female, unsigned char regime)
+{
+	return (o == 0) ? female : (regime == o);
+}
+
+// ...adding up sums...
+
+void addsums (struct sensitivitysums * to, const struct sensitivitysums * from, int dimensions)
+{
+	int i;
+	
+	to->rows += from->rows;
+	to->sumA += from->sumA;
+	to->sumB += from->sumB;
+	to->squaresA += from->squaresA;
+	to->squaresB += from->squaresB;
+	for (i = 0; i < dimensions; i++)
+	{
+		to->first[i] += from->first[i];
+		to->total[i] += from->total[i];
+	}
+	
+	return;
+}
+
+// ...and the indices from them (returning the variance of the output, the indices being 0 if it's 0).
+
+double sensitivityindices (const struct sensitivitysums * sums, int dimensions, double * first, double * total)
+{
+	double mean = (sums->sumA + sums->sumB) / (2 * sums->rows);
+	double variance = (sums->squaresA + sums->squaresB) / (2 * sums->rows) - mean * mean;
+	int i;
+	
+	for (i = 0; i < dimensions; i++)
+	{
+		first[i] = (variance > 0) ? sums->first[i] / sums->rows / variance : 0;
+		total[i] = (variance > 0) ? sums->total[i] / (2 * sums->rows) / variance : 0;
+	}
+	
+	return variance;
+}
+
+int compareindices (const void * a, const void * b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+	
+	return (x > y) - (x < y);
+}
+
+void sensitivitysweep (char * filename)
+{
+	struct sensitivitysums (* blocks)[SENSITIVITYOUTPUTS];
+	struct sensitivitysums sums[SENSITIVITYOUTPUTS];
+	struct rngstream base;
+	struct rngstream stream;
+	float * females;
+	unsigned char * states;
+	double * resampled;
+	double * sorted;
+	double first[SOBOLDIMENSIONS];
+	double total[SOBOLDIMENSIONS];
+	double u[SOBOLDIMENSIONS];
+	double f[MAXGENOTYPES];
+	double female;
+	double male;
+	double inconstant;
+	double variance;
+	double fA;
+	double fB;
+	double fAB;
+	double start;
+	float parameters[NPARAMETERS];
+	float pointQ;
+	float pointF;
+	uint32_t shifts[SOBOLSEQUENCE];
+	size_t headersize = 1000 + (kernelfile ? strlen(kernelfile) : 0);		// Plenty, whatever the settings
+	size_t readsize = 0;
+	char * header;
+	char * readheader = NULL;
+	char line[1000];
+	char * cursor;
+	char * end;
+	const char * name;
+	FILE * file;
+	long offset;
+	size_t run;
+	int dimensions = 2 + varies;
+	int runs = dimensions + 2;
+	int nblocks = (sensitivity < SENSITIVITYBLOCKS) ? sensitivity : SENSITIVITYBLOCKS;
+	int resumed = 0;
+	int done;
+	int count;
+	int task;
+	int block;
+	int row;
+	int kind;
+	int o;
+	int n;
+	int i;
+	
+	females = malloc((size_t) sensitivity * runs * sizeof(float));
+	states = malloc((size_t) sensitivity * runs);
+	blocks = malloc(nblocks * sizeof(*blocks));
+	resampled = malloc((size_t) SENSITIVITYOUTPUTS * 2 * SOBOLDIMENSIONS * BOOTSTRAPS * sizeof(double));
+	header = malloc(headersize);
+	if (females == NULL || states == NULL || blocks == NULL || resampled == NULL || header == NULL)
+	{
+		printf("Out of memory!\n");
+		exit(1);
+	}
+	
+	startsobol();
+	
+	startcell(f);
+	startstream(&base, 0, 0, f);
+	stream = base;
+	for (i = 0; i < SOBOLSEQUENCE; i++) shifts[i] = (uint32_t) (uniform(&stream) * 4294967296.0);
+	
+	// Everything the results depend on goes in the header, so that only the same run is carried on...
+	
+	snprintf(header, headersize, "# Sensitivity: model %d, design Sobol, rows %d, seed %llu, iterations %d, precision %s, start %s, h %G S %G d %G V %G PSatF %G ppY %G, %s",
+		MODEL, sensitivity, seed, endpoint, precisionnames[precision], pgd ? "PGD" : "DIO", h, S, d, V, PSatF, ppY, oldformat ? "K k" : "Q F");
+	if (oldformat) snprintf(header + strlen(header), headersize - strlen(header), " to %d", oldformatlimit);
+	for (i = 0; i < varies; i++) snprintf(header + strlen(header), headersize - strlen(header), ", %s %G to %G", varynames[varywhich[i]], varylow[i], varyhigh[i]);
+	if (kernelfile) snprintf(header + strlen(header), headersize - strlen(header), ", kernel %s", kernelfile);
+	if (popsize) snprintf(header + strlen(header), headersize - strlen(header), ", popsize %.0f", popsize);
+	if (extinction > 0) snprintf(header + strlen(header), headersize - strlen(header), ", extinction %G", extinction);
+	if (stopearly) snprintf(header + strlen(header), headersize - strlen(header), ", tolerance %G", tolerance);
+	snprintf(header + strlen(header), headersize - strlen(header), "\n");
+	
+	// ...and if the file is there, the rows in it (up to the first that is incomplete) are read back...
+	
+	file = fopen(filename, "r");
+	if (file)
+	{
+		if (getline(&readheader, &readsize, file) < 0 || strcmp(readheader, header) != 0)
+		{
+			printf("%s is from a different run; remove it to start again.\n", filename);
+			exit(1);
+		}
+		offset = ftell(file);
+		
+		while (resumed < sensitivity && fgets(line, sizeof(line), file) && strchr(line, '\n'))
+		{
+			if (strtol(line, &cursor, 10) != resumed) break;
+			for (i = 0; i < runs; i++)
+			{
+				run = (size_t) resumed * runs + i;
+				females[run] = strtod(cursor, &end);
+				if (end == cursor) break;
+				states[run] = strtol(end, &cursor, 10);
+				if (cursor == end) break;
+			}
+			if (i < runs) break;
+			
+			resumed++;
+			offset = ftell(file);
+		}
+		fclose(file);
+		
+		if (truncate(filename, offset) != 0)		// Drop anything after the last complete row
+		{
+			printf("Failed to open %s!\n", filename);
+			exit(1);
+		}
+		file = fopen(filename, "a");
+		printf("Read %d rows back from %s\n\n", resumed, filename);
+	} else {
+		file = fopen(filename, "w");
+		if (file) fputs(header, file);
+	}
+	if (file == NULL)
+	{
+		printf("Failed to open %s!\n", filename);
+		exit(1);
+	}
+	
+	if (progress)
+	{
+		progress_cells = 0;
+		progress_total = (sensitivity - resumed) * runs;
+		progress_generations = 0;
+		progress_start = seconds();
+		progress_next = progress_start + PROGRESSINTERVAL;
+	}
+	
+	// The rows still to do, in batches, the runs of a batch being shared between threads, and then
+	// written out in order...
+	
+	start = seconds();
+	
+	for (done = resumed; done < sensitivity; done += count)
+	{
+		count = (sensitivity - done < SENSITIVITYBATCH) ? sensitivity - done : SENSITIVITYBATCH;
+		
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic) private(run, u, pointQ, pointF, parameters, f, female, male, inconstant)
+#endif
+		for (task = 0; task < count * runs; task++)
+		{
+			run = (size_t) done * runs + task;
+			
+			designpoint(shifts, done + task / runs, task % runs, dimensions, u);
+			pointparameters(u, &pointQ, &pointF, parameters);
+			states[run] = runpoint(f, pointQ, pointF, parameters);
+			phenotypesums(f, &female, &male, &inconstant);
+			females[run] = female;
+			
+			if (progress) reportprogress(endpoint);
+		}
+		
+		for (row = done; row < done + count; row++)
+		{
+			fprintf(file, "%d", row);
+			for (i = 0; i < runs; i++) fprintf(file, " %.9g %d", females[(size_t) row * runs + i], states[(size_t) row * runs + i]);
+			fprintf(file, "\n");
+		}
+		fflush(file);
+	}
+	fclose(file);
+	
+	phasetime[RECURSION] = seconds() - start;
+	
+	// The sums, by block...
+	
+	memset(blocks, 0, nblocks * sizeof(*blocks));
+	for (row = 0; row < sensitivity; row++)
+	{
+		block = (long long) row * nblocks / sensitivity;
+		run = (size_t) row * runs;
+		
+		for (o = 0; o < SENSITIVITYOUTPUTS; o++)
+		{
+			fA = sensitivityoutput(o, females[run], states[run]);
+			fB = sensitivityoutput(o, females[run + 1], states[run + 1]);
+			
+			blocks[block][o].rows++;
+			blocks[block][o].sumA += fA;
+			blocks[block][o].sumB += fB;
+			blocks[block][o].squaresA += fA * fA;
+			blocks[block][o].squaresB += fB * fB;
+			for (i = 0; i < dimensions; i++)
+			{
+				fAB = sensitivityoutput(o, females[run + 2 + i], states[run + 2 + i]);
+				blocks[block][o].first[i] += fB * (fAB - fA);
+				blocks[block][o].total[i] += (fA - fAB) * (fA - fAB);
+			}
+		}
+	}
+	
+	// ...resampled for the bootstrap...
+	
+	stream.key = mix64(base.key ^ mix64(sensitivity));
+	stream.counter = 0;
+	
+	for (n = 0; n < BOOTSTRAPS; n++)
+	{
+		memset(sums, 0, sizeof(sums));
+		for (i = 0; i < nblocks; i++)
+		{
+			block = uniform(&stream) * nblocks;
+			if (block == nblocks) block--;
+			for (o = 0; o < SENSITIVITYOUTPUTS; o++) addsums(&sums[o], &blocks[block][o], dimensions);
+		}
+		
+		for (o = 0; o < SENSITIVITYOUTPUTS; o++)
+		{
+			sensitivityindices(&sums[o], dimensions, first, total);
+			for (i = 0; i < dimensions; i++)
+			{
+				resampled[((size_t) (o * 2 + 0) * SOBOLDIMENSIONS + i) * BOOTSTRAPS + n] = first[i];
+				resampled[((size_t) (o * 2 + 1) * SOBOLDIMENSIONS + i) * BOOTSTRAPS + n] = total[i];
+			}
+		}
+	}
+	
+	// ...and the results.
+	
+	memset(sums, 0, sizeof(sums));
+	for (block = 0; block < nblocks; block++)
+	{
+		for (o = 0; o < SENSITIVITYOUTPUTS; o++) addsums(&sums[o], &blocks[block][o], dimensions);
+	}
+	
+	printf("Runs = %lld (%d read back) in %.1f s; saved %s\n", (long long) sensitivity * runs, resumed * runs, phasetime[RECURSION], filename);
+	
+	for (o = 0; o < SENSITIVITYOUTPUTS; o++)
+	{
+		variance = sensitivityindices(&sums[o], dimensions, first, total);
+		printf("\n%s (mean %.6f, variance %.6f):", sensitivitynames[o], (sums[o].sumA + sums[o].sumB) / (2 * sums[o].rows), variance);
+		if (variance <= 0)
+		{
+			printf(" doesn't vary\n");
+			continue;
+		}
+		
+		printf("\n\n  %-9s  %-27s    %s\n", "Parameter", "First order (95% CI)", "Total (95% CI)");
+		for (i = 0; i < dimensions; i++)
+		{
+			if (i == 0) name = oldformat ? "K" : "Q";
+			else if (i == 1) name = oldformat ? "k" : "F";
+			else name = varynames[varywhich[i - 2]];
+			
+			printf("  %-9s", name);
+			for (kind = 0; kind < 2; kind++)
+			{
+				sorted = &resampled[((size_t) (o * 2 + kind) * SOBOLDIMENSIONS + i) * BOOTSTRAPS];
+				qsort(sorted, BOOTSTRAPS, sizeof(double), compareindices);
+				printf("%s%7.4f (%7.4f to %7.4f)", kind ? "    " : "  ", kind ? total[i] : first[i], sorted[BOOTSTRAPS / 40], sorted[BOOTSTRAPS - 1 - BOOTSTRAPS / 40]);
+			}
+			printf("\n");
+		}
+	}
+	
+	free(females);
+	free(states);
+	free(blocks);
+	free(header);
+	free(readheader);
+	free(resampled);
+	
+	return;
+}
+
+// One-parameter continuation (--continuation). The equilibrium is followed as a curve of points
+// y = (x, q) where G(x, q) = x: G is one generation of the recursion (see generation()), q is the
+// parameter, scaled to run from 0 (low) to 1 (high), and x is the frequencies of the genotypes
+// present, bar the commonest (which is 1 less the rest, so that they stay on the simplex).
+// Genotypes that the run from the start leaves below the threshold are taken to be dying out, and
+// are held at exactly 0 if the rest then make up an equilibrium that isn't unstable, so that the
+// branch is followed on that face of the simplex. (Otherwise it can be degenerate: a class that is
+// neutral while rare dies out only slowly, and Newton's method converges just as slowly.)
+
+int continuationfree[NGENOTYPES];		// Genotypes whose frequencies make up x...
+int continuationunknowns;				// ...how many there are, plus 1 for q
+int continuationdropped;				// The genotype that is 1 less the rest
+long long continuationevaluations;		// Generations worked out, to report the cost
+
+// The genotype frequencies at y, and the parameter.
+
+double continuationpoint (const double * y, double * f)
+{
+	double last = 1;
+	int k;
+	
+	for (k = 0; k < ngenotypes; k++) f[k] = 0;
+	for (k = 0; k < continuationunknowns - 1; k++)
+	{
+		f[continuationfree[k]] = y[k];
+		last -= y[k];
+	}
+	f[continuationdropped] = last;
+	
+	return continuationlow + y[continuationunknowns - 1] * ((double) continuationhigh - continuationlow);
+}
+
+// One generation from f[] (in place), at parameter p. The parameter is only a float, so the result
+// is interpolated between the floats either side of p; otherwise it would be a step function of p,
+// and Newton's method could go back and forth across a step for ever.
+
+void continuationmap (double * f, double p)
+{
+	double g[NGENOTYPES];
+	double weight;
+	float below = p;
+	float above;
+	int i;
+	
+	if (below > p) below = nextafterf(below, -INFINITY);
+	above = nextafterf(below, INFINITY);
+	weight = (p - below) / ((double) above - below);
+	
+	for (i = 0; i < ngenotypes; i++) g[i] = f[i];
+	*continuationvalues[continuationwhich] = below;
+	builtin_generation(f, Q, F);
+	*continuationvalues[continuationwhich] = above;
+	builtin_generation(g, Q, F);
+	continuationevaluations += 2;
+	
+	for (i = 0; i < ngenotypes; i++) f[i] = (1 - weight) * f[i] + weight * g[i];
+	
+	return;
+}
+
+// The residual G(x, q) - x, whose roots make up the branch.
+
+void continuationresidual (const double * y, double * r)
+{
+	double f[NGENOTYPES];
+	double p;
+	int k;
+	
+	p = continuationpoint(y, f);
+	continuationmap(f, p);
+	for (k = 0; k < continuationunknowns - 1; k++) r[k] = f[continuationfree[k]] - y[k];
+	
+	return;
+}
+
+// The Jacobian of G with respect to every genotype frequency but the dropped one (which makes up the
+// difference), from the derivatives G[] given by generationjacobian_dual(), in a[] (ngenotypes - 1 square).
+
+void simplexjacobian (const double * G, int dropped, double * a)
+{
+	int m = ngenotypes - 1;
+	int row = 0;
+	int column;
+	int i;
+	int j;
+	
+	for (i = 0; i < ngenotypes; i++)
+	{
+		if (i == dropped) continue;
+		
+		column = 0;
+		for (j = 0; j < ngenotypes; j++)
+		{
+			if (j == dropped) continue;
+			a[row * m + column] = G[i * JACOBIANCOLUMNS + j] - G[i * JACOBIANCOLUMNS + dropped];
+			column++;
+		}
+		row++;
+	}
+	
+	return;
+}
+
+// The derivatives of G at y (see generationjacobian_dual() in model2_kernel.h), with the parameter at the
+// float nearest it, in G[] (NGENOTYPES rows of JACOBIANCOLUMNS).
+
+void continuationderivatives (const double * y, double * G)
+{
+	double f[NGENOTYPES];
+	double next[NGENOTYPES];
+	
+	*continuationvalues[continuationwhich] = continuationpoint(y, f);
+	generationjacobian_dual(f, Q, F, next, G);
+	continuationevaluations += JACOBIANCOLUMNS;
+	
+	return;
+}
+
+// Its Jacobian with respect to x and q, in the first continuationunknowns - 1 rows of J[] (each of
+// continuationunknowns elements, so that another row can be added).
+
+void continuationjacobian (const double * y, double * J)
+{
+	double G[NGENOTYPES * JACOBIANCOLUMNS];
+	double range = (double) continuationhigh - continuationlow;
+	int u = continuationunknowns;
+	int row;
+	int i;
+	int j;
+	
+	continuationderivatives(y, G);
+	
+	for (i = 0; i < u - 1; i++)
+	{
+		row = continuationfree[i] * JACOBIANCOLUMNS;
+		for (j = 0; j < u - 1; j++) J[i * u + j] = G[row + continuationfree[j]] - G[row + continuationdropped] - (i == j);
+		J[i * u + u - 1] = G[row + NGENOTYPES + continuationwhich] * range;
+	}
+	
+	return;
+}
+
+// The Jacobian of G itself at y, on the simplex (see simplexjacobian()), including the genotypes
+// held at 0, in a[]. Its eigenvalues decide whether the equilibrium is stable, those belonging to
+// the genotypes held at 0 deciding whether they can invade.
+
+void continuationfulljacobian (const double * y, double * a)
+{
+	double G[NGENOTYPES * JACOBIANCOLUMNS];
+	
+	continuationderivatives(y, G);
+	simplexjacobian(G, continuationdropped, a);
+	
+	return;
+}
+
+// Solve a x = b (n equations, a[] by rows) by Gaussian elimination with partial pivoting, leaving x
+// in b[] and overwriting a[]. Returns the determinant of a (0 if it's singular, when b[] is left
+// half worked).
+
+double solvelinear (double * a, double * b, int n)
+{
+	double determinant = 1;
+	double factor;
+	double swap;
+	int pivot;
+	int i;
+	int j;
+	int k;
+	
+	for (k = 0; k < n; k++)
+	{
+		pivot = k;
+		for (i = k + 1; i < n; i++)
+		{
+			if (fabs(a[i * n + k]) > fabs(a[pivot * n + k])) pivot = i;
+		}
+		if (a[pivot * n + k] == 0) return 0;
+		
+		if (pivot != k)
+		{
+			for (j = 0; j < n; j++)
+			{
+				swap = a[k * n + j];
+				a[k * n + j] = a[pivot * n + j];
+				a[pivot * n + j] = swap;
+			}
+			swap = b[k];
+			b[k] = b[pivot];
+			b[pivot] = swap;
+			determinant = -determinant;
+		}
+		determinant *= a[k * n + k];
+		
+		for (i = k + 1; i < n; i++)
+		{
+			factor = a[i * n + k] / a[k * n + k];
+			for (j = k; j < n; j++) a[i * n + j] -= factor * a[k * n + j];
+			b[i] -= factor * b[k];
+		}
+	}
+	
+	for (k = n - 1; k >= 0; k--)
+	{
+		for (j = k + 1; j < n; j++) b[k] -= a[k * n + j] * b[j];
+		b[k] /= a[k * n + k];
+	}
+	
+	return determinant;
+}
+
+// The spectral radius of a[] (m square), from the size of its 2^SQUARINGS th power, which is
+// rescaled before each squaring so as not to overflow.
+
+double spectralradius (const double * a, int m)
+{
+	double power[NGENOTYPES * NGENOTYPES];
+	double squared[NGENOTYPES * NGENOTYPES];
+	double logscale = 0;
+	double largest;
+	int s;
+	int i;
+	int j;
+	int k;
+	
+	for (i = 0; i < m * m; i++) power[i] = a[i];
+	
+	for (s = 0; ; s++)
+	{
+		largest = 0;
+		for (i = 0; i < m * m; i++) largest = fmax(largest, fabs(power[i]));
+		if (largest == 0) return 0;
+		if (s == SQUARINGS) break;
+		
+		for (i = 0; i < m * m; i++) power[i] /= largest;
+		logscale = 2 * (logscale + log(largest));
+		
+		for (i = 0; i < m; i++)
+		{
+			for (j = 0; j < m; j++)
+			{
+				squared[i * m + j] = 0;
+				for (k = 0; k < m; k++) squared[i * m + j] += power[i * m + k] * power[k * m + j];
+			}
+		}
+		for (i = 0; i < m * m; i++) power[i] = squared[i];
+	}
+	
+	return exp((logscale + log(largest)) / (1 << SQUARINGS));
+}
+
+// Whether an equilibrium whose Jacobian has this spectral radius is stable.
+
+const char * stabilityname (double radius)
+{
+	if (radius < 1 - NEUTRALBAND) return "stable";
+	if (radius > 1 + NEUTRALBAND) return "unstable";
+	return "neutral";
+}
+
+// The test functions watched along the branch at y, each of which changes sign at something worth
+// reporting: 0, the parameter's part of the tangent, at a fold; 1 and 2, det(Gx - I) and det(Gx + I),
+// at an eigenvalue passing through +1 (e.g. a transcritical point) or -1 (period doubling); 3 to 5,
+// the female, male and inconstant frequencies less the threshold, at a change of state; and 6, the
+// lowest genotype frequency (plus EDGE, so that rounding doesn't count), where the branch leaves the
+// simplex, i.e. genotypes die out. Determinants too small to tell from 0 are taken as 0, which isn't
+// a change of sign, so that an eigenvalue sitting at 1 (see above) doesn't set off false alarms.
+// The tangent, of length 1 and pointing the same way along the branch as previous[], is put in t[],
+// and the spectral radius of Gx in *radius. Returns 0 if the tangent can't be worked out.
+
+int continuationtests (const double * y, const double * previous, double * t, double * tests, double * radius)
+{
+	double J[NGENOTYPES * NGENOTYPES];
+	double G[NGENOTYPES * NGENOTYPES];
+	double a[NGENOTYPES * NGENOTYPES];
+	double b[NGENOTYPES];
+	double f[NGENOTYPES];
+	double sums[4] = {0, 0, 0, 0};
+	double determinant;
+	double length = 0;
+	int u = continuationunknowns;
+	int m = ngenotypes - 1;
+	int shift;
+	int i;
+	int j;
+	
+	continuationfulljacobian(y, G);
+	*radius = spectralradius(G, m);
+	
+	for (shift = -1; shift <= 1; shift += 2)
+	{
+		for (i = 0; i < m; i++)
+		{
+			for (j = 0; j < m; j++) a[i * m + j] = G[i * m + j] + ((i == j) ? shift : 0);
+			b[i] = 0;
+		}
+		determinant = solvelinear(a, b, m);
+		tests[(shift < 0) ? 1 : 2] = (fabs(determinant) < DETERMINANTNOISE) ? 0 : determinant;
+	}
+	
+	continuationjacobian(y, J);
+	for (i = 0; i < (u - 1) * u; i++) a[i] = J[i];
+	for (i = 0; i < u; i++)
+	{
+		a[(u - 1) * u + i] = previous[i];
+		t[i] = (i == u - 1);
+	}
+	if (solvelinear(a, t, u) == 0) return 0;
+	for (i = 0; i < u; i++) length += t[i] * t[i];
+	for (i = 0; i < u; i++) t[i] /= sqrt(length);
+	tests[0] = t[u - 1];
+	
+	continuationpoint(y, f);
+	tests[6] = f[0];
+	for (i = 0; i < ngenotypes; i++)
+	{
+		sums[phenotypes[i]] += f[i];
+		tests[6] = fmin(tests[6], f[i]);
+	}
+	tests[6] += EDGE;
+	tests[3] = sums[FEMALE] - threshold;
+	tests[4] = sums[MALE] - threshold;
+	tests[5] = sums[INCONSTANT] - threshold;
+	
+	return 1;
+}
+
+// Newton's method for the equilibrium, with q held where it is (for the start of the branch).
+// Returns 0 if it doesn't converge.
+
+int continuationsettle (double * y)
+{
+	double J[NGENOTYPES * NGENOTYPES];
+	double a[NGENOTYPES * NGENOTYPES];
+	double b[NGENOTYPES];
+	double change;
+	int u = continuationunknowns;
+	int iteration;
+	int i;
+	int j;
+	
+	for (iteration = 0; iteration < NEWTONITERATIONS; iteration++)
+	{
+		continuationresidual(y, b);
+		continuationjacobian(y, J);
+		for (i = 0; i < u - 1; i++)
+		{
+			for (j = 0; j < u - 1; j++) a[i * (u - 1) + j] = J[i * u + j];
+		}
+		if (solvelinear(a, b, u - 1) == 0) return 0;
+		
+		change = 0;
+		for (i = 0; i < u - 1; i++)
+		{
+			y[i] -= b[i];
+			change = fmax(change, fabs(b[i]));
+		}
+		if (isnan(change)) return 0;
+		if (change < NEWTONTOLERANCE) return 1;
+	}
+	
+	return 0;
+}
+
+// One step along the branch: from y, by ds along the tangent t[] (the predictor), then back onto
+// the branch by Newton's method, keeping to the hyperplane through the predicted point at right
+// angles to t[] (the corrector). The point reached is put in z[]. Returns the number of Newton
+// iterations, or 0 if they didn't converge.
+
+int continuationstep (const double * y, const double * t, double ds, double * z)
+{
+	double a[NGENOTYPES * NGENOTYPES];
+	double b[NGENOTYPES];
+	double predicted[NGENOTYPES];
+	double change;
+	int u = continuationunknowns;
+	int iteration;
+	int i;
+	
+	for (i = 0; i < u; i++) predicted[i] = z[i] = y[i] + ds * t[i];
+	
+	for (iteration = 1; iteration <= NEWTONITERATIONS; iteration++)
+	{
+		continuationresidual(z, b);
+		continuationjacobian(z, a);
+		b[u - 1] = 0;
+		for (i = 0; i < u; i++)
+		{
+			b[u - 1] += t[i] * (z[i] - predicted[i]);
+			a[(u - 1) * u + i] = t[i];
+		}
+		if (solvelinear(a, b, u) == 0) return 0;
+		
+		change = 0;
+		for (i = 0; i < u; i++)
+		{
+			z[i] -= b[i];
+			change = fmax(change, fabs(b[i]));
+		}
+		if (isnan(change)) return 0;
+		if (change < NEWTONTOLERANCE) return iteration;
+	}
+	
+	return 0;
+}
+
+// The state of the equilibrium, from its test functions.
+
+int continuationregime (const double * tests)
+{
+	return classify(tests[3] + threshold, tests[4] + threshold, tests[5] + threshold);
+}
+
+// Find where test function k changes sign between y (with tangent t[] and test functions tests[])
+// and the point ds further along the branch, by bisection. Returns the distance along the branch
+// to the first point found beyond the change.
+
+double continuationlocate (const double * y, const double * t, const double * tests, double ds, int k)
+{
+	double z[NGENOTYPES];
+	double tz[NGENOTYPES];
+	double ztests[NTESTS];
+	double radius;
+	double low = 0;
+	double high = ds;
+	double mid;
+	int bisection;
+	
+	for (bisection = 0; bisection < BISECTIONS; bisection++)
+	{
+		mid = (low + high) / 2;
+		if (continuationstep(y, t, mid, z) == 0 || continuationtests(z, t, tz, ztests, &radius) == 0) break;
+		if (ztests[k] * tests[k] < 0)
+		{
+			high = mid;
+		} else {
+			low = mid;
+		}
+	}
+	
+	return high;
+}
+
+// Report the event found there. radius and nowradius are the spectral radii at each end of the step.
+
+void continuationreport (const double * y, const double * t, const double * tests, double s, int k, double radius, double nowradius)
+{
+	const char * classes[] = {"", "females", "males", "inconstants"};
+	double z[NGENOTYPES];
+	double tz[NGENOTYPES];
+	double ztests[NTESTS];
+	double f[NGENOTYPES];
+	double g[NGENOTYPES];
+	double zradius;
+	int absent = 0;
+	int i;
+	
+	continuationstep(y, t, s, z);
+	continuationtests(z, t, tz, ztests, &zradius);
+	continuationpoint(y, f);
+	
+	printf("  %s = %-12.7G  ", continuationnames[continuationwhich], continuationpoint(z, g));
+	
+	if (k == 6)
+	{
+		for (i = 0; i < ngenotypes; i++)
+		{
+			if (f[i] < EDGE || g[i] > 1000 * EDGE) continue;		// Genotypes dying out together all get near 0 here
+			printf("%s%s", absent ? " and " : "", genotypenames[i]);
+			absent++;
+		}
+		printf(" die%s out, and the branch leaves the simplex\n", (absent == 1) ? "s" : "");
+	} else if (k == 0) {
+		printf("Fold: the branch turns back\n");
+	} else if (k == 1 || k == 2) {
+		printf("An eigenvalue passes through %s", (k == 1) ? "+1" : "-1");
+		if (k == 1)
+		{
+			for (i = 1; i <= 3; i++)
+			{
+				if (ztests[2 + i] >= 0) continue;
+				printf("%s %s", absent ? " and" : " (transcritical):", classes[i]);
+				absent++;
+			}
+			if (absent) printf(" can%s invade", (nowradius < 1) ? " no longer" : "");
+		} else {
+			printf(" (period doubling)");
+		}
+		if (radius < 1 && nowradius > 1) printf(", and the equilibrium becomes unstable");
+		if (radius > 1 && nowradius < 1) printf(", and the equilibrium becomes stable");
+		printf("\n");
+	} else {
+		printf("%s -> %s: %s %s the threshold%s\n", regimenames[continuationregime(tests)], regimenames[continuationregime(ztests)], classes[k - 2],
+			(tests[k] > 0) ? "fall below" : "rise above", (radius > 1 + NEUTRALBAND) ? " (on an unstable part of the branch)" : "");
+	}
+	
+	return;
+}
+
+// Follow the branch from the equilibrium reached at low (from the start in use) towards high,
+// reporting each event on the way, and saving every point to filename.
+
+void continuationsweep (char * filename)
+{
+	double y[NGENOTYPES];
+	double z[NGENOTYPES];
+	double w[NGENOTYPES];
+	double t[NGENOTYPES];
+	double tz[NGENOTYPES];
+	double f[NGENOTYPES];
+	double g[NGENOTYPES];
+	double tests[NTESTS];
+	double ztests[NTESTS];
+	double where[NTESTS];
+	double radius = 0;
+	double zradius;
+	double ds = FIRSTSTEP;
+	double taken;
+	double landing;
+	double bound;
+	double s;
+	double p;
+	double start;
+	float saved = *continuationvalues[continuationwhich];
+	float parameters[NPARAMETERS];
+	FILE * outfile;
+	int held[NGENOTYPES];
+	int which[NTESTS];
+	int events;
+	int steps = 0;
+	int iterations;
+	int regime;
+	int settled;
+	int finished = 0;
+	int u;
+	int i;
+	int k;
+	
+	start = seconds();
+	
+	// Run the start to its equilibrium at low...
+	
+	*continuationvalues[continuationwhich] = continuationlow;
+	parameters[0] = h;
+	parameters[1] = S;
+	parameters[2] = d;
+	parameters[3] = V;
+	parameters[4] = PSatF;
+	parameters[5] = ppY;
+	regime = runpoint(f, Q, F, parameters);
+	absorbing = 0;		// The jump to the absorbing state would hide the map's derivatives there
+	
+	continuationdropped = 0;
+	for (i = 1; i < ngenotypes; i++)
+	{
+		if (f[i] > f[continuationdropped]) continuationdropped = i;
+	}
+	
+	// ...then pin it down by Newton's method, holding the genotypes below the threshold at 0. Any
+	// that the rest would make are let go, and tried again without; if the equilibrium isn't found,
+	// or is unstable (so the ones held at 0 would invade), they're all let go.
+	
+	for (i = 0; i < ngenotypes; i++) held[i] = (i != continuationdropped && f[i] < threshold);
+	
+	while (1)
+	{
+		u = 0;
+		for (i = 0; i < ngenotypes; i++)
+		{
+			if (i == continuationdropped || held[i]) continue;
+			continuationfree[u] = i;
+			y[u++] = f[i];
+		}
+		y[u] = 0;
+		continuationunknowns = u + 1;
+		
+		for (i = 0; i <= u; i++) tz[i] = (i == u);		// The branch is followed towards high
+		settled = (continuationsettle(y) && continuationtests(y, tz, t, tests, &radius));
+		if (u == ngenotypes - 1) break;
+		
+		if (settled)
+		{
+			p = continuationpoint(y, g);
+			continuationmap(g, p);
+			for (i = 0; i < ngenotypes; i++)
+			{
+				if (held[i] && fabs(g[i]) > EDGE)
+				{
+					held[i] = 0;
+					settled = 0;
+				}
+			}
+			if (settled == 0) continue;
+			if (radius < 1 + NEUTRALBAND) break;
+		}
+		
+		for (i = 0; i < ngenotypes; i++) held[i] = 0;
+	}
+	
+	if (settled == 0)
+	{
+		printf("The equilibrium at %s = %G couldn't be pinned down (the run may not have settled; try more --iterations).\n", continuationnames[continuationwhich], continuationlow);
+		exit(1);
+	}
+	u = continuationunknowns;
+	
+	outfile = fopen(filename, "w");
+	if (outfile == NULL)
+	{
+		printf("Failed to create output file!\n");
+		exit(1);
+	}
+	fprintf(outfile, "# %s", continuationnames[continuationwhich]);
+	for (i = 0; i < ngenotypes; i++) fprintf(outfile, " %s", genotypenames[i]);
+	fprintf(outfile, " females males inconstants spectral_radius state\n");
+	
+	printf("Starting from %s at %s = %G (%s", regimenames[regime], continuationnames[continuationwhich], continuationlow, stabilityname(radius));
+	for (i = 0, k = 0; i < ngenotypes; i++)
+	{
+		if (held[i] == 0) continue;
+		printf("%s%s", k ? ", " : ", holding ", genotypenames[i]);
+		k++;
+	}
+	printf("%s)\n\n", k ? " at 0" : "");
+	
+	// ...and follow the branch, until it leaves the range or the simplex.
+	
+	while (1)
+	{
+		p = continuationpoint(y, f);
+		fprintf(outfile, "%.9G", p);
+		for (i = 0; i < ngenotypes; i++) fprintf(outfile, " %.9G", f[i]);
+		fprintf(outfile, " %.9G %.9G %.9G %.9G %s\n", tests[3] + threshold, tests[4] + threshold, tests[5] + threshold, radius, regimenames[continuationregime(tests)]);
+		
+		if (finished || tests[6] < 0 || steps == CONTINUATIONSTEPS) break;
+		
+		// Take a step, landing exactly on the end of the range if it would go beyond...
+		
+		iterations = continuationstep(y, t, ds, z);
+		taken = ds;
+		if (iterations && (z[u - 1] > 1 || z[u - 1] < 0))
+		{
+			bound = (z[u - 1] > 1) ? 1 : 0;
+			for (k = 0; k < BISECTIONS && fabs(z[u - 1] - bound) > NEWTONTOLERANCE; k++)
+			{
+				landing = taken * (bound - y[u - 1]) / (z[u - 1] - y[u - 1]);
+				if (continuationstep(y, t, landing, w) == 0) break;
+				for (i = 0; i < u; i++) z[i] = w[i];
+				taken = landing;
+			}
+			finished = 1;
+		}
+		if (iterations == 0 || continuationtests(z, t, tz, ztests, &zradius) == 0)
+		{
+			finished = 0;
+			ds /= 2;
+			if (ds >= SMALLESTSTEP) continue;
+			printf("  %s = %-12.7G  The branch can't be followed any further\n", continuationnames[continuationwhich], p);
+			break;
+		}
+		steps++;
+		
+		// ...then locate the events in the step, and report them in the order they come along the
+		// branch, stopping at the edge of the simplex...
+		
+		events = 0;
+		for (k = 0; k < NTESTS; k++)
+		{
+			if (tests[k] * ztests[k] >= 0) continue;
+			s = continuationlocate(y, t, tests, taken, k);
+			for (i = events; i > 0 && where[i - 1] > s; i--)
+			{
+				where[i] = where[i - 1];
+				which[i] = which[i - 1];
+			}
+			where[i] = s;
+			which[i] = k;
+			events++;
+		}
+		for (i = 0; i < events; i++)
+		{
+			continuationreport(y, t, tests, where[i], which[i], radius, zradius);
+			if (which[i] == 6) break;
+		}
+		if (i < events)
+		{
+			continuationstep(y, t, where[i], z);
+			continuationtests(z, t, tz, ztests, &zradius);
+		}
+		
+		// ...and move on.
+		
+		for (i = 0; i < u; i++)
+		{
+			y[i] = z[i];
+			t[i] = tz[i];
+		}
+		for (k = 0; k < NTESTS; k++) tests[k] = ztests[k];
+		radius = zradius;
+		
+		if (iterations <= 3) ds = fmin(ds * 1.5, LARGESTSTEP);
+	}
+	
+	fclose(outfile);
+	phasetime[RECURSION] = seconds() - start;
+	
+	printf("\nEnded at %s = %G, %s (%s), after %d steps and %lld generations' worth of work\n", continuationnames[continuationwhich], p,
+		regimenames[continuationregime(tests)], stabilityname(radius), steps, continuationevaluations);
+	printf("Saved %s\n", filename);
+	
+	*continuationvalues[continuationwhich] = saved;
+	
+	return;
+}
+
+// --jacobian: the derivatives of one generation at the final state of the --onerun run, f[] (see
+// generationjacobian_dual() in model2_kernel.h), then, on the simplex (the commonest genotype making up the
+// difference), its spectral radius, and how the equilibrium moves with each parameter: from
+// x = G(x, p), dx/dp = (I - Gx)^-1 Gp, summed over each phenotype. That assumes f[] is a fixed point,
+// so how far it moves in one more generation is printed too.
+
+void printjacobian (const double * f)
+{
+	double G[NGENOTYPES * JACOBIANCOLUMNS];
+	double next[NGENOTYPES];
+	double Gx[NGENOTYPES * NGENOTYPES];
+	double a[NGENOTYPES * NGENOTYPES];
+	double b[NGENOTYPES];
+	double sums[4];
+	double moved = 0;
+	double radius;
+	int m = ngenotypes - 1;
+	int dropped = 0;
+	int row;
+	int i;
+	int j;
+	int k;
+	
+	generationjacobian_dual(f, Q, F, next, G);
+	for (i = 0; i < ngenotypes; i++)
+	{
+		if (f[i] > f[dropped]) dropped = i;
+		moved = fmax(moved, fabs(next[i] - f[i]));
+	}
+	
+	printf("\nDerivatives of one generation at the final state, with respect to each genotype frequency...\n\n      ");
+	for (j = 0; j < ngenotypes; j++) printf("%12s", genotypenames[j]);
+	printf("\n");
+	for (i = 0; i < ngenotypes; i++)
+	{
+		printf("%-6s", genotypenames[i]);
+		for (j = 0; j < ngenotypes; j++) printf("%12.5G", G[i * JACOBIANCOLUMNS + j]);
+		printf("\n");
+	}
+	
+	printf("\n...and each parameter:\n\n      ");
+	for (j = 0; j < NCONTINUABLES; j++) printf("%12s", continuationnames[j]);
+	printf("\n");
+	for (i = 0; i < ngenotypes; i++)
+	{
+		printf("%-6s", genotypenames[i]);
+		for (j = 0; j < NCONTINUABLES; j++) printf("%12.5G", G[i * JACOBIANCOLUMNS + NGENOTYPES + j]);
+		printf("\n");
+	}
+	
+	simplexjacobian(G, dropped, Gx);
+	radius = spectralradius(Gx, m);
+	printf("\nSpectral radius on the simplex = %.6f (%s); largest change in a genotype frequency in one more generation = %.3G\n", radius, stabilityname(radius), moved);
+	
+	printf("\nChange in the equilibrium per unit change in each parameter:\n\n");
+	printf("  %-9s%12s%12s%12s\n", "Parameter", "Females", "Males", "Inconstants");
+	for (k = 0; k < NCONTINUABLES; k++)
+	{
+		for (i = 0; i < m * m; i++) a[i] = ((i / m == i % m) ? 1 : 0) - Gx[i];
+		for (i = 0, row = 0; i < ngenotypes; i++)
+		{
+			if (i != dropped) b[row++] = G[i * JACOBIANCOLUMNS + NGENOTYPES + k];
+		}
+		
+		printf("  %-9s", continuationnames[k]);
+		if (fabs(solvelinear(a, b, m)) < DETERMINANTNOISE)
+		{
+			printf("  none (an eigenvalue is 1)\n");
+			continue;
+		}
+		
+		sums[FEMALE] = sums[MALE] = sums[INCONSTANT] = 0;
+		for (i = 0, row = 0; i < ngenotypes; i++)
+		{
+			if (i == dropped) continue;
+			sums[phenotypes[i]] += b[row];
+			sums[phenotypes[dropped]] -= b[row];
+			row++;
+		}
+		printf("%12.5G%12.5G%12.5G\n", sums[FEMALE], sums[MALE], sums[INCONSTANT]);
+	}
+	
+	return;
+}
+
+// The spatial model (--lattice). Tallies of the demes in each state, and their mean phenotype
+// frequencies, at each census (see latticecensus())...
+
+long long latticeregimes[6];
+double latticesums[3];
+
+// ...which is given every deme in turn (by simulate_lattice()), and prints a line of the report once
+// it has seen the last. The states of the demes are also kept in result[][], so that the last census
+// can be drawn.
+
+void latticecensus (int generation, int x, int y, double * f)
+{
+	double female;
+	double male;
+	double inconstant;
+	double demes = (double) lattice * lattice;
+	int regime;
+	int n;
+	
+	phenotypesums(f, &female, &male, &inconstant);
+	regime = classify(female, male, inconstant);
+	result[x][y] = regime;
+	
+	latticeregimes[regime]++;
+	latticesums[0] += female;
+	latticesums[1] += male;
+	latticesums[2] += inconstant;
+	
+	if (x == lattice - 1 && y == lattice - 1)
+	{
+		printf("%10d  ", generation);
+		for (n = 1; n <= 5; n++) printf("%.4f  ", latticeregimes[n] / demes);
+		printf("%.4f    ", latticeregimes[0] / demes);
+		printf("%.6f  %.6f  %.6f\n", latticesums[0] / demes, latticesums[1] / demes, latticesums[2] / demes);
+		
+		for (n = 0; n < 6; n++) latticeregimes[n] = 0;
+		for (n = 0; n < 3; n++) latticesums[n] = 0;
+	}
+	
+	return;
+}
+
+// Run the lattice, every deme starting from the start in use (see --pgd), except for a patch in the
+// centre starting from the other one, so that the front between them can be followed.
+//
+// Of each deme's pollen, 1 - dispersal stays at home, and the rest is spread over the demes within
+// dispersalradius (along each axis) other than itself, by the dispersal kernel. So that the smoothing
+// is two passes along the axes rather than one over a square, the kernel is the product of a kernel
+// along each axis, dispersalweights[] (which add up to 1): equal weights, or Gaussian, with a standard
+// deviation of half the radius. Smoothing by the product includes a fraction w0 = dispersalweights[radius]^2
+// of the deme's own pollen, so a deme receives (1 - dispersal / (1 - w0)) of its own pollen, plus
+// dispersal / (1 - w0) of the smoothed pollen.
+
+void latticesweep (char * filename)
+{
+	double inside[MAXGENOTYPES];
+	double outside[MAXGENOTYPES];
+	double total = 0;
+	double sigma = dispersalradius / 2.0;
+	double start;
+	int k;
+	
+	for (k = -dispersalradius; k <= dispersalradius; k++)
+	{
+		dispersalweights[k + dispersalradius] = (dispersalshape == GAUSSIANKERNEL) ? exp(-k * k / (2 * sigma * sigma)) : 1;
+		total += dispersalweights[k + dispersalradius];
+	}
+	for (k = 0; k <= 2 * dispersalradius; k++) dispersalweights[k] /= total;
+	
+	startcellfrom(outside, pgd);
+	startcellfrom(inside, !pgd);
+	
+	printf("Generation  ");
+	for (k = 1; k <= 5; k++) printf("%-8s", regimenames[k]);
+	printf("%-10s", regimenames[0]);
+	printf("Females   Males     Inconstants\n");
+	
+	start = seconds();
+	builtin_simulatelattice(lattice, Q, F, outside, inside, patchradius, latticecensus);
+	phasetime[RECURSION] = seconds() - start;
+	
+	printf("\nTime per deme per generation = %.3f ns\n\n", 1e9 * phasetime[RECURSION] / ((double) lattice * lattice * (endpoint ? endpoint : 1)));
+	
+	start = seconds();
+	drawbmp(filename, 1, regimecolour);
+	printf("Saved %s\n", filename);
+	phasetime[BMPOUTPUT] = seconds() - start;
+	
+	return;
+}
+
+// Wilson score interval (95%) for a proportion of successes out of trials.
+
+void wilson (long long successes, long long trials, double * low, double * high)
+{
+	double p = (double) successes / trials;
+	double z2n = WILSONZ * WILSONZ / trials;
+	double centre = (p + z2n / 2) / (1 + z2n);
+	double half = WILSONZ * sqrt(p * (1 - p) / trials + z2n / (4 * trials)) / (1 + z2n);
+	
+	*low = fmax(0, centre - half);
+	*high = fmin(1, centre + half);
+	
+	return;
+}
+
+// Run the replicates of one cell (for --replicates), in batches of REPLICATEBATCH shared between
+// threads, and add up the outcomes: counts[0] undecided, counts[LOST] and counts[FIXED].
+
+void runreplicates (float Q, float F, long long * counts, long long * generations)
+{
+	double start[MAXGENOTYPES];
+	long long batchcounts[3];
+	long long batchgenerations;
+	int batches = (replicates + REPLICATEBATCH - 1) / REPLICATEBATCH;
+	int batch;
+	int first;
+	int count;
+	
+	startcell(start);
+	counts[0] = counts[LOST] = counts[FIXED] = 0;
+	*generations = 0;
+	
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic) private(first, count, batchcounts, batchgenerations)
+#endif
+	for (batch = 0; batch < batches; batch++)
+	{
+		first = batch * REPLICATEBATCH;
+		count = (replicates - first < REPLICATEBATCH) ? replicates - first : REPLICATEBATCH;
+		
+		builtin_simulatereplicates(Q, F, start, first, count, batchcounts, &batchgenerations);
+		
+#ifdef _OPENMP
+		#pragma omp critical (replicates)
+#endif
+		{
+			counts[0] += batchcounts[0];
+			counts[LOST] += batchcounts[LOST];
+			counts[FIXED] += batchcounts[FIXED];
+			*generations += batchgenerations;
+		}
+	}
+	
+	return;
+}
+
+// --replicates for a whole graph: the cells are run in turn (each by all the threads), and each
+// cell's results are written to the text file as soon as it's done.
+
+void replicatesweep (char * filename)
+{
+	long long counts[3];
+	long long generations;
+	double low;
+	double high;
+	double start;
+	FILE * outfile;
+	float Q;
+	float F;
+	int x;
+	int y;
+	
+	outfile = fopen(filename, "w");
+	if (outfile == NULL)
+	{
+		printf("Failed to create output file!\n");
+		exit(1);
+	}
+	fprintf(outfile, "# x y Q F replicates lost fixed undecided fixation low high (95%% Wilson interval)\n");
+	
+	if (progress)
+	{
+		progress_cells = 0;
+		progress_total = subdivisions * subdivisions;
+		progress_generations = 0;
+		progress_start = seconds();
+		progress_next = progress_start + PROGRESSINTERVAL;
+	}
+	
+	start = seconds();
+	if (perfcounters) startcounters();
+	
+	for (y = 0; y < subdivisions; y++)
+	{
+		for (x = 0; x < subdivisions; x++)
+		{
+			cellparameters(x, y, &Q, &F);
+			runreplicates(Q, F, counts, &generations);
+			
+			fixation[y * subdivisions + x] = (double) counts[FIXED] / replicates;
+			wilson(counts[FIXED], replicates, &low, &high);
+			fprintf(outfile, "%d %d %G %G %d %lld %lld %lld %.6G %.6G %.6G\n", x, y, Q, F, replicates,
+				counts[LOST], counts[FIXED], counts[0], fixation[y * subdivisions + x], low, high);
+			fflush(outfile);
+			
+			if (progress) reportprogress(generations);
+		}
+	}
+	
+	if (perfcounters) stopcounters();
+	phasetime[RECURSION] = seconds() - start;
+	
+	fclose(outfile);
+	printf("Saved %s\n", filename);
+	
+	return;
+}
+
+// For --replicates: the fixation probability as a shade of grey (black = 0, white = 1).
+
+void fixationcolour (int x, int y, int * red, int * green, int * blue)
+{
+	*red = *green = *blue = (int) (255 * fixation[y * subdivisions + x] + 0.5);
+	
+	return;
+}
+
+// Time one cell (Q = F = 0.5) with the current settings, repeating it for at least BENCHMARKTIME seconds.
+// Returns seconds per cell.
+
+double timecell (void)
+{
+	double f[MAXGENOTYPES];
+	double start;
+	double elapsed;
+	int flags;
+	int repeats = 0;
+	
+	start = seconds();
+	do
+	{
+		runcell(f, 0.5, 0.5, &flags);
+		repeats++;
+		elapsed = seconds() - start;
+	} while (elapsed < BENCHMARKTIME);
+	
+	return elapsed / repeats;
+}
+
+// --benchmark mode. Results are printed as they come, and saved to filename as JSON.
+
+void benchmark (char * filename)
+{
+	FILE * outfile;
+	double start;
+	double cost;
+	int openmp = 0;
+	int maxthreads = 1;
+	int userendpoint = endpoint;
+	int r; int e; int n; int t;
+	
+	outfile = fopen(filename, "w");
+	if (outfile == NULL)
+	{
+		printf("Failed to create output file!\n");
+		exit(1);
+	}
+	
+#ifdef _OPENMP
+	openmp = 1;
+	maxthreads = omp_get_num_procs();
+#endif
+	
+	allocateresult(benchmarksizes[sizeof(benchmarksizes) / sizeof(int) - 1]);
+	progress = 0;
+	
+	printf("\nBenchmarking %s (h = %G, V = %G, precision = %s, threads available = %d)\n", kernel_simulate ? kernel_description : "Model " STRINGIFY(MODEL), h, V, precisionnames[precision], maxthreads);
+	
+	fprintf(outfile, "{\n");
+	fprintf(outfile, "  \"model\": \"%s\",\n", kernel_simulate ? kernel_name : "model" STRINGIFY(MODEL));
+	fprintf(outfile, "  \"h\": %G,\n  \"V\": %G,\n", h, V);
+	fprintf(outfile, "  \"precision\": \"%s\",\n", precisionnames[precision]);
+	fprintf(outfile, "  \"ftz\": %s,\n  \"extinction\": %G,\n", flushtozero ? "true" : "false", extinction);
+	fprintf(outfile, "  \"lazynorm\": %d,\n", lazynorm);
+	fprintf(outfile, "  \"openmp\": %s,\n", openmp ? "true" : "false");
+	fprintf(outfile, "  \"threads_available\": %d,\n", maxthreads);
+	fprintf(outfile, "  \"regimes\": [\n");
+	
+	for (r = 0; r < (int) (sizeof(benchmarkregimes) / sizeof(struct regime)); r++)
+	{
+		S = benchmarkregimes[r].S;
+		d = benchmarkregimes[r].d;
+		PSatF = benchmarkregimes[r].PSatF;
+		ppY = benchmarkregimes[r].ppY;
+		
+		if (kernel_simulate == NULL)
+		{
+			choosespecialisation();
+			reference_simulate = NULL;		// Time the recursion alone, without the accuracy checks
+		}
+		
+		printf("\n%s: S = %G, d = %G, PSatF = %G, ppY = %G (kernel = %s)\n", benchmarkregimes[r].name, S, d, PSatF, ppY, kernel_simulate ? kernel_name : specialisation);
+		
+		fprintf(outfile, "    {\n");
+		fprintf(outfile, "      \"name\": \"%s\",\n", benchmarkregimes[r].name);
+		fprintf(outfile, "      \"S\": %G, \"d\": %G, \"PSatF\": %G, \"ppY\": %G,\n", S, d, PSatF, ppY);
+		fprintf(outfile, "      \"kernel\": \"%s\",\n", kernel_simulate ? kernel_name : specialisation);
+		
+		// Cost of one generation, from a run that's long compared with the setup, but short enough
+		// that nothing has time to die out (and become subnormal)...
+		
+		endpoint = 1000;
+		cost = timecell() / endpoint * 1e9;
+		printf("  Generation: %.2f ns\n", cost);
+		fprintf(outfile, "      \"generation_ns\": %.3f,\n", cost);
+		
+		fprintf(outfile, "      \"cell\": [");
+		for (e = 0; e < (int) (sizeof(benchmarkendpoints) / sizeof(int)); e++)
+		{
+			endpoint = benchmarkendpoints[e];
+			cost = timecell() * 1e6;
+			printf("  Cell, %d iterations: %.2f us\n", endpoint, cost);
+			fprintf(outfile, "%s{\"iterations\": %d, \"us\": %.3f}", e ? ", " : "", endpoint, cost);
+		}
+		fprintf(outfile, "],\n");
+		
+		endpoint = userendpoint;
+		
+		fprintf(outfile, "      \"sweep\": [");
+		n = 0;
+		for (e = 0; e < (int) (sizeof(benchmarksizes) / sizeof(int)); e++)
+		{
+			subdivisions = benchmarksizes[e];
+			
+			for (t = 1; ; t *= 2)
+			{
+				if (t > maxthreads) t = maxthreads;
+#ifdef _OPENMP
+				omp_set_num_threads(t);
+#endif
+				start = seconds();
+				sweep(NULL);
+				cost = subdivisions * subdivisions / (seconds() - start);
+				
+				printf("  Graph, %dx%d, %d iterations, %d thread%s: %.1f cells/s\n", subdivisions, subdivisions, endpoint, t, t == 1 ? "" : "s", cost);
+				fprintf(outfile, "%s\n        {\"subdivisions\": %d, \"iterations\": %d, \"threads\": %d, \"cells_per_s\": %.3f}", n ? "," : "", subdivisions, endpoint, t, cost);
+				n++;
+				
+				if (t == maxthreads) break;
+			}
+		}
+		fprintf(outfile, "\n      ]\n");
+		fprintf(outfile, "    }%s\n", r < (int) (sizeof(benchmarkregimes) / sizeof(struct regime)) - 1 ? "," : "");
+	}
+	
+	fprintf(outfile, "  ]\n}\n");
+	fclose(outfile);
+	
+	printf("\nSaved %s\n", filename);
+	
+	return;
+}
+
+int main (int argc, char * argv[])
+{
+	double f[MAXGENOTYPES];
+	double reference[MAXGENOTYPES];
+	float frozen[MAXGENOTYPES];
+	int flags;
+	int referenceflags = 0;
+	int generations;
+	int regime;
+	
+	double male = 0;
+	double female = 0;
+	double inconstant = 0;
+	
+	long long counts[3];
+	long long replicategenerations;
+	double low;
+	double high;
+	
+	int n;
+	
+	char basename[1000];
+	char bmp_filename[1024];
+	char txt_filename[1024];
+	char itermap_filename[1024];
+	char bistable_filename[1024];
+	char basins_filename[1100];
+	char trajectory_filename[1100];
+	char fixation_filename[1100];
+	char lattice_filename[1100];
+	char sensitivity_filename[1100];
+	char continuation_filename[1100];
+	char iterations_filename[1024];
+	
+	FILE * textfile = NULL;
+	
+	double start;
+	
+	
+	start = seconds();
+	parsecommandline(argc, argv);
+	phasetime[PARSING] = seconds() - start;
+	
+	if (trajectoryin)
+	{
+		readtrajectory(trajectoryin);
+		return 0;
+	}
+	
+	if (ppY != 1 && kernelfile == NULL)
+	{
+		printf("The --ppY option is not implemented in Model 2 (except for kernels loaded with --kernel).\n");
+		exit(1);
+	}
+	
+	// Flush subnormal numbers to zero, if asked (the default extinction limit is a little above
+	// where subnormals begin, so that frequencies never decay into them in the first place)...
+	
+	if (flushtozero)
+	{
+#if defined(__SSE__) || defined(_M_X64)
+		_mm_setcsr(_mm_getcsr() | 0x8040);		// FTZ (bit 15) and DAZ (bit 6)
+#else
+		printf("Warning: --ftz is not supported on this processor; only the extinction limit will apply.\n");
+#endif
+		if (extinction == 0) extinction = 1e-30;
+	}
+	
+	if ((extinction > 0 || countsubnormals) && kernelfile)
+	{
+		printf("--ftz, --extinction and --subnormals can't be used with --kernel.\n");
+		exit(1);
+	}
+	
+	if ((precision != SINGLE || compareprecision) && kernelfile)
+	{
+		printf("Kernels loaded with --kernel only work in single precision (float).\n");
+		exit(1);
+	}
+	
+	if ((itermap || stopearly || cycles) && (kernelfile || lazynorm))
+	{
+		printf("--itermap, --converge and --cycles can't be used with --kernel or --lazynorm.\n");
+		exit(1);
+	}
+	
+	if (verify < 0 || (verify && kernelfile) || (verify && verifystatefile))
+	{
+		printf("--verify needs a positive value, and can't be used with --kernel or --verifystate.\n");
+		exit(1);
+	}
+	
+	if (basins && (basins < 0 || onerun == 0 || verify || compareprecision))
+	{
+		printf("--basins needs a positive value and --onerun, and can't be used with --verify or --compareprecision.\n");
+		exit(1);
+	}
+	
+	if (basins && countstarts() > MAXBASINSTARTS)
+	{
+		printf("--basins %d would be %.0f starts (the most is %d); use fewer steps.\n", basins, countstarts(), MAXBASINSTARTS);
+		exit(1);
+	}
+	
+	if (basins && kernelfile == NULL && lazynorm == 0) stopearly = 1;		// Stop each start once it has settled
+	
+	if (trajectoryevery < 0 || trajectorydecade < 0 || (trajectoryevery && trajectorydecade))
+	{
+		printf("--trajectory and --logtrajectory need a positive value, and only one of them can be used.\n");
+		exit(1);
+	}
+	
+	if ((trajectoryevery || trajectorydecade) && (kernelfile || lazynorm || basins || (onerun == 0 && traces == 0)))
+	{
+		printf("--trajectory and --logtrajectory need --onerun or --trace, and can't be used with --kernel, --lazynorm or --basins.\n");
+		exit(1);
+	}
+	
+	for (n = 0; n < traces; n++)
+	{
+		if (onerun || tracex[n] < 0 || tracex[n] >= subdivisions || tracey[n] < 0 || tracey[n] >= subdivisions || (trajectoryevery == 0 && trajectorydecade == 0))
+		{
+			printf("--trace needs a cell of the graph (x and y from 0 to %d), and --trajectory or --logtrajectory.\n", subdivisions - 1);
+			exit(1);
+		}
+	}
+	
+	if (replicates && (replicates < 0 || popsize == 0))
+	{
+		printf("--replicates needs a positive value, and --popsize.\n");
+		exit(1);
+	}
+	
+	if (replicates && (cycles || countsubnormals || basins || bistable || itermap || gnuplot || statefile || verifystatefile
+	 || compareprecision || trajectoryevery || trajectorydecade))
+	{
+		printf("--replicates can't be used with --cycles, --subnormals, --basins, --bistable, --itermap, --gnuplot, --state,\n");
+		printf("--verifystate, --compareprecision, --trajectory or --logtrajectory.\n");
+		exit(1);
+	}
+	
+	if (individuals && (individuals < 0 || onerun == 0 || kernelfile || popsize || basins || verify || compareprecision))
+	{
+		printf("--individuals needs a positive value and --onerun, and can't be used with --kernel, --popsize, --basins,\n");
+		printf("--verify or --compareprecision.\n");
+		exit(1);
+	}
+	
+	if (area && (area < 0 || onerun || replicates || bistable || basins || itermap || gnuplot || statefile || verify || verifystatefile
+	 || compareprecision || lattice || individuals || traces || lazynorm || sensitivity))
+	{
+		printf("--area needs a positive value, and can't be used with --onerun, --replicates, --bistable, --basins, --itermap,\n");
+		printf("--gnuplot, --state, --verify, --verifystate, --compareprecision, --lattice, --individuals, --trace, --lazynorm\n");
+		printf("or --sensitivity.\n");
+		exit(1);
+	}
+	
+	if (sensitivity && (sensitivity < 0 || onerun || replicates || bistable || basins || itermap || gnuplot || statefile || verify || verifystatefile
+	 || compareprecision || lattice || individuals || traces || lazynorm))
+	{
+		printf("--sensitivity needs a positive value, and can't be used with --onerun, --replicates, --bistable, --basins,\n");
+		printf("--itermap, --gnuplot, --state, --verify, --verifystate, --compareprecision, --lattice, --individuals, --trace\n");
+		printf("or --lazynorm.\n");
+		exit(1);
+	}
+	
+	if (varies && area == 0 && sensitivity == 0)
+	{
+		printf("--vary only works with --area or --sensitivity.\n");
+		exit(1);
+	}
+	
+	if (lattice && (lattice < 0 || onerun == 0 || kernelfile || popsize || basins || individuals || lazynorm || verify || compareprecision
+	 || trajectoryevery || trajectorydecade || stopearly || cycles || itermap || gnuplot))
+	{
+		printf("--lattice needs a positive value and --onerun, and can't be used with --kernel, --popsize, --basins,\n");
+		printf("--individuals, --lazynorm, --verify, --compareprecision, --trajectory, --converge, --cycles, --itermap or --gnuplot.\n");
+		exit(1);
+	}
+	
+	if (lattice && (dispersal < 0 || dispersal > 1 || dispersalradius < 0 || dispersalradius > MAXRADIUS || dispersalradius >= lattice || censusevery < 0))
+	{
+		printf("--dispersal should be between 0 and 1, --dispersalradius between 0 and %d (and less than the lattice),\n", MAXRADIUS);
+		printf("and --census positive.\n");
+		exit(1);
+	}
+	
+	if (lattice)
+	{
+		if (patchradius < 0) patchradius = lattice / 16.0;
+		if (censusevery == 0) censusevery = (endpoint >= 10) ? endpoint / 10 : 1;
+	}
+	
+	if (continuation && (onerun == 0 || continuationlow == continuationhigh || kernelfile || popsize || basins || individuals || lattice
+	 || lazynorm || extinction > 0 || verify || compareprecision || trajectoryevery || trajectorydecade))
+	{
+		printf("--continuation needs --onerun and a range of the parameter, and can't be used with --kernel, --popsize,\n");
+		printf("--basins, --individuals, --lattice, --lazynorm, --ftz, --extinction, --verify, --compareprecision or --trajectory.\n");
+		exit(1);
+	}
+	
+	if (jacobian && (onerun == 0 || kernelfile || popsize || replicates || basins || individuals || lattice || continuation))
+	{
+		printf("--jacobian needs --onerun, and can't be used with --kernel, --popsize, --replicates, --basins,\n");
+		printf("--individuals, --lattice or --continuation.\n");
+		exit(1);
+	}
+	
+	if (bistable && onerun)
+	{
+		printf("--bistable only works when drawing a graph.\n");
+		exit(1);
+	}
+	
+	if ((statefile || verifystatefile) && onerun)
+	{
+		printf("--state and --verifystate only work when drawing a graph.\n");
+		exit(1);
+	}
+	
+	if (lazynorm < 0 || (lazynorm && kernelfile))
+	{
+		printf("--lazynorm needs a positive value, and can't be used with --kernel.\n");
+		exit(1);
+	}
+	
+	if (engine == GRID && (kernelfile || lazynorm || cycles || countsubnormals || popsize))
+	{
+		printf("--engine grid can't be used with --kernel, --lazynorm, --cycles, --subnormals or --popsize.\n");
+		exit(1);
+	}
+	
+	if (popsize < 0 || (popsize && (kernelfile || lazynorm || verify || verifystatefile)))
+	{
+		printf("--popsize needs a value from 1 to %G, and can't be used with --kernel, --lazynorm, --verify or --verifystate.\n", MAXPOPSIZE);
+		exit(1);
+	}
+	
+	if (tilesize < 0)
+	{
+		printf("--tile needs a positive value, or auto.\n");
+		exit(1);
+	}
+	
+	if (threads > 0)
+	{
+#ifdef _OPENMP
+		omp_set_num_threads(threads);
+#else
+		if (threads > 1) printf("Warning: compiled without OpenMP, so --threads has no effect.\n");
+#endif
+	}
+	
+	if (kernelfile)
+	{
+		loadkernel();
+	} else {
+		choosespecialisation();
+	}
+	
+	if (benchmarkfile)
+	{
+		benchmark(benchmarkfile);
+		return 0;
+	}
+	
+	if (lattice) subdivisions = lattice;		// The lattice is drawn as a graph would be, one deme per pixel
+	
+	start = seconds();
+	allocateresult(subdivisions);
+	if (replicates)
+	{
+		fixation = malloc(subdivisions * subdivisions * sizeof(double));
+		if (fixation == NULL)
+		{
+			printf("Out of memory!\n");
+			exit(1);
+		}
+	}
+	if (statefile)
+	{
+		states = malloc(subdivisions * subdivisions * ngenotypes * sizeof(double));
+		stateregimes = malloc(subdivisions * subdivisions * sizeof(int));
+		stateperiods = malloc(subdivisions * subdivisions * sizeof(int));
+		if (states == NULL || stateregimes == NULL || stateperiods == NULL)
+		{
+			printf("Out of memory!\n");
+			exit(1);
+		}
+	}
+	if (verifystatefile) loadstates(verifystatefile);
+	phasetime[ALLOCATION] = seconds() - start;
+	
+	verifyname = verifystatefile ? verifystatefile : "the frozen recursion";
+	
+	if (perfcounters) opencounters();
+	
+	// Print all settings...
+	
+	if (kernel_simulate)
+	{
+		printf("\nModel: %s (%s)\n\n", kernel_description, kernelfile);
+	} else {
+		printf("\nModel %d\n\n", MODEL);
+	}
+	
+	if (onerun)
+	{
+		printf("Q = %G (K = %G, pi = %G)\n", Q, (1 / Q) - 1, 1 / Q);
+		printf("F = %G (k = %G, \"omega\" = %G)\n\n", F, (1 / F) - 1, 1 / F);
+	}
+	
+	printf("h = %G\n", h);
+	printf("Selfing rate = %G\n", S);
+	printf("Inbreeding depression = %G\n", d);
+	printf("YY viability = %G (YY penalty = %G)\n", V, 1 - V);
+	if (kernel_simulate)
+	{
+		printf("PSatF = %G\n", PSatF);
+		printf("ppY = %G\n\n", ppY);
+	} else {
+		printf("PSatF = %G\n\n", PSatF);
+		printf("Kernel = built-in, %s\n\n", specialisation);
+	}
+	
+	printf("Iterations = %d\n", endpoint);
+	printf("Precision = %s\n\n", precisionnames[precision]);
+	
+	if (popsize)
+	{
+		printf("Population size = %.0f (Wright-Fisher sampling each generation, seed %llu)\n", popsize, seed);
+		if (replicates) printf("Replicates = %d per cell, each until the %s are lost or fixed\n", replicates, pgd ? "males" : "inconstants");
+		printf("\n");
+	}
+	
+	if (individuals)
+	{
+		printf("Individuals = %lld (each offspring from a drawn mother and father, seed %llu)\n\n", individuals, seed);
+	}
+	
+	if (lattice)
+	{
+		printf("Lattice = %d x %d demes, starting from %s, with a patch of radius %G from %s in the centre\n", lattice, lattice, pgd ? "PGD" : "DIO", patchradius, pgd ? "DIO" : "PGD");
+		printf("Pollen dispersal = %G, over a radius of %d (%s kernel)\n\n", dispersal, dispersalradius, dispersalshape == GAUSSIANKERNEL ? "Gaussian" : "box");
+	}
+	
+	if (continuation)
+	{
+		printf("Continuation of the equilibrium in %s, from %G to %G (pseudo-arclength, in %s)\n\n", continuationnames[continuationwhich],
+			continuationlow, continuationhigh, precisionnames[(precision == LONGDOUBLE) ? LONGDOUBLE : DOUBLE]);
+	}
+	
+	if (bistable)
+	{
+		printf("Starts = %s, and %s for the bistability map\n\n", pgd ? "PGD" : "DIO", pgd ? "DIO" : "PGD");
+	}
+	
+	if (basins)
+	{
+		printf("Starts = %.0f, with genotype frequencies in steps of 1/%d (--basins)\n\n", countstarts(), basins);
+	}
+	
+	if (area)
+	{
+		printf("Area estimate to within +/- %G, from %d randomised Sobol sequences over Q and F", area, AREASHIFTS);
+		for (n = 0; n < varies; n++) printf(", %s (%G to %G)", varynames[varywhich[n]], varylow[n], varyhigh[n]);
+		printf("\n\n");
+	}
+	
+	if (sensitivity)
+	{
+		printf("Sensitivity analysis over Q, F");
+		for (n = 0; n < varies; n++) printf(", %s (%G to %G)", varynames[varywhich[n]], varylow[n], varyhigh[n]);
+		printf(": %d rows of the Saltelli design, %d runs\n\n", sensitivity, sensitivity * (varies + 4));
+	}
+	
+	if (engine == GRID && ((onerun == 0 && area == 0 && sensitivity == 0) || basins))
+	{
+		if (tilesize == 0)
+		{
+			start = seconds();
+			tunetile();
+			phasetime[ALLOCATION] += seconds() - start;
+		}
+		printf("Engine = grid, in tiles of %d cells\n\n", tilesize);
+	}
+	
+	if (itermap || stopearly || cycles)
+	{
+		printf("Convergence tolerance = %G%s\n", tolerance, stopearly ? " (stopping each cell once converged)" : "");
+		printf("Cycle detection = %s\n\n", cycles ? "on" : "off");
+	}
+	
+	if (flushtozero || extinction > 0)
+	{
+		printf("Flush to zero = %s\n", flushtozero ? "on" : "off");
+		printf("Extinction limit = %G\n\n", extinction);
+	}
+	
+	if (onerun == 0 && area == 0 && sensitivity == 0)
+	{
+		printf("Warning: --onerun option not received, therefore program will\n");
+		printf("use %d Q and F combinations and produce a graph. This may\n", subdivisions * subdivisions);
+		printf("take a long time. If this was not your intention, terminate now.\n\n");
+		
+		printf("                       %d |\n", oldformat ? oldformatlimit : 1);
+		printf("Output format:       %s   |\n", oldformat ? "k" : "F");
+		printf("                       0 |\n");
+		printf("                          -----\n");
+		printf("                          0   %d\n", oldformat ? oldformatlimit : 1);
+		printf("                            %s\n\n", oldformat ? "K" : "Q");
+	}
+	
+	// Choose names for .bmp and .txt output files (if needed)...
+	
+	if (kernel_simulate)
+	{
+		sprintf(basename, "%s_start%s_V%G_S%G_d%G_h%G_PSatF%G_ppY%G", kernel_name, pgd ? "PGD" : "DIO", V, S, d, h, PSatF, ppY);
+	} else {
+		sprintf(basename, "model%d_start%s_V%G_S%G_d%G_h%G_PSatF%G_ppY%G", MODEL, pgd ? "PGD" : "DIO", V, S, d, h, PSatF, ppY);
+	}
+	sprintf(bmp_filename, "%s.bmp", basename);
+	sprintf(txt_filename, "%s.txt", basename);
+	sprintf(itermap_filename, "%s_iterations.bmp", basename);
+	sprintf(bistable_filename, "%s_bistable.bmp", basename);
+	sprintf(basins_filename, "%s_Q%G_F%G_basins.txt", basename, Q, F);
+	sprintf(trajectory_filename, "%s_Q%G_F%G_trajectory.bin", basename, Q, F);
+	sprintf(fixation_filename, "%s_N%G_fixation", basename, popsize);
+	sprintf(sensitivity_filename, "%s_sensitivity.txt", basename);
+	sprintf(lattice_filename, "%s_Q%G_F%G_lattice%d.bmp", basename, Q, F, lattice);
+	sprintf(continuation_filename, "%s_Q%G_F%G_continuation_%s.txt", basename, Q, F, continuation ? continuationnames[continuationwhich] : "");
+	sprintf(iterations_filename, "%s_iterations.txt", basename);
+	
+	// Open .txt output file (if needed)...
+	
+	if (onerun == 0 && gnuplot)
+	{
+		textfile = fopen(txt_filename, "w");
+	}
+	
+	if (area)
+	{
+		areasweep();
+	} else if (sensitivity) {
+		sensitivitysweep(sensitivity_filename);
+	} else if (onerun == 0 && replicates) {
+		strcat(fixation_filename, ".txt");
+		replicatesweep(fixation_filename);
+		
+		start = seconds();
+		strcpy(strrchr(fixation_filename, '.'), ".bmp");
+		drawbmp(fixation_filename, 1, fixationcolour);
+		printf("Saved %s\n", fixation_filename);
+		phasetime[BMPOUTPUT] = seconds() - start;
+	} else if (onerun == 0) {
+		sweep(textfile);
+		
+		start = seconds();
+		drawbmp(bmp_filename, 1, regimecolour);
+		printf("Saved %s\n", bmp_filename);
+		
+		if (itermap)
+		{
+			drawbmp(itermap_filename, 1, iterationcolour);
+			printf("Saved %s\n", itermap_filename);
+		}
+		
+		if (bistable)
+		{
+			drawbmp(bistable_filename, 1, bistablecolour);
+			printf("Saved %s\n", bistable_filename);
+		}
+		phasetime[BMPOUTPUT] = seconds() - start;
+		
+		if (itermap)
+		{
+			start = seconds();
+			saveiterations(iterations_filename);
+			phasetime[TEXTOUTPUT] += seconds() - start;
+		}
+		
+		if (statefile)
+		{
+			start = seconds();
+			savestates(statefile);
+			phasetime[TEXTOUTPUT] += seconds() - start;
+		}
+		
+		if (reference_simulate)
+		{
+			printf("\n");
+			printaccuracy(" (every " STRINGIFY(ACCURACYSAMPLE) "th cell)");
+		}
+		
+		if (verify || verifystatefile)
+		{
+			printf("\n");
+			if (verify > 1)
+			{
+				sprintf(basename, " (1 cell in %d)", verify);
+				printverify(basename);
+			} else {
+				printverify("");
+			}
+		}
+		
+		if (countsubnormals)
+		{
+			printf("\nCells where genotype frequencies became subnormal = %d (of %d)\n", subnormalcells, subdivisions * subdivisions);
+		}
+		
+		if (bistable) printbistable();
+		
+		// Run the cells picked by --trace again, recording them (the results are the same as in the
+		// graph, whichever engine drew it)...
+		
+		if (traces)
+		{
+			printf("\n");
+			for (n = 0; n < traces; n++)
+			{
+				cellparameters(tracex[n], tracey[n], &Q, &F);
+				sprintf(trajectory_filename, "%s_x%d_y%d_trajectory.bin", basename, tracex[n], tracey[n]);
+				startrecording(trajectory_filename, Q, F);
+				runcell(f, Q, F, &flags);
+				stoprecording(trajectory_filename);
+			}
+		}
+		
+		if (cycles)
+		{
+			printf("\nCells that ended in a cycle = %d (of %d)", cyclecells, subdivisions * subdivisions);
+			if (cyclecells) printf(", longest period = %d", longestperiod);
+			printf("\n");
+		}
+	} else if (basins) {
+		basinsweep(basins_filename);
+	} else if (lattice) {
+		latticesweep(lattice_filename);
+	} else if (continuation) {
+		continuationsweep(continuation_filename);
+	} else if (individuals) {
+		start = seconds();
+		startcell(f);
+		if (trajectoryevery || trajectorydecade) startrecording(trajectory_filename, Q, F);
+		generations = runindividuals(f, Q, F);
+		if (recording) stoprecording(trajectory_filename);
+		phasetime[RECURSION] = seconds() - start;
+		
+		if (generations < endpoint)
+		{
+			printf("The population died out after %d generations\n\n", generations);
+		}
+		printf("Time per individual per generation = %.3f ns\n\n", 1e9 * phasetime[RECURSION] / ((double) individuals * (generations ? generations : 1)));
+		
+		phenotypesums(f, &female, &male, &inconstant);
+		printf("Females       Males         Inconstants\n");
+		printf("%.6f      %.6f      %.6f\n\n", female, male, inconstant);
+		
+		printf("Genotype frequencies:\n\n");
+		printf("                ");
+		for (n = 0; n < ngenotypes; n++) printf("%-10s", genotypenames[n]);
+		printf("\n  Individuals:  ");
+		for (n = 0; n < ngenotypes; n++) printf("%.6f  ", f[n]);
+		
+		runcell(reference, Q, F, &flags);
+		printf("\n  Recursion:    ");
+		for (n = 0; n < ngenotypes; n++) printf("%.6f  ", reference[n]);
+		printf("\n\n");
+		
+		compared_maxerror = 0;
+		for (n = 0; n < ngenotypes; n++)
+		{
+			if (fabs(f[n] - reference[n]) > compared_maxerror) compared_maxerror = fabs(f[n] - reference[n]);
+		}
+		printf("Largest difference from the recursion = %.6f (sampling one generation gives about %.6f)\n\n", compared_maxerror, 1 / sqrt((double) individuals));
+		
+		printf("Final state: %s", regimenames[classify(female, male, inconstant)]);
+		phenotypesums(reference, &female, &male, &inconstant);
+		printf(" (recursion: %s)\n", regimenames[classify(female, male, inconstant)]);
+	} else if (replicates) {
+		start = seconds();
+		if (perfcounters) startcounters();
+		runreplicates(Q, F, counts, &replicategenerations);
+		if (perfcounters) stopcounters();
+		phasetime[RECURSION] = seconds() - start;
+		
+		printf("Replicates in which the %s were lost = %lld, fixed = %lld, undecided after %d generations = %lld\n",
+			pgd ? "males" : "inconstants", counts[LOST], counts[FIXED], endpoint, counts[0]);
+		printf("Mean generations per replicate = %.1f\n\n", (double) replicategenerations / replicates);
+		wilson(counts[FIXED], replicates, &low, &high);
+		printf("Fixation probability = %.6G (95%% interval %.6G to %.6G)\n", (double) counts[FIXED] / replicates, low, high);
+		wilson(counts[LOST], replicates, &low, &high);
+		printf("Loss probability = %.6G (95%% interval %.6G to %.6G)\n", (double) counts[LOST] / replicates, low, high);
+	} else {
+		start = seconds();
+		if (perfcounters) startcounters();
+		if (trajectoryevery || trajectorydecade) startrecording(trajectory_filename, Q, F);
+		generations = runcell(f, Q, F, &flags);
+		if (recording) stoprecording(trajectory_filename);
+		if (perfcounters) stopcounters();
+		phasetime[RECURSION] = seconds() - start;
+		
+		if (flags & SUBNORMAL) subnormalcells++;
+		phenotypesums(f, &female, &male, &inconstant);
+		
+		if (verify)
+		{
+			regime = frozen_reference(Q, F, frozen);
+			for (n = 0; n < ngenotypes; n++) reference[n] = frozen[n];
+			verifycell(Q, F, f, classify(female, male, inconstant), reference, regime);
+			printverify("");
+		}
+		
+		if (reference_simulate)
+		{
+			startcell(reference);
+			reference_simulate(reference, Q, F, &referenceflags);
+			comparecell(f, reference);
+			printaccuracy("");
+		}
+		
+		if (countsubnormals)
+		{
+			printf("Genotype frequencies became subnormal: %s\n\n", subnormalcells ? "yes" : "no");
+		}
+		
+		if (flags & CYCLE)
+		{
+			printf("Ended in a cycle of period %d, found after %d generations; frequencies are averaged over it\n\n", PERIOD(flags), generations);
+		} else if (PERIOD(flags) == 1) {
+			printf("Reached a fixed point after %d generations\n\n", generations);
+		}
+		
+		if (itermap || stopearly)
+		{
+			if (generations < endpoint)
+			{
+				printf("Converged after %d generations (tolerance %G)\n\n", generations, tolerance);
+			} else {
+				printf("Still changing after %d generations (tolerance %G)\n\n", endpoint, tolerance);
+			}
+		}
+		
+		printf("Females       Males         Inconstants\n");
+		printf("%.6f      %.6f      %.6f\n\n", female, male, inconstant);
+	
+		if (kernel_simulate)
+		{
+			printf("Genotype frequencies:\n\n");
+			
+			printf("      ");
+			for (n = 0; n < ngenotypes; n++) printf("%-10s", genotypenames[n]);
+			printf("\n      ");
+			for (n = 0; n < ngenotypes; n++) printf("%.6f  ", f[n]);
+			printf("\n\n");
+		} else {
+			printf("Genotype frequencies, as notated by E&B (2007), or C&C (2012):\n\n");
+			
+			printf("E&B:  AA MM     AA Mm     AA mm     Aa MM     Aa Mm     Aa mm     aa MM     aa Mm     aa mm\n");
+			printf("C&C:  mm AA     mm Aa     mm aa     Mm AA     Mm Aa     Mm aa     MM AA     MM Aa     MM aa\n");
+			printf("      %.6f  %.6f  %.6f  %.6f  %.6f  %.6f  %.6f  %.6f  %.6f\n\n", f[0], f[1], f[2], f[3], f[4], f[5], f[6], f[7], f[8]);
+		}
+		
+		printf("Final state: %s\n", regimenames[classify(female, male, inconstant)]);
+		
+		if (jacobian) printjacobian(f);
+	}
+	
+	if (timing)
+	{
+		printf("\n");
+		printtiming();
+		if (timingfile) savetiming(timingfile);
+	}
+	
+	if (verify_mismatches) return 1;
+	
+	return 0;
+}
+
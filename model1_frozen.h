@@ -0,0 +1,321 @@
+/*
+
+A frozen copy of the recursion in Model 1, exactly as it was in the main loop of the original
+deterministic_model1.c, for --verify. Do not change or "improve" this file: it is the standard that
+faster versions of the recursion (and builds with different compiler options) are checked against.
+
+The only changes from the original are that it has been moved into a function, which runs one
+combination of Q and F and returns the regime (which used to be written to result[x][y]), and that
+the final genotype frequencies are passed back in f[].
+
+*/
+
+
+// Keep the compiler's optimisations from changing the arithmetic here, even if the rest of the
+// program is being built with something like -ffast-math (GCC only). GCC, in its default GNU mode, also
+// fuses multiplies and adds into FMA instructions whenever the target has them (e.g. -march=native),
+// which rounds differently, so that is turned off too. The processor's own flush-to-zero and
+// denormals-are-zero modes are dealt with by frozen_reference(), below.
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize ("no-fast-math", "fp-contract=off")
+#endif
+
+int frozen_runcell (float Q, float F, float * f)
+{
+	// Plant frequencies... (zeroed here just to suppress a -Wall warning)
+	float f_AA = 0;				// AA
+	float f_Aa = 0;				// Aa
+	float f_Aas = 0;			// Aa*
+	float f_aa = 0;				// aa
+	float f_aas = 0;			// aa*
+	float f_asas = 0;			// a*a*
+	
+	float next_f_AA;
+	float next_f_Aa;
+	float next_f_Aas;
+	float next_f_aa;
+	float next_f_aas;
+	float next_f_asas;
+	
+	// Pollen frequencies...
+	float p_A;					// A
+	float p_a;					// a
+	float p_as;					// a*
+	
+	// Egg frequencies...
+	float e_A;					// A
+	float e_a;					// a
+	float e_as;					// a*
+	
+	float male = 0;
+	float female = 0;
+	float inconstant = 0;
+	
+	float PSatC;				// Pollen saturation point for cosex receivers
+	
+	float totalpollen;
+	float totalplants;
+	int n;
+	int regime;
+	
+	// Set start plant frequencies...
+	
+	if (pgd == 0)				// Start with DIOECY, try inconstant invasion
+	{
+		f_AA = 0.499;
+		f_Aa = 0.499;
+		f_Aas = 0.002;
+		f_aa = 0;
+		f_aas = 0;
+		f_asas = 0;
+	} else {					// Start with PSEUDO-GYNODIOECY, try male invasion
+		f_AA = 0.499;
+		f_Aa = 0.002;
+		f_Aas = 0.499;
+		f_aa = 0;
+		f_aas = 0;
+		f_asas = 0;
+	}
+	
+	for (n = 0; n < endpoint; n++)
+	{
+		// Outcrossed pollen frequencies....................................................
+		//
+		// Here we sum up the 3 types of pollen (containing the 3 alleles) from the various
+		// possible sources. We could do this in 3 equations (as in the paper) but it's simpler
+		// to consider each source in turn and add to the totals.
+		
+		p_A = 0;
+		p_a = 0;
+		p_as = 0;
+		
+		// From AA pure females (genotype 1)
+		;
+		
+		// From Aa pure males (genotype 2)
+		p_A += f_Aa * 0.5;
+		p_a += f_Aa * 0.5;
+		
+		// From Aa* inconstants (genotype 3) as cosexes
+		p_A += f_Aas * 0.5 * h * Q;
+		p_as += f_Aas * 0.5 * h * Q;
+		
+		// From Aa* inconstants (genotype 3) as males
+		p_A += f_Aas * 0.5 * (1 - h);
+		p_as += f_Aas * 0.5 * (1 - h);
+		
+		// From aa pure males (genotype 4)
+		p_a += f_aa;
+		
+		// From aa* inconstants (genotype 5) as cosexes
+		p_a += f_aas * 0.5 * h * Q;
+		p_as += f_aas * 0.5 * h * Q;
+		
+		// From aa* inconstants (genotype 5) as males
+		p_a += f_aas * 0.5 * (1 - h);
+		p_as += f_aas * 0.5 * (1 - h);
+		
+		// From a*a* inconstants (genotype 6) as cosexes
+		p_as += f_asas * h * Q;
+		
+		// From a*a* inconstants (genotype 6) as males
+		p_as += f_asas * (1 - h);
+		
+		// Apply Y pollen viability penalty.................................................
+		
+		p_a *= ppY;
+		p_as *= ppY;
+		
+		// Normalise pollen frequencies to add up to 1......................................
+		
+		totalpollen = p_A + p_a + p_as;
+		if (totalpollen > 0)
+		{
+			p_A /= totalpollen;
+			p_a /= totalpollen;
+			p_as /= totalpollen;
+		}
+		
+		// Outcrossed egg frequencies.......................................................
+		
+		// Calculate pollen required to fertilise a cosex's outcrossing ovules:
+		PSatC = PSatF * F * (1 - S);
+		
+		e_A = 0;
+		e_a = 0;
+		e_as = 0;
+		
+		// From AA pure females (genotype 1)
+		if (totalpollen >= PSatF)
+		{
+			e_A += f_AA;
+		} else {
+			e_A += f_AA * totalpollen / PSatF;
+		}
+		
+		// From Aa pure males (genotype 2)
+		;
+		
+		// From Aa* inconstants (genotype 3) as cosexes
+		if (totalpollen >= PSatC)
+		{
+			e_A += f_Aas * h * 0.5 * (1 - S) * F;
+			e_as +=	f_Aas * h * 0.5 * (1 - S) * F;
+		} else {
+			e_A += f_Aas * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+			e_as +=	f_Aas * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+		}
+		
+		// From aa pure males (genotype 4)
+		;
+		
+		// From aa* inconstants (genotype 5) as cosexes
+		if (totalpollen >= PSatC)
+		{
+			e_a += f_aas * h * 0.5 * (1 - S) * F;
+			e_as += f_aas * h * 0.5 * (1 - S) * F;
+		} else {
+			e_a += f_aas * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+			e_as += f_aas * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+		}
+		
+		// From a*a* inconstants (genotype 6) as cosexes
+		if (totalpollen >= PSatC)
+		{
+			e_as += f_asas * h * (1 - S) * F;
+		} else {
+			e_as += f_asas * h * (1 - S) * F * totalpollen / PSatC;
+		}
+		
+		// WE CANNOT AND MUST NOT NORMALISE THE EGG FREQUENCIES, AS WE HAVEN'T
+		// YET CONSIDERED THE SELFED EGGS. BUT WE DON'T NEED TO NORMALISE.
+		
+		// Plant frequencies from outcrossing...............................................
+		
+		next_f_AA = p_A * e_A;
+		next_f_Aa = p_A * e_a + p_a * e_A;
+		next_f_Aas = p_A * e_as + p_as * e_A;
+		next_f_aa = p_a * e_a;
+		next_f_aas = p_a * e_as + p_as * e_a;
+		next_f_asas = p_as * e_as;
+		
+		// Additional plants from selfing...................................................
+		
+		// From AA pure females (genotype 1)
+		;
+		
+		// From Aa pure males (genotype 2)
+		;
+		
+		// From Aa* inconstants (genotype 3)
+		next_f_AA += f_Aas * (0.5 / (1 + ppY)) * S * (1 - d) * h * F;
+		next_f_Aas += f_Aas * 0.5 * S * (1 - d) * h * F;
+		next_f_asas += f_Aas * (0.5 * ppY / (1 + ppY)) * S * (1 - d) * h * F;
+		
+		// Aa* is the only genotype where there is competition between X and Y pollen
+		// during selfing and where the ppY factor therefore is relevant...
+		
+		// Old versions without ppY:
+		// next_f_AA += f_Aas * 0.25 * S * (1 - d) * h * F;
+		// next_f_Aas += f_Aas * 0.5 * S * (1 - d) * h * F;
+		// next_f_asas += f_Aas * 0.25 * S * (1 - d) * h * F;
+		
+		// From aa pure males (genotype 4)
+		;
+		
+		// From aa* inconstants (genotype 5)
+		next_f_aa += f_aas * 0.25 * S * (1 - d) * h * F;
+		next_f_aas += f_aas * 0.5 * S * (1 - d) * h * F;
+		next_f_asas += f_aas * 0.25 * S * (1 - d) * h * F;
+		
+		// From a*a* inconstants (genotype 6)
+		next_f_asas += f_asas * S * (1 - d) * h * F;
+		
+		// Apply YY penalty.................................................................
+		
+		next_f_aa *= V;
+		next_f_aas *= V;
+		next_f_asas *= V;
+
+		// Copy.............................................................................
+		
+		f_AA = next_f_AA;
+		f_Aa = next_f_Aa;
+		f_Aas = next_f_Aas;
+		f_aa = next_f_aa;
+		f_aas = next_f_aas;
+		f_asas = next_f_asas;
+			
+		// Normalise plant frequencies to add up to 1.......................................
+	
+		totalplants = f_AA + f_Aa + f_Aas + f_aa + f_aas + f_asas;
+		if (totalplants > 0)
+		{
+			f_AA /= totalplants;
+			f_Aa /= totalplants;
+			f_Aas /= totalplants;
+			f_aa /= totalplants;
+			f_aas /= totalplants;
+			f_asas /= totalplants;
+		}
+	}
+	
+	// Calculate and save results...
+	
+	female = f_AA;
+	male = f_Aa + f_aa;
+	inconstant = f_Aas + f_aas + f_asas;
+	
+	if (male > threshold && female > threshold && inconstant > threshold)
+	{
+		regime = SSD;
+	} else if (male > threshold && female > threshold) {
+		regime = DIO;
+	} else if (female > threshold && inconstant > threshold) {
+		regime = PGD;
+	} else if (male > threshold && inconstant > threshold) {
+		regime = PAD;
+	} else if (inconstant > threshold) {
+		regime = INC;
+	} else {
+		regime = 0;
+	}
+	
+	f[0] = f_AA;
+	f[1] = f_Aa;
+	f[2] = f_Aas;
+	f[3] = f_aa;
+	f[4] = f_aas;
+	f[5] = f_asas;
+	
+	return regime;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+
+// Run frozen_runcell() with the processor's flush-to-zero (FTZ) and denormals-are-zero (DAZ) modes
+// off, as they were in the original program. They may have been turned on for the whole process,
+// either by --ftz or, without anything being said, by linking with -ffast-math (which brings in
+// crtfastmath.o). The modes belong to the thread, and are put back as they were afterwards.
+
+int frozen_reference (float Q, float F, float * f)
+{
+	int regime;
+	
+#if defined(__SSE__) || defined(_M_X64)
+	unsigned int csr = _mm_getcsr();
+	
+	_mm_setcsr(csr & ~0x8040);
+	regime = frozen_runcell(Q, F, f);
+	_mm_setcsr(csr);
+#else
+	regime = frozen_runcell(Q, F, f);
+#endif
+	
+	return regime;
+}
@@ -0,0 +1,1557 @@
+/*
+
+The built-in recursion for Model 1, for deterministic_model1.c.
+
+This file is included by deterministic_model1.c once for each floating point type. Before each
+inclusion, real is defined as the type, REAL_MIN as its smallest normal value, REAL_EPSILON as its
+machine epsilon, wide as the type that arithmetic between a real and a double constant is done in
+(double, unless real is long double), and KERNEL(name) as the name to give each function (e.g.
+KERNEL(simulate_generic) becomes simulate_generic_double). Parameters are always single precision, as
+given on the command line; genotype frequencies are passed in and out as doubles, but all the working
+is done in the chosen type.
+
+It is included once more with real defined as double complex and DERIVATIVES defined, for the
+derivatives of one generation (see KERNEL(generationjacobian) below, which is generationjacobian_dual()).
+Only the grid engine's generation is compiled then; its parameters are of type param (float, except in
+that instantiation), and each comparison is of VALUE(x), the real part.
+
+*/
+
+#ifdef DERIVATIVES
+#define param real
+#define shared const real *
+#define SHARED(x) ((x)[i])
+#define VALUE(x) creal(x)
+#define ABSORBING 0			// The absorbing state (and the extinction limit) would set the derivatives to 0
+#else
+#define param float
+#define shared float
+#define SHARED(x) (x)
+#define VALUE(x) (x)
+#define ABSORBING absorbing
+#endif
+
+#ifndef DERIVATIVES
+
+// Zero a genotype frequency that has fallen below the extinction limit, and note if it's subnormal
+// (which on most processors makes every sum involving it very slow).
+
+static ALWAYS_INLINE void KERNEL(guardfrequency) (real * frequency, real limit, int * flags)
+{
+	if (*frequency < limit) *frequency = 0;
+	if (*frequency > 0 && *frequency < REAL_MIN) *flags |= SUBNORMAL;
+}
+
+// Has a genotype frequency changed by more than the convergence tolerance in the last generation?
+// (Written without fabs(), which would lose anything too small for a double.)
+
+static ALWAYS_INLINE int KERNEL(moved) (real now, real before)
+{
+	return (now - before > tolerance || before - now > tolerance);
+}
+
+// Is a genotype frequency back within a given distance of a saved one? (For the cycle check.)
+
+static ALWAYS_INLINE int KERNEL(near) (real now, real before, real within)
+{
+	return (now - before <= within && before - now <= within);
+}
+
+// Run the built-in recursion for one combination of Q and F. On entry, f[] holds the start
+// frequencies of the 6 genotypes (in E&B order); on exit, it holds them after endpoint iterations.
+// Returns the number of generations until the frequencies converged (i.e. after which none
+// changed by more than the tolerance), or endpoint if they never did, or if --itermap and
+// --converge are both off (in which case this isn't checked). With --cycles, it stops at the
+// first repeated state instead, and a cycle is reported in flags (see CYCLE).
+//
+// This is only ever called by the simulate_...() functions below, which pass constants for the
+// parameters (and the limited and selfing flags) that are degenerate in the most common runs, so
+// that the compiler produces a separate copy with the unused terms removed (when optimising).
+
+static ALWAYS_INLINE int KERNEL(simulate_body) (double * f, float Q, float F, int * flags, float h, float S, float d, float V, float PSatF, float ppY, const int limited, const int selfing)
+{
+	// Plant frequencies...
+	real f_AA = f[0];			// AA
+	real f_Aa = f[1];			// Aa
+	real f_Aas = f[2];			// Aa*
+	real f_aa = f[3];			// aa
+	real f_aas = f[4];			// aa*
+	real f_asas = f[5];		// a*a*
+	
+	real next_f_AA;
+	real next_f_Aa;
+	real next_f_Aas;
+	real next_f_aa;
+	real next_f_aas;
+	real next_f_asas;
+	
+	// Pollen frequencies...
+	real p_A;					// A
+	real p_a;					// a
+	real p_as;					// a*
+	
+	// Egg frequencies...
+	real e_A;					// A
+	real e_a;					// a
+	real e_as;					// a*
+	
+	real PSatC;				// Pollen saturation point for cosex receivers
+	
+	real totalpollen;
+	real totalplants;
+	
+	// Frequencies before this generation, for the convergence check...
+	real last_f_AA;
+	real last_f_Aa;
+	real last_f_Aas;
+	real last_f_aa;
+	real last_f_aas;
+	real last_f_asas;
+	
+	// For cycle detection (Brent's algorithm): a saved state to compare with, and the sums
+	// over one turn of the cycle, once found...
+	real tortoise_f_AA = f[0];
+	real tortoise_f_Aa = f[1];
+	real tortoise_f_Aas = f[2];
+	real tortoise_f_aa = f[3];
+	real tortoise_f_aas = f[4];
+	real tortoise_f_asas = f[5];
+	real sum_f_AA = 0;
+	real sum_f_Aa = 0;
+	real sum_f_Aas = 0;
+	real sum_f_aa = 0;
+	real sum_f_aas = 0;
+	real sum_f_asas = 0;
+	int power = 1;
+	int lambda = 0;
+	int period = 0;
+	int averaging = 0;
+	int swung = 0;
+	int stopped = 0;
+	
+	int n;
+	int converged = 0;
+	
+	const int guarded = (extinction > 0 || countsubnormals);
+	const int tracked = (itermap || stopearly);
+	const int cycling = cycles;
+	
+	// A state counts as a repeat if no frequency is further than this from the saved one. With a
+	// tolerance of 0, that's a few units in the last place, as otherwise rounding that flips the
+	// last bit back and forth around a fixed point would be taken for a cycle...
+	const real repeat = tolerance > 0 ? tolerance : REPEATULPS * REAL_EPSILON;
+	
+	// For --trajectory: the next generation to record, if this run is being recorded (-1 if not)...
+	double snapshot[NGENOTYPES];
+	int record = recording ? 0 : -1;
+	
+	// For --popsize: this run's random number stream...
+	const int drifting = (popsize > 0);
+	struct rngstream stream;
+	
+	if (drifting) startstream(&stream, Q, F, f);
+	
+	for (n = 0; n < endpoint; n++)
+	{
+		// Record this generation's frequencies, if it's one that --trajectory wants.......
+		
+		if (n == record)
+		{
+			snapshot[0] = f_AA;
+			snapshot[1] = f_Aa;
+			snapshot[2] = f_Aas;
+			snapshot[3] = f_aa;
+			snapshot[4] = f_aas;
+			snapshot[5] = f_asas;
+			record = recordstate(n, snapshot);
+		}
+		
+		// Outcrossed pollen frequencies....................................................
+		//
+		// Here we sum up the 3 types of pollen (containing the 3 alleles) from the various
+		// possible sources. We could do this in 3 equations (as in the paper) but it's simpler
+		// to consider each source in turn and add to the totals.
+		
+		p_A = 0;
+		p_a = 0;
+		p_as = 0;
+		
+		// From AA pure females (genotype 1)
+		;
+		
+		// From Aa pure males (genotype 2)
+		p_A += f_Aa * 0.5;
+		p_a += f_Aa * 0.5;
+		
+		// From Aa* inconstants (genotype 3) as cosexes
+		p_A += f_Aas * 0.5 * h * Q;
+		p_as += f_Aas * 0.5 * h * Q;
+		
+		// From Aa* inconstants (genotype 3) as males
+		p_A += f_Aas * 0.5 * (1 - h);
+		p_as += f_Aas * 0.5 * (1 - h);
+		
+		// From aa pure males (genotype 4)
+		p_a += f_aa;
+		
+		// From aa* inconstants (genotype 5) as cosexes
+		p_a += f_aas * 0.5 * h * Q;
+		p_as += f_aas * 0.5 * h * Q;
+		
+		// From aa* inconstants (genotype 5) as males
+		p_a += f_aas * 0.5 * (1 - h);
+		p_as += f_aas * 0.5 * (1 - h);
+		
+		// From a*a* inconstants (genotype 6) as cosexes
+		p_as += f_asas * h * Q;
+		
+		// From a*a* inconstants (genotype 6) as males
+		p_as += f_asas * (1 - h);
+		
+		// Apply Y pollen viability penalty.................................................
+		
+		p_a *= ppY;
+		p_as *= ppY;
+		
+		// Normalise pollen frequencies to add up to 1......................................
+		
+		totalpollen = p_A + p_a + p_as;
+		if (totalpollen > 0)
+		{
+			p_A /= totalpollen;
+			p_a /= totalpollen;
+			p_as /= totalpollen;
+		}
+		
+		// Outcrossed egg frequencies.......................................................
+		
+		// Calculate pollen required to fertilise a cosex's outcrossing ovules:
+		PSatC = PSatF * F * (1 - S);
+		
+		e_A = 0;
+		e_a = 0;
+		e_as = 0;
+		
+		// From AA pure females (genotype 1)
+		if (limited == 0 || totalpollen >= PSatF)
+		{
+			e_A += f_AA;
+		} else {
+			e_A += f_AA * totalpollen / PSatF;
+		}
+		
+		// From Aa pure males (genotype 2)
+		;
+		
+		// From Aa* inconstants (genotype 3) as cosexes
+		if (limited == 0 || totalpollen >= PSatC)
+		{
+			e_A += f_Aas * h * 0.5 * (1 - S) * F;
+			e_as +=	f_Aas * h * 0.5 * (1 - S) * F;
+		} else {
+			e_A += f_Aas * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+			e_as +=	f_Aas * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+		}
+		
+		// From aa pure males (genotype 4)
+		;
+		
+		// From aa* inconstants (genotype 5) as cosexes
+		if (limited == 0 || totalpollen >= PSatC)
+		{
+			e_a += f_aas * h * 0.5 * (1 - S) * F;
+			e_as += f_aas * h * 0.5 * (1 - S) * F;
+		} else {
+			e_a += f_aas * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+			e_as += f_aas * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+		}
+		
+		// From a*a* inconstants (genotype 6) as cosexes
+		if (limited == 0 || totalpollen >= PSatC)
+		{
+			e_as += f_asas * h * (1 - S) * F;
+		} else {
+			e_as += f_asas * h * (1 - S) * F * totalpollen / PSatC;
+		}
+		
+		// WE CANNOT AND MUST NOT NORMALISE THE EGG FREQUENCIES, AS WE HAVEN'T
+		// YET CONSIDERED THE SELFED EGGS. BUT WE DON'T NEED TO NORMALISE.
+		
+		// Plant frequencies from outcrossing...............................................
+		
+		next_f_AA = p_A * e_A;
+		next_f_Aa = p_A * e_a + p_a * e_A;
+		next_f_Aas = p_A * e_as + p_as * e_A;
+		next_f_aa = p_a * e_a;
+		next_f_aas = p_a * e_as + p_as * e_a;
+		next_f_asas = p_as * e_as;
+		
+		// Additional plants from selfing...................................................
+		
+		if (selfing)
+		{
+			// From AA pure females (genotype 1)
+			;
+			
+			// From Aa pure males (genotype 2)
+			;
+			
+			// From Aa* inconstants (genotype 3)
+			next_f_AA += f_Aas * (0.5 / (1 + ppY)) * S * (1 - d) * h * F;
+			next_f_Aas += f_Aas * 0.5 * S * (1 - d) * h * F;
+			next_f_asas += f_Aas * (0.5 * ppY / (1 + ppY)) * S * (1 - d) * h * F;
+			
+			// Aa* is the only genotype where there is competition between X and Y pollen
+			// during selfing and where the ppY factor therefore is relevant...
+			
+			// Old versions without ppY:
+			// next_f_AA += f_Aas * 0.25 * S * (1 - d) * h * F;
+			// next_f_Aas += f_Aas * 0.5 * S * (1 - d) * h * F;
+			// next_f_asas += f_Aas * 0.25 * S * (1 - d) * h * F;
+			
+			// From aa pure males (genotype 4)
+			;
+			
+			// From aa* inconstants (genotype 5)
+			next_f_aa += f_aas * 0.25 * S * (1 - d) * h * F;
+			next_f_aas += f_aas * 0.5 * S * (1 - d) * h * F;
+			next_f_asas += f_aas * 0.25 * S * (1 - d) * h * F;
+			
+			// From a*a* inconstants (genotype 6)
+			next_f_asas += f_asas * S * (1 - d) * h * F;
+		}
+		
+		// Apply YY penalty.................................................................
+		
+		next_f_aa *= V;
+		next_f_aas *= V;
+		next_f_asas *= V;
+
+		last_f_AA = f_AA;
+		last_f_Aa = f_Aa;
+		last_f_Aas = f_Aas;
+		last_f_aa = f_aa;
+		last_f_aas = f_aas;
+		last_f_asas = f_asas;
+		
+		// Copy.............................................................................
+		
+		f_AA = next_f_AA;
+		f_Aa = next_f_Aa;
+		f_Aas = next_f_Aas;
+		f_aa = next_f_aa;
+		f_aas = next_f_aas;
+		f_asas = next_f_asas;
+			
+		// Normalise plant frequencies to add up to 1.......................................
+	
+		totalplants = f_AA + f_Aa + f_Aas + f_aa + f_aas + f_asas;
+		if (totalplants > 0)
+		{
+			f_AA /= totalplants;
+			f_Aa /= totalplants;
+			f_Aas /= totalplants;
+			f_aa /= totalplants;
+			f_aas /= totalplants;
+			f_asas /= totalplants;
+		}
+		
+		// Extinction clamp and check for subnormals, if wanted......................................
+		
+		if (guarded)
+		{
+			KERNEL(guardfrequency)(&f_AA, extinction, flags);
+			KERNEL(guardfrequency)(&f_Aa, extinction, flags);
+			KERNEL(guardfrequency)(&f_Aas, extinction, flags);
+			KERNEL(guardfrequency)(&f_aa, extinction, flags);
+			KERNEL(guardfrequency)(&f_aas, extinction, flags);
+			KERNEL(guardfrequency)(&f_asas, extinction, flags);
+		}
+		
+		// Genetic drift, with --popsize: the frequencies just worked out are only the expected ones,
+		// and the plants of the next generation are a sample of popsize from them..................
+		
+		if (drifting)
+		{
+			snapshot[0] = f_AA;
+			snapshot[1] = f_Aa;
+			snapshot[2] = f_Aas;
+			snapshot[3] = f_aa;
+			snapshot[4] = f_aas;
+			snapshot[5] = f_asas;
+			drawgeneration(snapshot, &stream);
+			f_AA = snapshot[0];
+			f_Aa = snapshot[1];
+			f_Aas = snapshot[2];
+			f_aa = snapshot[3];
+			f_aas = snapshot[4];
+			f_asas = snapshot[5];
+		}
+		
+		// Absorbing state: once the inconstants have gone (exactly, e.g. through --extinction), this
+		// is an ordinary dioecious population, which within two generations reaches AA : Aa = 1 : ppY
+		// (aa having no mothers), and stays there. So go straight there (as long as there are females
+		// and Aa males; without Aa males, there would be no females in the next generation)...
+		
+		if (absorbing && f_Aas == 0 && f_aas == 0 && f_asas == 0 && f_AA > 0 && f_Aa > 0 && ppY > 0)
+		{
+			f_AA = 1 / (1 + ppY);
+			f_Aa = ppY / (1 + ppY);
+			f_aa = 0;
+			stopped = n + 1;
+			break;
+		}
+		
+		// Convergence check, if wanted: note the last generation in which anything moved, and
+		// (for --converge) stop at the first in which nothing did.........................
+		
+		if (tracked)
+		{
+			if (KERNEL(moved)(f_AA, last_f_AA)
+			 || KERNEL(moved)(f_Aa, last_f_Aa)
+			 || KERNEL(moved)(f_Aas, last_f_Aas)
+			 || KERNEL(moved)(f_aa, last_f_aa)
+			 || KERNEL(moved)(f_aas, last_f_aas)
+			 || KERNEL(moved)(f_asas, last_f_asas))
+			{
+				converged = n + 1;
+			} else if (stopearly) {
+				break;
+			}
+		}
+		
+		// Cycle detection, if wanted (Brent's algorithm). Once a cycle has been found, the
+		// frequencies are averaged over one more turn of it, and the average is the result (it's only
+		// reported as a cycle if some state in that turn strays further than repeat from the saved one)...
+		
+		if (cycling)
+		{
+			if (period)
+			{
+				sum_f_AA += f_AA;
+				sum_f_Aa += f_Aa;
+				sum_f_Aas += f_Aas;
+				sum_f_aa += f_aa;
+				sum_f_aas += f_aas;
+				sum_f_asas += f_asas;
+				if (!swung
+				 && !(KERNEL(near)(f_AA, tortoise_f_AA, repeat)
+				 && KERNEL(near)(f_Aa, tortoise_f_Aa, repeat)
+				 && KERNEL(near)(f_Aas, tortoise_f_Aas, repeat)
+				 && KERNEL(near)(f_aa, tortoise_f_aa, repeat)
+				 && KERNEL(near)(f_aas, tortoise_f_aas, repeat)
+				 && KERNEL(near)(f_asas, tortoise_f_asas, repeat)))
+				{
+					swung = 1;
+				}
+				if (--averaging == 0) break;
+			} else {
+				lambda++;
+				if (KERNEL(near)(f_AA, tortoise_f_AA, repeat)
+				 && KERNEL(near)(f_Aa, tortoise_f_Aa, repeat)
+				 && KERNEL(near)(f_Aas, tortoise_f_Aas, repeat)
+				 && KERNEL(near)(f_aa, tortoise_f_aa, repeat)
+				 && KERNEL(near)(f_aas, tortoise_f_aas, repeat)
+				 && KERNEL(near)(f_asas, tortoise_f_asas, repeat))
+				{
+					period = lambda;
+					stopped = n + 1;
+					if (period == 1) break;		// A fixed point
+					averaging = period;
+				} else if (lambda == power) {
+					tortoise_f_AA = f_AA;
+					tortoise_f_Aa = f_Aa;
+					tortoise_f_Aas = f_Aas;
+					tortoise_f_aa = f_aa;
+					tortoise_f_aas = f_aas;
+					tortoise_f_asas = f_asas;
+					power *= 2;
+					lambda = 0;
+				}
+			}
+		}
+	}
+	
+	if (period > 1 && averaging == 0)
+	{
+		f_AA = sum_f_AA / period;
+		f_Aa = sum_f_Aa / period;
+		f_Aas = sum_f_Aas / period;
+		f_aa = sum_f_aa / period;
+		f_aas = sum_f_aas / period;
+		f_asas = sum_f_asas / period;
+		if (swung) *flags |= CYCLE | (period << PERIODSHIFT);
+		else *flags |= (1 << PERIODSHIFT);		// Never strayed further than repeat, so really a fixed point
+	} else if (period == 1) {
+		*flags |= (1 << PERIODSHIFT);		// A fixed point
+	}
+	
+	f[0] = f_AA;
+	f[1] = f_Aa;
+	f[2] = f_Aas;
+	f[3] = f_aa;
+	f[4] = f_aas;
+	f[5] = f_asas;
+	
+	// ...and the final frequencies (after the generation in which it stopped, if it stopped early)
+	
+	if (record >= 0) recordstate(n < endpoint ? n + 1 : n, f);
+	
+	return stopped ? stopped : (tracked ? converged : endpoint);
+}
+
+// A rearrangement of the recursion for --lazynorm. The divisions are replaced by a single reciprocal
+// per generation, coefficients that don't change are worked out once, and the plant frequencies are
+// only renormalised every lazynorm generations. This is allowed because the update is homogeneous
+// in the plant frequencies; the only places where their absolute scale matters are the PSatF and
+// PSatC comparisons, which here are made against pollen per plant. The results agree with the
+// exact recursion to within rounding error, which is measured and reported (see comparecell() in the main program).
+
+int KERNEL(simulate_lazy) (double * f, float Q, float F, int * flags)
+{
+	// Plant frequencies (not necessarily adding up to 1)...
+	real f_AA = f[0];			// AA
+	real f_Aa = f[1];			// Aa
+	real f_Aas = f[2];			// Aa*
+	real f_aa = f[3];			// aa
+	real f_aas = f[4];			// aa*
+	real f_asas = f[5];		// a*a*
+	
+	real next_f_AA;
+	real next_f_Aa;
+	real next_f_Aas;
+	real next_f_aa;
+	real next_f_aas;
+	real next_f_asas;
+	
+	// Pollen and egg production (not normalised)...
+	real p_A;
+	real p_a;
+	real p_as;
+	real e_A;
+	real e_a;
+	real e_as;
+	
+	real astar;				// Copies of a* among inconstants (counting a*a* twice)
+	real limitF;				// Proportion of a female's ovules that are fertilised
+	real limitC;				// Proportion of a cosex's outcrossing ovules that are fertilised
+	real reciprocal;
+	real totalpollen;
+	real totalplants;
+	real ratio;
+	int countdown = lazynorm;
+	int stopped = 0;
+	int n;
+	
+	const int guarded = (extinction > 0 || countsubnormals);
+	
+	// Per-allele contributions, which don't change from one generation to the next...
+	
+	real inconstantpollen = 0.5 * h * Q + 0.5 * (1 - h);				// Pollen, as cosex and as male
+	real inconstanteggs = h * 0.5 * (1 - S) * F;						// Outcrossed eggs, as cosex
+	real selfed = S * (1 - d) * h * F;									// Selfed offspring
+	real PSatC = PSatF * F * (1 - S);
+	real PSatratio = (PSatC > 0) ? PSatF / PSatC : 0;
+	
+	totalplants = f_AA + f_Aa + f_Aas + f_aa + f_aas + f_asas;
+	
+	for (n = 0; n < endpoint; n++)
+	{
+		// Outcrossed pollen, including the Y pollen viability penalty...
+		
+		astar = f_Aas + f_aas + 2 * f_asas;
+		
+		p_A = f_Aa * 0.5 + f_Aas * inconstantpollen;
+		p_a = (f_Aa * 0.5 + f_aa + f_aas * inconstantpollen) * ppY;
+		p_as = astar * inconstantpollen * ppY;
+		
+		totalpollen = p_A + p_a + p_as;
+		
+		// Pollen limitation. One reciprocal gives both 1 / totalpollen (to normalise the pollen) and
+		// pollen per plant, relative to PSatF...
+		
+		limitF = 1;
+		limitC = 1;
+		reciprocal = 1;
+		
+		if (PSatF > 0 && totalpollen > 0)
+		{
+			reciprocal = 1 / (totalpollen * PSatF * totalplants);
+			ratio = totalpollen * totalpollen * reciprocal;
+			reciprocal *= PSatF * totalplants;
+			
+			if (ratio < 1) limitF = ratio;
+			if (PSatC > 0 && ratio * PSatratio < 1) limitC = ratio * PSatratio;
+		} else if (totalpollen > 0) {
+			reciprocal = 1 / totalpollen;
+		} else if (PSatF > 0) {
+			limitF = 0;
+			if (PSatC > 0) limitC = 0;
+		}
+		
+		// Outcrossed eggs, with the pollen normalisation folded in...
+		
+		limitF *= reciprocal;
+		limitC *= inconstanteggs * reciprocal;
+		
+		e_A = f_AA * limitF + f_Aas * limitC;
+		e_a = f_aas * limitC;
+		e_as = astar * limitC;
+		
+		// Plant frequencies from outcrossing and selfing, and the YY penalty...
+		
+		next_f_AA = p_A * e_A + f_Aas * selfed * (0.5 / (1 + ppY));
+		next_f_Aa = p_A * e_a + p_a * e_A;
+		next_f_Aas = p_A * e_as + p_as * e_A + f_Aas * selfed * 0.5;
+		next_f_aa = (p_a * e_a + f_aas * selfed * 0.25) * V;
+		next_f_aas = (p_a * e_as + p_as * e_a + f_aas * selfed * 0.5) * V;
+		next_f_asas = (p_as * e_as + f_Aas * selfed * (0.5 * ppY / (1 + ppY)) + f_aas * selfed * 0.25 + f_asas * selfed) * V;
+		
+		f_AA = next_f_AA;
+		f_Aa = next_f_Aa;
+		f_Aas = next_f_Aas;
+		f_aa = next_f_aa;
+		f_aas = next_f_aas;
+		f_asas = next_f_asas;
+		
+		// Renormalise every lazynorm generations (and at the end), or sooner if the total is
+		// drifting towards overflow or underflow...
+		
+		totalplants = f_AA + f_Aa + f_Aas + f_aa + f_aas + f_asas;
+		countdown--;
+		if (countdown == 0 || n == endpoint - 1 || totalplants > LAZYMAX || totalplants < LAZYMIN)
+		{
+			countdown = lazynorm;
+			if (totalplants > 0)
+			{
+				reciprocal = 1 / totalplants;
+				f_AA *= reciprocal;
+				f_Aa *= reciprocal;
+				f_Aas *= reciprocal;
+				f_aa *= reciprocal;
+				f_aas *= reciprocal;
+				f_asas *= reciprocal;
+				totalplants = 1;
+			}
+		}
+		
+		// Extinction clamp (relative to the current total) and check for subnormals, if wanted...
+		
+		if (guarded)
+		{
+			KERNEL(guardfrequency)(&f_AA, extinction * totalplants, flags);
+			KERNEL(guardfrequency)(&f_Aa, extinction * totalplants, flags);
+			KERNEL(guardfrequency)(&f_Aas, extinction * totalplants, flags);
+			KERNEL(guardfrequency)(&f_aa, extinction * totalplants, flags);
+			KERNEL(guardfrequency)(&f_aas, extinction * totalplants, flags);
+			KERNEL(guardfrequency)(&f_asas, extinction * totalplants, flags);
+		}
+		
+		// Absorbing state: once the inconstants have gone (exactly, e.g. through --extinction), this
+		// is an ordinary dioecious population, which within two generations reaches AA : Aa = 1 : ppY
+		// (aa having no mothers), and stays there. So go straight there (as long as there are females
+		// and Aa males; without Aa males, there would be no females in the next generation)...
+		
+		if (absorbing && f_Aas == 0 && f_aas == 0 && f_asas == 0 && f_AA > 0 && f_Aa > 0 && ppY > 0)
+		{
+			f_AA = 1 / (1 + ppY);
+			f_Aa = ppY / (1 + ppY);
+			f_aa = 0;
+			stopped = n + 1;
+			break;
+		}
+	}
+	
+	f[0] = f_AA;
+	f[1] = f_Aa;
+	f[2] = f_Aas;
+	f[3] = f_aa;
+	f[4] = f_aas;
+	f[5] = f_asas;
+	
+	return stopped ? stopped : endpoint;
+}
+
+// The specialisations. The names say what has been removed: pollen limitation (PSatF = 0),
+// selfing (S = 0) and Y pollen viability (ppY = 1).
+
+int KERNEL(simulate_generic) (double * f, float Q, float F, int * flags) { return KERNEL(simulate_body)(f, Q, F, flags, h, S, d, V, PSatF, ppY, 1, 1); }
+int KERNEL(simulate_nolimit) (double * f, float Q, float F, int * flags) { return KERNEL(simulate_body)(f, Q, F, flags, h, S, d, V, 0, ppY, 0, 1); }
+int KERNEL(simulate_noself) (double * f, float Q, float F, int * flags) { return KERNEL(simulate_body)(f, Q, F, flags, h, 0, d, V, PSatF, ppY, 1, 0); }
+int KERNEL(simulate_noppy) (double * f, float Q, float F, int * flags) { return KERNEL(simulate_body)(f, Q, F, flags, h, S, d, V, PSatF, 1, 1, 1); }
+int KERNEL(simulate_nolimit_noself) (double * f, float Q, float F, int * flags) { return KERNEL(simulate_body)(f, Q, F, flags, h, 0, d, V, 0, ppY, 0, 0); }
+int KERNEL(simulate_nolimit_noppy) (double * f, float Q, float F, int * flags) { return KERNEL(simulate_body)(f, Q, F, flags, h, S, d, V, 0, 1, 0, 1); }
+int KERNEL(simulate_noself_noppy) (double * f, float Q, float F, int * flags) { return KERNEL(simulate_body)(f, Q, F, flags, h, 0, d, V, PSatF, 1, 1, 0); }
+int KERNEL(simulate_nolimit_noself_noppy) (double * f, float Q, float F, int * flags) { return KERNEL(simulate_body)(f, Q, F, flags, h, 0, d, V, 0, 1, 0, 0); }
+
+// For --area and --sensitivity, which vary the other parameters as well as Q and F: h, S, d, V, PSatF
+// and ppY (in that order) are taken from parameters[] instead of the globals, so that points with
+// different parameters can be run at the same time.
+
+int KERNEL(simulate_parameters) (double * f, float Q, float F, int * flags, const float * parameters)
+{
+	return KERNEL(simulate_body)(f, Q, F, flags, parameters[0], parameters[1], parameters[2], parameters[3], parameters[4], parameters[5], 1, 1);
+}
+
+// Pick the specialisation for the current parameters, and say which it is.
+
+simulate_function KERNEL(specialise) (const char ** description)
+{
+	int nolimit = (PSatF == 0);
+	int noself = (S == 0);
+	int noppy = (ppY == 1);
+	
+	if (nolimit && noself && noppy)	{ *description = "no pollen limitation, no selfing, ppY = 1";	return KERNEL(simulate_nolimit_noself_noppy); }
+	else if (nolimit && noself)	{ *description = "no pollen limitation, no selfing";	return KERNEL(simulate_nolimit_noself); }
+	else if (nolimit && noppy)	{ *description = "no pollen limitation, ppY = 1";	return KERNEL(simulate_nolimit_noppy); }
+	else if (noself && noppy)	{ *description = "no selfing, ppY = 1";	return KERNEL(simulate_noself_noppy); }
+	else if (nolimit)	{ *description = "no pollen limitation";	return KERNEL(simulate_nolimit); }
+	else if (noself)	{ *description = "no selfing";	return KERNEL(simulate_noself); }
+	else if (noppy)	{ *description = "ppY = 1";	return KERNEL(simulate_noppy); }
+	else	{ *description = "generic";	return KERNEL(simulate_generic); }
+}
+
+#endif
+
+// THE GRID ENGINE (--engine grid)...
+//
+// One generation of the recursion for every live cell of a tile. The frequencies of each genotype
+// are held in their own array (g_AA[] etc., one element per cell), as are Q and F, so this is a
+// single loop over the cells that the compiler can vectorise (at -O3, or -O2 -ftree-vectorize).
+// The arithmetic is exactly that of simulate_body(), but written without branches: both sides of
+// each pollen limitation test are worked out and one is chosen (keeping the type each expression
+// has there, hence wide), and a division by the total is replaced by a division by 1 when the total
+// is zero. The results are therefore bit-identical. The other parameters are the same for every
+// cell, except in the dual number instantiation, where they're arrays like Q and F (see
+// generationjacobian_dual()).
+
+static ALWAYS_INLINE void KERNEL(advancetile_body) (real * restrict g_AA, real * restrict g_Aa, real * restrict g_Aas, real * restrict g_aa, real * restrict g_aas, real * restrict g_asas,
+	const param * restrict Qs, const param * restrict Fs, int live, shared hs, shared Ss, shared ds, shared Vs, shared PSatFs, shared ppYs, const int limited, const int selfing)
+{
+#ifdef DERIVATIVES
+	const int guarded = 0;			// The derivatives are of the recursion itself, without the extinction limit
+#else
+	const int guarded = (extinction > 0);
+#endif
+	int i;
+	
+	for (i = 0; i < live; i++)
+	{
+		real f_AA = g_AA[i];
+		real f_Aa = g_Aa[i];
+		real f_Aas = g_Aas[i];
+		real f_aa = g_aa[i];
+		real f_aas = g_aas[i];
+		real f_asas = g_asas[i];
+		const param Q = Qs[i];
+		const param F = Fs[i];
+		const param h = SHARED(hs);
+		const param S = SHARED(Ss);
+		const param d = SHARED(ds);
+		const param V = SHARED(Vs);
+		const param PSatF = SHARED(PSatFs);
+		const param ppY = SHARED(ppYs);
+		const real absorbed_AA = 1 / (1 + ppY);
+		const real absorbed_Aa = ppY / (1 + ppY);
+		
+		real next_f_AA;
+		real next_f_Aa;
+		real next_f_Aas;
+		real next_f_aa;
+		real next_f_aas;
+		real next_f_asas;
+		real p_A;
+		real p_a;
+		real p_as;
+		real e_A;
+		real e_a;
+		real e_as;
+		real PSatC;
+		real totalpollen;
+		real totalplants;
+		real divisor;
+		int saturatedF;
+		int saturatedC;
+		wide ovules_Aas;			// Outcrossed eggs from each inconstant, without pollen limitation...
+		wide ovules_aas;
+		real ovules_asas;
+		real limited_AA;			// ...and with it (worked out whether or not it applies)
+		wide limited_Aas;
+		wide limited_aas;
+		real limited_asas;
+		int dioecious;
+		
+		// Outcrossed pollen frequencies...
+		
+		p_A = 0;
+		p_a = 0;
+		p_as = 0;
+		
+		p_A += f_Aa * 0.5;
+		p_a += f_Aa * 0.5;
+		
+		p_A += f_Aas * 0.5 * h * Q;
+		p_as += f_Aas * 0.5 * h * Q;
+		
+		p_A += f_Aas * 0.5 * (1 - h);
+		p_as += f_Aas * 0.5 * (1 - h);
+		
+		p_a += f_aa;
+		
+		p_a += f_aas * 0.5 * h * Q;
+		p_as += f_aas * 0.5 * h * Q;
+		
+		p_a += f_aas * 0.5 * (1 - h);
+		p_as += f_aas * 0.5 * (1 - h);
+		
+		p_as += f_asas * h * Q;
+		
+		p_as += f_asas * (1 - h);
+		
+		p_a *= ppY;
+		p_as *= ppY;
+		
+		totalpollen = p_A + p_a + p_as;
+		divisor = totalpollen + (VALUE(totalpollen) <= 0);
+		p_A /= divisor;
+		p_a /= divisor;
+		p_as /= divisor;
+		
+		// Outcrossed egg frequencies...
+		
+		PSatC = PSatF * F * (1 - S);
+		saturatedF = (limited == 0) | (VALUE(totalpollen) >= VALUE(PSatF));
+		saturatedC = (limited == 0) | (VALUE(totalpollen) >= VALUE(PSatC));
+		
+		e_A = 0;
+		e_a = 0;
+		e_as = 0;
+		
+		ovules_Aas = f_Aas * h * 0.5 * (1 - S) * F;
+		ovules_aas = f_aas * h * 0.5 * (1 - S) * F;
+		ovules_asas = f_asas * h * (1 - S) * F;
+		limited_AA = f_AA * totalpollen / PSatF;
+		limited_Aas = ovules_Aas * totalpollen / PSatC;
+		limited_aas = ovules_aas * totalpollen / PSatC;
+		limited_asas = ovules_asas * totalpollen / PSatC;
+		
+		e_A += saturatedF ? f_AA : limited_AA;
+		
+		e_A += saturatedC ? ovules_Aas : limited_Aas;
+		e_as += saturatedC ? ovules_Aas : limited_Aas;
+		
+		e_a += saturatedC ? ovules_aas : limited_aas;
+		e_as += saturatedC ? ovules_aas : limited_aas;
+		
+		e_as += saturatedC ? ovules_asas : limited_asas;
+		
+		// Plant frequencies from outcrossing, then selfing...
+		
+		next_f_AA = p_A * e_A;
+		next_f_Aa = p_A * e_a + p_a * e_A;
+		next_f_Aas = p_A * e_as + p_as * e_A;
+		next_f_aa = p_a * e_a;
+		next_f_aas = p_a * e_as + p_as * e_a;
+		next_f_asas = p_as * e_as;
+		
+		if (selfing)
+		{
+			next_f_AA += f_Aas * (0.5 / (1 + ppY)) * S * (1 - d) * h * F;
+			next_f_Aas += f_Aas * 0.5 * S * (1 - d) * h * F;
+			next_f_asas += f_Aas * (0.5 * ppY / (1 + ppY)) * S * (1 - d) * h * F;
+			
+			next_f_aa += f_aas * 0.25 * S * (1 - d) * h * F;
+			next_f_aas += f_aas * 0.5 * S * (1 - d) * h * F;
+			next_f_asas += f_aas * 0.25 * S * (1 - d) * h * F;
+			
+			next_f_asas += f_asas * S * (1 - d) * h * F;
+		}
+		
+		// YY penalty, and normalise...
+		
+		next_f_aa *= V;
+		next_f_aas *= V;
+		next_f_asas *= V;
+		
+		f_AA = next_f_AA;
+		f_Aa = next_f_Aa;
+		f_Aas = next_f_Aas;
+		f_aa = next_f_aa;
+		f_aas = next_f_aas;
+		f_asas = next_f_asas;
+		
+		totalplants = f_AA + f_Aa + f_Aas + f_aa + f_aas + f_asas;
+		divisor = totalplants + (VALUE(totalplants) <= 0);
+		f_AA /= divisor;
+		f_Aa /= divisor;
+		f_Aas /= divisor;
+		f_aa /= divisor;
+		f_aas /= divisor;
+		f_asas /= divisor;
+		
+		if (guarded)
+		{
+			f_AA = VALUE(f_AA) < extinction ? 0 : f_AA;
+			f_Aa = VALUE(f_Aa) < extinction ? 0 : f_Aa;
+			f_Aas = VALUE(f_Aas) < extinction ? 0 : f_Aas;
+			f_aa = VALUE(f_aa) < extinction ? 0 : f_aa;
+			f_aas = VALUE(f_aas) < extinction ? 0 : f_aas;
+			f_asas = VALUE(f_asas) < extinction ? 0 : f_asas;
+		}
+		
+		// The absorbing state (see simulate_body()). A cell that reaches it is put back there exactly
+		// every generation, so it is found to have stopped at the next compaction...
+		
+		dioecious = (ABSORBING && VALUE(f_Aas) == 0 && VALUE(f_aas) == 0 && VALUE(f_asas) == 0 && VALUE(f_AA) > 0 && VALUE(f_Aa) > 0 && VALUE(ppY) > 0);
+		f_AA = dioecious ? absorbed_AA : f_AA;
+		f_Aa = dioecious ? absorbed_Aa : f_Aa;
+		f_aa = dioecious ? 0 : f_aa;
+		
+		g_AA[i] = f_AA;
+		g_Aa[i] = f_Aa;
+		g_Aas[i] = f_Aas;
+		g_aa[i] = f_aa;
+		g_aas[i] = f_aas;
+		g_asas[i] = f_asas;
+	}
+}
+
+#ifdef DERIVATIVES
+
+// One generation of the recursion for a single cell, as generation() does it, with its derivatives,
+// for --continuation and --jacobian; this is the generationjacobian_dual() that they call. next[] is
+// the frequencies after it, and jacobian[] (NGENOTYPES rows, each of JACOBIANCOLUMNS elements) the
+// derivative of each with respect to each start frequency, then to each parameter, in the order of
+// continuationnames[]. (The working is all in double precision here, parameters included, so next[]
+// can differ from what generation() gives in about the 8th decimal place.)
+//
+// Each number is used as a dual number, x + x' DUALSTEP i: a direction is given an imaginary part
+// of DUALSTEP, and the arithmetic carries the derivative along in the imaginary parts (the product
+// of two of them underflows to 0, so it's exact, to rounding, with no step to choose). Every
+// direction (each start frequency, and each parameter) is given a cell of its own, and all of them
+// are worked out in a single pass over a tile of JACOBIANCOLUMNS cells, so the cost is one
+// generation of that tile, in complex arithmetic, and the extinction limit and the absorbing state
+// are left out (they would set the derivatives to 0).
+
+void KERNEL(generationjacobian) (const double * f, float Q, float F, double * next, double * jacobian)
+{
+	real g[NGENOTYPES][JACOBIANCOLUMNS];
+	real p[NCONTINUABLES][JACOBIANCOLUMNS];
+	int j;
+	int k;
+	
+	for (j = 0; j < JACOBIANCOLUMNS; j++)
+	{
+		for (k = 0; k < NGENOTYPES; k++) g[k][j] = CMPLX(f[k], (j == k) ? DUALSTEP : 0);
+		p[0][j] = CMPLX(Q, (j == NGENOTYPES) ? DUALSTEP : 0);
+		p[1][j] = CMPLX(F, (j == NGENOTYPES + 1) ? DUALSTEP : 0);
+		for (k = 2; k < NCONTINUABLES; k++) p[k][j] = CMPLX(*continuationvalues[k], (j == NGENOTYPES + k) ? DUALSTEP : 0);
+	}
+	KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], p[0], p[1], JACOBIANCOLUMNS, &p[2][0], &p[3][0], &p[4][0], &p[5][0], &p[6][0], &p[7][0], 1, 1);
+	
+	for (k = 0; k < NGENOTYPES; k++)
+	{
+		next[k] = creal(g[k][0]);
+		for (j = 0; j < JACOBIANCOLUMNS; j++) jacobian[k * JACOBIANCOLUMNS + j] = cimag(g[k][j]) / DUALSTEP;
+	}
+}
+
+#else
+
+// One generation of the recursion for a single cell, as the grid engine does it, for --continuation
+// (which needs the map itself, rather than a run of it). f[] is updated in place.
+
+void KERNEL(generation) (double * f, float Q, float F)
+{
+	real g[NGENOTYPES];
+	int k;
+	
+	for (k = 0; k < NGENOTYPES; k++) g[k] = f[k];
+	KERNEL(advancetile_body)(&g[0], &g[1], &g[2], &g[3], &g[4], &g[5], &Q, &F, 1, h, S, d, V, PSatF, ppY, 1, 1);
+	for (k = 0; k < NGENOTYPES; k++) f[k] = g[k];
+}
+
+// Run the recursion for a tile of cells at once, one generation of all of them at a time (see
+// above). Every GRIDCHECK generations, the cells whose frequencies didn't change in that generation
+// (by more than the tolerance, with --converge; at all, otherwise) are retired: their results are
+// written out, and the rest are moved down to fill the gaps, so the loop only ever runs over live
+// cells. On entry, f[] holds the start frequencies of each cell in turn (NGENOTYPES each); on exit,
+// the final frequencies, and generations[] the generation at which each cell was retired (endpoint
+// if it never was).
+
+void KERNEL(simulate_tile) (int cells, const float * tileQ, const float * tileF, double * f, int * generations)
+{
+	real * g[NGENOTYPES];
+	real * before[NGENOTYPES];
+	real * block;
+	float * Q;
+	float * F;
+	int * cell;
+	real limit = stopearly ? tolerance : 0;
+	int nolimit = (PSatF == 0);
+	int noself = (S == 0);
+	int live = cells;
+	int kept;
+	int moved;
+	int i;
+	int k;
+	int n;
+	
+	block = malloc(2 * NGENOTYPES * cells * sizeof(real));
+	Q = malloc(cells * sizeof(float));
+	F = malloc(cells * sizeof(float));
+	cell = malloc(cells * sizeof(int));
+	if (block == NULL || Q == NULL || F == NULL || cell == NULL)
+	{
+		printf("Out of memory!\n");
+		exit(1);
+	}
+	
+	for (k = 0; k < NGENOTYPES; k++)
+	{
+		g[k] = block + k * cells;
+		before[k] = block + (NGENOTYPES + k) * cells;
+	}
+	
+	for (i = 0; i < cells; i++)
+	{
+		for (k = 0; k < NGENOTYPES; k++) g[k][i] = f[i * NGENOTYPES + k];
+		Q[i] = tileQ[i];
+		F[i] = tileF[i];
+		cell[i] = i;
+	}
+	
+	for (n = 0; n < endpoint && live > 0; n++)
+	{
+		if ((n + 1) % GRIDCHECK == 0)
+		{
+			for (k = 0; k < NGENOTYPES; k++) memcpy(before[k], g[k], live * sizeof(real));
+		}
+		
+		if (nolimit && noself) KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], Q, F, live, h, 0, d, V, 0, ppY, 0, 0);
+		else if (nolimit) KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], Q, F, live, h, S, d, V, 0, ppY, 0, 1);
+		else if (noself) KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], Q, F, live, h, 0, d, V, PSatF, ppY, 1, 0);
+		else KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], Q, F, live, h, S, d, V, PSatF, ppY, 1, 1);
+		
+		if ((n + 1) % GRIDCHECK == 0)
+		{
+			kept = 0;
+			for (i = 0; i < live; i++)
+			{
+				moved = 0;
+				for (k = 0; k < NGENOTYPES; k++)
+				{
+					if (g[k][i] - before[k][i] > limit || before[k][i] - g[k][i] > limit) moved = 1;
+				}
+				
+				if (moved)
+				{
+					for (k = 0; k < NGENOTYPES; k++) g[k][kept] = g[k][i];
+					Q[kept] = Q[i];
+					F[kept] = F[i];
+					cell[kept] = cell[i];
+					kept++;
+				} else {
+					for (k = 0; k < NGENOTYPES; k++) f[cell[i] * NGENOTYPES + k] = g[k][i];
+					generations[cell[i]] = n + 1;
+				}
+			}
+			live = kept;
+		}
+	}
+	
+	for (i = 0; i < live; i++)
+	{
+		for (k = 0; k < NGENOTYPES; k++) f[cell[i] * NGENOTYPES + k] = g[k][i];
+		generations[cell[i]] = endpoint;
+	}
+	
+	free(block);
+	free(Q);
+	free(F);
+	free(cell);
+	
+	return;
+}
+
+// Run replicates of the finite population recursion (--popsize) for one cell, in the same way as
+// simulate_tile(): advancetile_body() works out the expected frequencies of every live replicate at
+// once, and then a sample of popsize plants is drawn for each (see drawgeneration()). A replicate is
+// retired as soon as the invader has been lost or has fixed (see replicateoutcome()), so the loop
+// only ever runs over the replicates still undecided. Replicates first to first + count - 1 are run,
+// each with its own random number stream, so that batches can be run in any order (or thread). On
+// exit, counts[] holds the number of each outcome (counts[0] being the replicates still undecided
+// after endpoint generations), and *generations the total generations run.
+
+void KERNEL(simulate_replicates) (float Q, float F, const double * start, long long first, int count, long long * counts, long long * generations)
+{
+	real * g[NGENOTYPES];
+	real * block;
+	float * Qs;
+	float * Fs;
+	struct rngstream * streams;
+	double snapshot[NGENOTYPES];
+	int nolimit = (PSatF == 0);
+	int noself = (S == 0);
+	int live = count;
+	int kept;
+	int outcome;
+	int i;
+	int k;
+	int n;
+	
+	block = malloc(NGENOTYPES * count * sizeof(real));
+	Qs = malloc(count * sizeof(float));
+	Fs = malloc(count * sizeof(float));
+	streams = malloc(count * sizeof(struct rngstream));
+	if (block == NULL || Qs == NULL || Fs == NULL || streams == NULL)
+	{
+		printf("Out of memory!\n");
+		exit(1);
+	}
+	
+	for (k = 0; k < NGENOTYPES; k++) g[k] = block + k * count;
+	
+	for (i = 0; i < count; i++)
+	{
+		for (k = 0; k < NGENOTYPES; k++) g[k][i] = start[k];
+		Qs[i] = Q;
+		Fs[i] = F;
+		replicatestream(&streams[i], Q, F, start, first + i);
+	}
+	
+	counts[0] = counts[LOST] = counts[FIXED] = 0;
+	*generations = 0;
+	
+	for (n = 0; n < endpoint && live > 0; n++)
+	{
+		if (nolimit && noself) KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], Qs, Fs, live, h, 0, d, V, 0, ppY, 0, 0);
+		else if (nolimit) KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], Qs, Fs, live, h, S, d, V, 0, ppY, 0, 1);
+		else if (noself) KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], Qs, Fs, live, h, 0, d, V, PSatF, ppY, 1, 0);
+		else KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], Qs, Fs, live, h, S, d, V, PSatF, ppY, 1, 1);
+		
+		kept = 0;
+		for (i = 0; i < live; i++)
+		{
+			for (k = 0; k < NGENOTYPES; k++) snapshot[k] = g[k][i];
+			drawgeneration(snapshot, &streams[i]);
+			
+			outcome = replicateoutcome(snapshot);
+			if (outcome)
+			{
+				counts[outcome]++;
+				*generations += n + 1;
+			} else {
+				for (k = 0; k < NGENOTYPES; k++) g[k][kept] = snapshot[k];
+				streams[kept] = streams[i];
+				kept++;
+			}
+		}
+		live = kept;
+	}
+	
+	counts[0] += live;
+	*generations += (long long) live * endpoint;
+	
+	free(block);
+	free(Qs);
+	free(Fs);
+	free(streams);
+	
+	return;
+}
+
+// THE SPATIAL MODEL (--lattice)...
+//
+// Each deme of the lattice runs the recursion, except that its outcrossed pollen comes partly from
+// other demes. So that the pollen can be dispersed in between, a generation is split in two: first
+// the pollen each deme makes (the sums at the start of advancetile_body(), before they're normalised,
+// i.e. in proportion to the deme's output), for a row of demes...
+
+static ALWAYS_INLINE void KERNEL(latticepollen_body) (const real * restrict g_Aa, const real * restrict g_Aas, const real * restrict g_aa, const real * restrict g_aas, const real * restrict g_asas,
+	real * restrict out_A, real * restrict out_a, real * restrict out_as, int count, float Q, float ppY)
+{
+	int i;
+	
+	for (i = 0; i < count; i++)
+	{
+		real f_Aa = g_Aa[i];
+		real f_Aas = g_Aas[i];
+		real f_aa = g_aa[i];
+		real f_aas = g_aas[i];
+		real f_asas = g_asas[i];
+		real p_A;
+		real p_a;
+		real p_as;
+		
+		p_A = 0;
+		p_a = 0;
+		p_as = 0;
+		
+		p_A += f_Aa * 0.5;
+		p_a += f_Aa * 0.5;
+		
+		p_A += f_Aas * 0.5 * h * Q;
+		p_as += f_Aas * 0.5 * h * Q;
+		
+		p_A += f_Aas * 0.5 * (1 - h);
+		p_as += f_Aas * 0.5 * (1 - h);
+		
+		p_a += f_aa;
+		
+		p_a += f_aas * 0.5 * h * Q;
+		p_as += f_aas * 0.5 * h * Q;
+		
+		p_a += f_aas * 0.5 * (1 - h);
+		p_as += f_aas * 0.5 * (1 - h);
+		
+		p_as += f_asas * h * Q;
+		
+		p_as += f_asas * (1 - h);
+		
+		p_a *= ppY;
+		p_as *= ppY;
+		
+		out_A[i] = p_A;
+		out_a[i] = p_a;
+		out_as[i] = p_as;
+	}
+}
+
+// ...and then, given the pollen each deme receives (in the same units), the rest of the generation,
+// in place. This is the rest of advancetile_body(), except that there's no absorbing state: a deme
+// that is dioecious can still be reached by inconstants from elsewhere.
+
+static ALWAYS_INLINE void KERNEL(latticeseeds_body) (real * restrict g_AA, real * restrict g_Aa, real * restrict g_Aas, real * restrict g_aa, real * restrict g_aas, real * restrict g_asas,
+	const real * restrict in_A, const real * restrict in_a, const real * restrict in_as, int count, float F, float S, float PSatF, float ppY, const int limited, const int selfing)
+{
+	const int guarded = (extinction > 0);
+	int i;
+	
+	for (i = 0; i < count; i++)
+	{
+		real f_AA = g_AA[i];
+		real f_Aa = g_Aa[i];
+		real f_Aas = g_Aas[i];
+		real f_aa = g_aa[i];
+		real f_aas = g_aas[i];
+		real f_asas = g_asas[i];
+		real p_A = in_A[i];
+		real p_a = in_a[i];
+		real p_as = in_as[i];
+		
+		real next_f_AA;
+		real next_f_Aa;
+		real next_f_Aas;
+		real next_f_aa;
+		real next_f_aas;
+		real next_f_asas;
+		real e_A;
+		real e_a;
+		real e_as;
+		real PSatC;
+		real totalpollen;
+		real totalplants;
+		real divisor;
+		int saturatedF;
+		int saturatedC;
+		wide ovules_Aas;
+		wide ovules_aas;
+		real ovules_asas;
+		real limited_AA;
+		wide limited_Aas;
+		wide limited_aas;
+		real limited_asas;
+		
+		totalpollen = p_A + p_a + p_as;
+		divisor = totalpollen + (totalpollen <= 0);
+		p_A /= divisor;
+		p_a /= divisor;
+		p_as /= divisor;
+		
+		// Outcrossed egg frequencies...
+		
+		PSatC = PSatF * F * (1 - S);
+		saturatedF = (limited == 0) | (totalpollen >= PSatF);
+		saturatedC = (limited == 0) | (totalpollen >= PSatC);
+		
+		e_A = 0;
+		e_a = 0;
+		e_as = 0;
+		
+		ovules_Aas = f_Aas * h * 0.5 * (1 - S) * F;
+		ovules_aas = f_aas * h * 0.5 * (1 - S) * F;
+		ovules_asas = f_asas * h * (1 - S) * F;
+		limited_AA = f_AA * totalpollen / PSatF;
+		limited_Aas = ovules_Aas * totalpollen / PSatC;
+		limited_aas = ovules_aas * totalpollen / PSatC;
+		limited_asas = ovules_asas * totalpollen / PSatC;
+		
+		e_A += saturatedF ? f_AA : limited_AA;
+		
+		e_A += saturatedC ? ovules_Aas : limited_Aas;
+		e_as += saturatedC ? ovules_Aas : limited_Aas;
+		
+		e_a += saturatedC ? ovules_aas : limited_aas;
+		e_as += saturatedC ? ovules_aas : limited_aas;
+		
+		e_as += saturatedC ? ovules_asas : limited_asas;
+		
+		// Plant frequencies from outcrossing, then selfing...
+		
+		next_f_AA = p_A * e_A;
+		next_f_Aa = p_A * e_a + p_a * e_A;
+		next_f_Aas = p_A * e_as + p_as * e_A;
+		next_f_aa = p_a * e_a;
+		next_f_aas = p_a * e_as + p_as * e_a;
+		next_f_asas = p_as * e_as;
+		
+		if (selfing)
+		{
+			next_f_AA += f_Aas * (0.5 / (1 + ppY)) * S * (1 - d) * h * F;
+			next_f_Aas += f_Aas * 0.5 * S * (1 - d) * h * F;
+			next_f_asas += f_Aas * (0.5 * ppY / (1 + ppY)) * S * (1 - d) * h * F;
+			
+			next_f_aa += f_aas * 0.25 * S * (1 - d) * h * F;
+			next_f_aas += f_aas * 0.5 * S * (1 - d) * h * F;
+			next_f_asas += f_aas * 0.25 * S * (1 - d) * h * F;
+			
+			next_f_asas += f_asas * S * (1 - d) * h * F;
+		}
+		
+		// YY penalty, and normalise...
+		
+		next_f_aa *= V;
+		next_f_aas *= V;
+		next_f_asas *= V;
+		
+		totalplants = next_f_AA + next_f_Aa + next_f_Aas + next_f_aa + next_f_aas + next_f_asas;
+		divisor = totalplants + (totalplants <= 0);
+		f_AA = next_f_AA / divisor;
+		f_Aa = next_f_Aa / divisor;
+		f_Aas = next_f_Aas / divisor;
+		f_aa = next_f_aa / divisor;
+		f_aas = next_f_aas / divisor;
+		f_asas = next_f_asas / divisor;
+		
+		if (guarded)
+		{
+			f_AA = f_AA < extinction ? 0 : f_AA;
+			f_Aa = f_Aa < extinction ? 0 : f_Aa;
+			f_Aas = f_Aas < extinction ? 0 : f_Aas;
+			f_aa = f_aa < extinction ? 0 : f_aa;
+			f_aas = f_aas < extinction ? 0 : f_aas;
+			f_asas = f_asas < extinction ? 0 : f_asas;
+		}
+		
+		g_AA[i] = f_AA;
+		g_Aa[i] = f_Aa;
+		g_Aas[i] = f_Aas;
+		g_aa[i] = f_aa;
+		g_aas[i] = f_aas;
+		g_asas[i] = f_asas;
+	}
+}
+
+// Pollen dispersal (see latticesweep() for the dispersal kernel): for one gamete type, a row of the
+// pollen made, padded by dispersalradius demes at each end (reflected), is smoothed along the row...
+
+static ALWAYS_INLINE void KERNEL(disperserow) (const real * restrict padded, real * restrict out, const real * restrict weights, int size)
+{
+	int i;
+	int k;
+	
+	for (i = 0; i < size; i++) out[i] = 0;
+	for (k = 0; k <= 2 * dispersalradius; k++)
+	{
+		for (i = 0; i < size; i++) out[i] += weights[k] * padded[i + k];
+	}
+}
+
+// ...and then down the columns, one row of output at a time, from the rows within dispersalradius
+// (reflected at the edges). Each loop is over a row, so both vectorise.
+
+static ALWAYS_INLINE void KERNEL(dispersecolumns) (const real * restrict rows, real * restrict out, const real * restrict weights, int size, int y)
+{
+	const real * source;
+	int i;
+	int k;
+	
+	for (i = 0; i < size; i++) out[i] = 0;
+	for (k = 0; k <= 2 * dispersalradius; k++)
+	{
+		source = rows + (size_t) reflectindex(y + k - dispersalradius, size) * size;
+		for (i = 0; i < size; i++) out[i] += weights[k] * source[i];
+	}
+}
+
+// Run the recursion on a size x size lattice of demes for endpoint generations, starting every deme
+// from outside[], except those within patchradius of the centre, which start from inside[]. The
+// genotype frequencies are held as the grid engine holds a tile's (one array per genotype), a row of
+// demes at a time being contiguous. Each generation is two passes over the rows, shared between
+// threads in strips: the pollen made by each row, smoothed along the row into rows[]; then, for each
+// row, the smoothing down the columns, which gives the pollen the row receives, and the rest of the
+// generation. Every census generations (and at the end), census() is called for every deme in turn.
+
+void KERNEL(simulate_lattice) (int size, float Q, float F, const double * outside, const double * inside, double patchradius,
+	void (* census) (int generation, int x, int y, double * f))
+{
+	real * g[NGENOTYPES];
+	real * rows[NGAMETES];
+	real * block;
+	real weights[2 * MAXRADIUS + 1];
+	real stay;					// The pollen a deme receives is stay times its own, plus spread times
+	real spread;				// the smoothed pollen (which includes some of its own; see latticesweep())
+	double frequencies[NGENOTYPES];
+	size_t cells = (size_t) size * size;
+	size_t cell;
+	double dx;
+	double dy;
+	int nolimit = (PSatF == 0);
+	int noself = (S == 0);
+	int x;
+	int y;
+	int k;
+	int n;
+	
+	block = malloc((NGENOTYPES + NGAMETES) * cells * sizeof(real));
+	if (block == NULL)
+	{
+		printf("Out of memory!\n");
+		exit(1);
+	}
+	for (k = 0; k < NGENOTYPES; k++) g[k] = block + k * cells;
+	for (k = 0; k < NGAMETES; k++) rows[k] = block + (NGENOTYPES + k) * cells;
+	
+	for (k = 0; k <= 2 * dispersalradius; k++) weights[k] = dispersalweights[k];
+	spread = dispersal / (1 - dispersalweights[dispersalradius] * dispersalweights[dispersalradius]);
+	stay = 1 - spread;
+	if (dispersalradius == 0)
+	{
+		spread = 0;
+		stay = 1;
+	}
+	
+	for (y = 0; y < size; y++)
+	{
+		for (x = 0; x < size; x++)
+		{
+			dx = x - (size - 1) / 2.0;
+			dy = y - (size - 1) / 2.0;
+			cell = (size_t) y * size + x;
+			for (k = 0; k < NGENOTYPES; k++) g[k][cell] = (dx * dx + dy * dy <= patchradius * patchradius) ? inside[k] : outside[k];
+		}
+	}
+	
+	for (n = 0; ; n++)
+	{
+		if (n % censusevery == 0 || n == endpoint)
+		{
+			for (y = 0; y < size; y++)
+			{
+				for (x = 0; x < size; x++)
+				{
+					cell = (size_t) y * size + x;
+					for (k = 0; k < NGENOTYPES; k++) frequencies[k] = g[k][cell];
+					census(n, x, y, frequencies);
+				}
+			}
+		}
+		if (n == endpoint) break;
+		
+		// Pollen made, smoothed along the rows...
+		
+#ifdef _OPENMP
+		#pragma omp parallel private(x, y, k, cell)
+#endif
+		{
+			real * padded = malloc(NGAMETES * (size + 2 * dispersalradius) * sizeof(real));
+			real * p[NGAMETES];
+			
+			if (padded == NULL)
+			{
+				printf("Out of memory!\n");
+				exit(1);
+			}
+			for (k = 0; k < NGAMETES; k++) p[k] = padded + k * (size + 2 * dispersalradius);
+			
+#ifdef _OPENMP
+			#pragma omp for schedule(static)
+#endif
+			for (y = 0; y < size; y++)
+			{
+				cell = (size_t) y * size;
+				KERNEL(latticepollen_body)(g[1] + cell, g[2] + cell, g[3] + cell, g[4] + cell, g[5] + cell,
+					p[0] + dispersalradius, p[1] + dispersalradius, p[2] + dispersalradius, size, Q, ppY);
+				
+				for (k = 0; k < NGAMETES; k++)
+				{
+					for (x = 1; x <= dispersalradius; x++)
+					{
+						p[k][dispersalradius - x] = p[k][dispersalradius + reflectindex(-x, size)];
+						p[k][dispersalradius + size - 1 + x] = p[k][dispersalradius + reflectindex(size - 1 + x, size)];
+					}
+					KERNEL(disperserow)(p[k], rows[k] + cell, weights, size);
+				}
+			}
+			
+			free(padded);
+		}
+		
+		// ...then down the columns, and the rest of the generation...
+		
+#ifdef _OPENMP
+		#pragma omp parallel private(x, y, k, cell)
+#endif
+		{
+			real * received = malloc(2 * NGAMETES * size * sizeof(real));
+			real * r[NGAMETES];
+			real * own[NGAMETES];
+			
+			if (received == NULL)
+			{
+				printf("Out of memory!\n");
+				exit(1);
+			}
+			for (k = 0; k < NGAMETES; k++)
+			{
+				r[k] = received + k * size;
+				own[k] = received + (NGAMETES + k) * size;
+			}
+			
+#ifdef _OPENMP
+			#pragma omp for schedule(static)
+#endif
+			for (y = 0; y < size; y++)
+			{
+				cell = (size_t) y * size;
+				KERNEL(latticepollen_body)(g[1] + cell, g[2] + cell, g[3] + cell, g[4] + cell, g[5] + cell, own[0], own[1], own[2], size, Q, ppY);
+				
+				for (k = 0; k < NGAMETES; k++)
+				{
+					KERNEL(dispersecolumns)(rows[k], r[k], weights, size, y);
+					for (x = 0; x < size; x++) r[k][x] = stay * own[k][x] + spread * r[k][x];
+				}
+				
+				if (nolimit && noself) KERNEL(latticeseeds_body)(g[0] + cell, g[1] + cell, g[2] + cell, g[3] + cell, g[4] + cell, g[5] + cell, r[0], r[1], r[2], size, F, 0, 0, ppY, 0, 0);
+				else if (nolimit) KERNEL(latticeseeds_body)(g[0] + cell, g[1] + cell, g[2] + cell, g[3] + cell, g[4] + cell, g[5] + cell, r[0], r[1], r[2], size, F, S, 0, ppY, 0, 1);
+				else if (noself) KERNEL(latticeseeds_body)(g[0] + cell, g[1] + cell, g[2] + cell, g[3] + cell, g[4] + cell, g[5] + cell, r[0], r[1], r[2], size, F, 0, PSatF, ppY, 1, 0);
+				else KERNEL(latticeseeds_body)(g[0] + cell, g[1] + cell, g[2] + cell, g[3] + cell, g[4] + cell, g[5] + cell, r[0], r[1], r[2], size, F, S, PSatF, ppY, 1, 1);
+			}
+			
+			free(received);
+		}
+	}
+	
+	free(block);
+	
+	return;
+}
+
+#endif
+
+#undef param
+#undef shared
+#undef SHARED
+#undef VALUE
+#undef ABSORBING
@@ -0,0 +1,404 @@
+/*
+
+A frozen copy of the recursion in Model 2, exactly as it was in the main loop of the original
+deterministic_model2.c, for --verify. Do not change or "improve" this file: it is the standard that
+faster versions of the recursion (and builds with different compiler options) are checked against.
+
+The only changes from the original are that it has been moved into a function, which runs one
+combination of Q and F and returns the regime (which used to be written to result[x][y]), and that
+the final genotype frequencies are passed back in f[].
+
+*/
+
+
+// Keep the compiler's optimisations from changing the arithmetic here, even if the rest of the
+// program is being built with something like -ffast-math (GCC only). GCC, in its default GNU mode, also
+// fuses multiplies and adds into FMA instructions whenever the target has them (e.g. -march=native),
+// which rounds differently, so that is turned off too. The processor's own flush-to-zero and
+// denormals-are-zero modes are dealt with by frozen_reference(), below.
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize ("no-fast-math", "fp-contract=off")
+#endif
+
+int frozen_runcell (float Q, float F, float * f)
+{
+	// Plant frequencies... (zeroed here just to suppress a -Wall warning)
+	float f_AA_MM = 0;
+	float f_AA_Mm = 0;
+	float f_AA_mm = 0;
+	float f_Aa_MM = 0;
+	float f_Aa_Mm = 0;
+	float f_Aa_mm = 0;
+	float f_aa_MM = 0;
+	float f_aa_Mm = 0;
+	float f_aa_mm = 0;
+
+	float next_f_AA_MM;
+	float next_f_AA_Mm;
+	float next_f_AA_mm;
+	float next_f_Aa_MM;
+	float next_f_Aa_Mm;
+	float next_f_Aa_mm;
+	float next_f_aa_MM;
+	float next_f_aa_Mm;
+	float next_f_aa_mm;
+
+	// Pollen frequencies...
+	float p_A_M;
+	float p_A_m;
+	float p_a_M;
+	float p_a_m;
+	
+	// Egg frequencies...
+	float e_A_M;
+	float e_A_m;
+	float e_a_M;
+	float e_a_m;
+	
+	float male = 0;
+	float female = 0;
+	float inconstant = 0;
+	
+	float PSatC;				// Pollen saturation point for cosex receivers
+	
+	float totalpollen;
+	float totalplants;
+	int n;
+	int regime;
+	
+	// Set start plant frequencies...
+	
+	if (pgd == 0)				// Start with DIOECY, try inconstant invasion
+	{
+		f_AA_MM = 0;
+		f_AA_Mm = 0;
+		f_AA_mm = 0.499;
+		f_Aa_MM = 0;
+		f_Aa_Mm = 0.002;
+		f_Aa_mm = 0.499;
+		f_aa_MM = 0;
+		f_aa_Mm = 0;
+		f_aa_mm = 0;
+	} else {					// Start with PSEUDO-GYNODIOECY, try male invasion
+		f_AA_MM = 0.499;
+		f_AA_Mm = 0;
+		f_AA_mm = 0;
+		f_Aa_MM = 0.499;
+		f_Aa_Mm = 0;
+		f_Aa_mm = 0.002;
+		f_aa_MM = 0;
+		f_aa_Mm = 0;
+		f_aa_mm = 0;
+	}
+	
+	for (n = 0; n < endpoint; n++)
+	{
+		// Outcrossed pollen frequencies....................................................
+		//
+		// Here we sum up the 4 types of pollen (containing the 4 possible allele combinations)
+		// from the various possible sources. We could do this in 4 equations (as in the paper)
+		// but it's simpler to consider each source in turn and add to the totals.
+		
+		p_A_M = 0;
+		p_A_m = 0;
+		p_a_M = 0;
+		p_a_m = 0;
+		
+		// From AA MM pure females (genotype 1)
+		;
+		
+		// From AA Mm pure females (genotype 2)
+		;
+		
+		// From AA mm pure females (genotype 3)
+		;
+		
+		// From Aa MM inconstants (genotype 4) as cosexes
+		p_A_M += f_Aa_MM * 0.5 * h * Q;
+		p_a_M += f_Aa_MM * 0.5 * h * Q;
+		
+		// From Aa MM inconstants (genotype 4) as males
+		p_A_M += f_Aa_MM * 0.5 * (1 - h);
+		p_a_M += f_Aa_MM * 0.5 * (1 - h);
+		
+		// From Aa Mm inconstants (genotype 5) as cosexes
+		p_A_M += f_Aa_Mm * 0.25 * h * Q;
+		p_A_m += f_Aa_Mm * 0.25 * h * Q;
+		p_a_M += f_Aa_Mm * 0.25 * h * Q;
+		p_a_m += f_Aa_Mm * 0.25 * h * Q;
+		
+		// From Aa Mm inconstants (genotype 5) as males
+		p_A_M += f_Aa_Mm * 0.25 * (1 - h);
+		p_A_m += f_Aa_Mm * 0.25 * (1 - h);
+		p_a_M += f_Aa_Mm * 0.25 * (1 - h);
+		p_a_m += f_Aa_Mm * 0.25 * (1 - h);
+		
+		// From Aa mm pure males (genotype 6)
+		p_A_m += f_Aa_mm * 0.5;
+		p_a_m += f_Aa_mm * 0.5;
+		
+		// From aa MM inconstants (genotype 7) as cosexes
+		p_a_M += f_aa_MM * h * Q;
+		
+		// From aa MM inconstants (genotype 7) as males
+		p_a_M += f_aa_MM * (1 - h);
+		
+		// From aa Mm inconstants (genotype 8) as cosexes
+		p_a_M += f_aa_Mm * 0.5 * h * Q;
+		p_a_m += f_aa_Mm * 0.5 * h * Q;
+		
+		// From aa Mm inconstants (genotype 8) as males
+		p_a_M += f_aa_Mm * 0.5 * (1 - h);
+		p_a_m += f_aa_Mm * 0.5 * (1 - h);
+		
+		// From aa mm pure males (genotype 9)
+		p_a_m += f_aa_mm;
+		
+		// Normalise pollen frequencies to add up to 1......................................
+		
+		totalpollen = p_A_M + p_A_m + p_a_M + p_a_m;
+		if (totalpollen > 0)
+		{
+			p_A_M /= totalpollen;
+			p_A_m /= totalpollen;
+			p_a_M /= totalpollen;
+			p_a_m /= totalpollen;
+		}
+		
+		// Outcrossed egg frequencies.......................................................
+		
+		// Calculate pollen required to fertilise a cosex's outcrossing ovules:
+		PSatC = PSatF * F * (1 - S);
+		
+		e_A_M = 0;
+		e_A_m = 0;
+		e_a_M = 0;
+		e_a_m = 0;
+		
+		// From AA MM pure females (genotype 1)
+		if (totalpollen >= PSatF)
+		{
+			e_A_M += f_AA_MM;
+		} else {
+			e_A_M += f_AA_MM * totalpollen / PSatF;
+		}
+		
+		// From AA Mm pure females (genotype 2)
+		if (totalpollen >= PSatF)
+		{
+			e_A_M += f_AA_Mm * 0.5;
+			e_A_m += f_AA_Mm * 0.5;
+		} else {
+			e_A_M += f_AA_Mm * 0.5 * totalpollen / PSatF;
+			e_A_m += f_AA_Mm * 0.5 * totalpollen / PSatF;
+		}
+		
+		// From AA mm pure females (genotype 3)
+		if (totalpollen >= PSatF)
+		{
+			e_A_m += f_AA_mm;
+		} else {
+			e_A_m += f_AA_mm * totalpollen / PSatF;
+		}
+		
+		// From Aa MM inconstants (genotype 4) as cosexes
+		if (totalpollen >= PSatC)
+		{
+			e_A_M += f_Aa_MM * h * 0.5 * (1 - S) * F;
+			e_a_M += f_Aa_MM * h * 0.5 * (1 - S) * F;
+		} else {
+			e_A_M += f_Aa_MM * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+			e_a_M += f_Aa_MM * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+		}
+		
+		// From Aa Mm inconstants (genotype 5) as cosexes
+		if (totalpollen >= PSatC)
+		{
+			e_A_M += f_Aa_Mm * h * 0.25 * (1 - S) * F;
+			e_A_m += f_Aa_Mm * h * 0.25 * (1 - S) * F;
+			e_a_M += f_Aa_Mm * h * 0.25 * (1 - S) * F;
+			e_a_m += f_Aa_Mm * h * 0.25 * (1 - S) * F;
+		} else {
+			e_A_M += f_Aa_Mm * h * 0.25 * (1 - S) * F * totalpollen / PSatC;
+			e_A_m += f_Aa_Mm * h * 0.25 * (1 - S) * F * totalpollen / PSatC;
+			e_a_M += f_Aa_Mm * h * 0.25 * (1 - S) * F * totalpollen / PSatC;
+			e_a_m += f_Aa_Mm * h * 0.25 * (1 - S) * F * totalpollen / PSatC;
+		}
+		
+		// From Aa mm pure males (genotype 6)
+		;
+		
+		// From aa MM inconstants (genotype 7) as cosexes
+		if (totalpollen >= PSatC)
+		{
+			e_a_M += f_aa_MM * h * (1 - S) * F;
+		} else {
+			e_a_M += f_aa_MM * h * (1 - S) * F * totalpollen / PSatC;
+		}
+		
+		// From aa Mm inconstants (genotype 8) as cosexes
+		if (totalpollen >= PSatC)
+		{
+			e_a_M += f_aa_Mm * h * 0.5 * (1 - S) * F;
+			e_a_m += f_aa_Mm * h * 0.5 * (1 - S) * F;
+		} else {
+			e_a_M += f_aa_Mm * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+			e_a_m += f_aa_Mm * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+		}
+		
+		// From aa mm pure males (genotype 9)
+		;
+		
+		// WE CANNOT AND MUST NOT NORMALISE THE EGG FREQUENCIES, AS WE HAVEN'T
+		// YET CONSIDERED THE SELFED EGGS. BUT WE DON'T NEED TO NORMALISE.
+		
+		// Plant frequencies from outcrossing...............................................
+		
+		next_f_AA_MM = p_A_M * e_A_M;
+		next_f_AA_Mm = p_A_M * e_A_m + p_A_m * e_A_M;
+		next_f_AA_mm = p_A_m * e_A_m;
+		next_f_Aa_MM = p_A_M * e_a_M + p_a_M * e_A_M;
+		next_f_Aa_Mm = p_A_M * e_a_m + p_A_m * e_a_M + p_a_M * e_A_m + p_a_m * e_A_M;
+		next_f_Aa_mm = p_A_m * e_a_m + p_a_m * e_A_m;
+		next_f_aa_MM = p_a_M * e_a_M;
+		next_f_aa_Mm = p_a_M * e_a_m + p_a_m * e_a_M;
+		next_f_aa_mm = p_a_m * e_a_m;
+		
+		// Additional plants from selfing...................................................
+		
+		// From AA MM pure females (genotype 1)
+		;
+		
+		// From AA Mm pure females (genotype 2)
+		;
+		
+		// From AA mm pure females (genotype 3)
+		;
+		
+		// From Aa MM inconstants (genotype 4)
+		next_f_AA_MM += f_Aa_MM * 0.25 * S * (1 - d) * h * F;
+		next_f_Aa_MM += f_Aa_MM * 0.5 * S * (1 - d) * h * F;
+		next_f_aa_MM += f_Aa_MM * 0.25 * S * (1 - d) * h * F;
+		
+		// From Aa Mm inconstants (genotype 5)
+		next_f_AA_MM += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+		next_f_AA_Mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+		next_f_AA_mm += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+		next_f_Aa_MM += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+		next_f_Aa_Mm += f_Aa_Mm * 0.25 * S * (1 - d) * h * F;
+		next_f_Aa_mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+		next_f_aa_MM += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+		next_f_aa_Mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+		next_f_aa_mm += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+		
+		// From Aa mm pure males (genotype 6)
+		;
+		
+		// From aa MM inconstants (genotype 7)
+		next_f_aa_MM += f_aa_MM * S * (1 - d) * h * F;
+		
+		// From aa Mm inconstants (genotype 8)
+		next_f_aa_MM += f_aa_Mm * 0.25 * S * (1 - d) * h * F;
+		next_f_aa_Mm += f_aa_Mm * 0.5 * S * (1 - d) * h * F;
+		next_f_aa_mm += f_aa_Mm * 0.25 * S * (1 - d) * h * F;
+		
+		// From aa mm pure males (genotype 9)
+		;
+
+		// Apply YY penalty.................................................................
+		
+		next_f_aa_MM *= V;
+		next_f_aa_Mm *= V;
+		next_f_aa_mm *= V;
+		
+		// Copy.............................................................................
+		
+		f_AA_MM = next_f_AA_MM;
+		f_AA_Mm = next_f_AA_Mm;
+		f_AA_mm = next_f_AA_mm;
+		f_Aa_MM = next_f_Aa_MM;
+		f_Aa_Mm = next_f_Aa_Mm;
+		f_Aa_mm = next_f_Aa_mm;
+		f_aa_MM = next_f_aa_MM;
+		f_aa_Mm = next_f_aa_Mm;
+		f_aa_mm = next_f_aa_mm;
+	
+		// Normalise plant frequencies to add up to 1.......................................
+		
+		totalplants = f_AA_MM + f_AA_Mm + f_AA_mm + f_Aa_MM + f_Aa_Mm + f_Aa_mm + f_aa_MM + f_aa_Mm + f_aa_mm;
+		if (totalplants > 0)
+		{
+			f_AA_MM /= totalplants;
+			f_AA_Mm /= totalplants;
+			f_AA_mm /= totalplants;
+			f_Aa_MM /= totalplants;
+			f_Aa_Mm /= totalplants;
+			f_Aa_mm /= totalplants;
+			f_aa_MM /= totalplants;
+			f_aa_Mm /= totalplants;
+			f_aa_mm /= totalplants;
+		}
+	}
+	
+	// Calculate and save results...
+	
+	female = f_AA_MM + f_AA_Mm + f_AA_mm;
+	male = f_Aa_mm + f_aa_mm;
+	inconstant = f_Aa_MM + f_Aa_Mm + f_aa_MM + f_aa_Mm;
+	
+	if (male > threshold && female > threshold && inconstant > threshold)
+	{
+		regime = SSD;
+	} else if (male > threshold && female > threshold) {
+		regime = DIO;
+	} else if (female > threshold && inconstant > threshold) {
+		regime = PGD;
+	} else if (male > threshold && inconstant > threshold) {
+		regime = PAD;
+	} else if (inconstant > threshold) {
+		regime = INC;
+	} else {
+		regime = 0;
+	}
+	
+	f[0] = f_AA_MM;
+	f[1] = f_AA_Mm;
+	f[2] = f_AA_mm;
+	f[3] = f_Aa_MM;
+	f[4] = f_Aa_Mm;
+	f[5] = f_Aa_mm;
+	f[6] = f_aa_MM;
+	f[7] = f_aa_Mm;
+	f[8] = f_aa_mm;
+	
+	return regime;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+
+// Run frozen_runcell() with the processor's flush-to-zero (FTZ) and denormals-are-zero (DAZ) modes
+// off, as they were in the original program. They may have been turned on for the whole process,
+// either by --ftz or, without anything being said, by linking with -ffast-math (which brings in
+// crtfastmath.o). The modes belong to the thread, and are put back as they were afterwards.
+
+int frozen_reference (float Q, float F, float * f)
+{
+	int regime;
+	
+#if defined(__SSE__) || defined(_M_X64)
+	unsigned int csr = _mm_getcsr();
+	
+	_mm_setcsr(csr & ~0x8040);
+	regime = frozen_runcell(Q, F, f);
+	_mm_setcsr(csr);
+#else
+	regime = frozen_runcell(Q, F, f);
+#endif
+	
+	return regime;
+}
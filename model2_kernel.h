@@ -0,0 +1,1849 @@
+/*
+
+The built-in recursion for Model 2, for deterministic_model2.c.
+
+This file is included by deterministic_model2.c once for each floating point type. Before each
+inclusion, real is defined as the type, REAL_MIN as its smallest normal value, REAL_EPSILON as its
+machine epsilon, wide as the type that arithmetic between a real and a double constant is done in
+(double, unless real is long double), and KERNEL(name) as the name to give each function (e.g.
+KERNEL(simulate_generic) becomes simulate_generic_double). Parameters are always single precision, as
+given on the command line; genotype frequencies are passed in and out as doubles, but all the working
+is done in the chosen type.
+
+It is included once more with real defined as double complex and DERIVATIVES defined, for the
+derivatives of one generation (see KERNEL(generationjacobian) below, which is generationjacobian_dual()).
+Only the grid engine's generation is compiled then; its parameters are of type param (float, except in
+that instantiation), and each comparison is of VALUE(x), the real part.
+
+*/
+
+#ifdef DERIVATIVES
+#define param real
+#define shared const real *
+#define SHARED(x) ((x)[i])
+#define VALUE(x) creal(x)
+#define ABSORBING 0			// The absorbing state (and the extinction limit) would set the derivatives to 0
+#else
+#define param float
+#define shared float
+#define SHARED(x) (x)
+#define VALUE(x) (x)
+#define ABSORBING absorbing
+#endif
+
+#ifndef DERIVATIVES
+
+// Zero a genotype frequency that has fallen below the extinction limit, and note if it's subnormal
+// (which on most processors makes every sum involving it very slow).
+
+static ALWAYS_INLINE void KERNEL(guardfrequency) (real * frequency, real limit, int * flags)
+{
+	if (*frequency < limit) *frequency = 0;
+	if (*frequency > 0 && *frequency < REAL_MIN) *flags |= SUBNORMAL;
+}
+
+// Has a genotype frequency changed by more than the convergence tolerance in the last generation?
+// (Written without fabs(), which would lose anything too small for a double.)
+
+static ALWAYS_INLINE int KERNEL(moved) (real now, real before)
+{
+	return (now - before > tolerance || before - now > tolerance);
+}
+
+// Is a genotype frequency back within a given distance of a saved one? (For the cycle check.)
+
+static ALWAYS_INLINE int KERNEL(near) (real now, real before, real within)
+{
+	return (now - before <= within && before - now <= within);
+}
+
+// Run the built-in recursion for one combination of Q and F. On entry, f[] holds the start
+// frequencies of the 9 genotypes (in E&B order); on exit, it holds them after endpoint iterations.
+// Returns the number of generations until the frequencies converged (i.e. after which none
+// changed by more than the tolerance), or endpoint if they never did, or if --itermap and
+// --converge are both off (in which case this isn't checked). With --cycles, it stops at the
+// first repeated state instead, and a cycle is reported in flags (see CYCLE).
+//
+// This is only ever called by the simulate_...() functions below, which pass constants for the
+// parameters (and the limited and selfing flags) that are degenerate in the most common runs, so
+// that the compiler produces a separate copy with the unused terms removed (when optimising).
+
+static ALWAYS_INLINE int KERNEL(simulate_body) (double * f, float Q, float F, int * flags, float h, float S, float d, float V, float PSatF, const int limited, const int selfing)
+{
+	// Plant frequencies...
+	real f_AA_MM = f[0];
+	real f_AA_Mm = f[1];
+	real f_AA_mm = f[2];
+	real f_Aa_MM = f[3];
+	real f_Aa_Mm = f[4];
+	real f_Aa_mm = f[5];
+	real f_aa_MM = f[6];
+	real f_aa_Mm = f[7];
+	real f_aa_mm = f[8];
+	
+	real next_f_AA_MM;
+	real next_f_AA_Mm;
+	real next_f_AA_mm;
+	real next_f_Aa_MM;
+	real next_f_Aa_Mm;
+	real next_f_Aa_mm;
+	real next_f_aa_MM;
+	real next_f_aa_Mm;
+	real next_f_aa_mm;
+	
+	// Pollen frequencies...
+	real p_A_M;
+	real p_A_m;
+	real p_a_M;
+	real p_a_m;
+	
+	// Egg frequencies...
+	real e_A_M;
+	real e_A_m;
+	real e_a_M;
+	real e_a_m;
+	
+	real PSatC;				// Pollen saturation point for cosex receivers
+	
+	real totalpollen;
+	real totalplants;
+	
+	// Frequencies before this generation, for the convergence check...
+	real last_f_AA_MM;
+	real last_f_AA_Mm;
+	real last_f_AA_mm;
+	real last_f_Aa_MM;
+	real last_f_Aa_Mm;
+	real last_f_Aa_mm;
+	real last_f_aa_MM;
+	real last_f_aa_Mm;
+	real last_f_aa_mm;
+	
+	// For cycle detection (Brent's algorithm): a saved state to compare with, and the sums
+	// over one turn of the cycle, once found...
+	real tortoise_f_AA_MM = f[0];
+	real tortoise_f_AA_Mm = f[1];
+	real tortoise_f_AA_mm = f[2];
+	real tortoise_f_Aa_MM = f[3];
+	real tortoise_f_Aa_Mm = f[4];
+	real tortoise_f_Aa_mm = f[5];
+	real tortoise_f_aa_MM = f[6];
+	real tortoise_f_aa_Mm = f[7];
+	real tortoise_f_aa_mm = f[8];
+	real sum_f_AA_MM = 0;
+	real sum_f_AA_Mm = 0;
+	real sum_f_AA_mm = 0;
+	real sum_f_Aa_MM = 0;
+	real sum_f_Aa_Mm = 0;
+	real sum_f_Aa_mm = 0;
+	real sum_f_aa_MM = 0;
+	real sum_f_aa_Mm = 0;
+	real sum_f_aa_mm = 0;
+	int power = 1;
+	int lambda = 0;
+	int period = 0;
+	int averaging = 0;
+	int swung = 0;
+	int stopped = 0;
+	
+	int n;
+	int converged = 0;
+	
+	const int guarded = (extinction > 0 || countsubnormals);
+	const int tracked = (itermap || stopearly);
+	const int cycling = cycles;
+	
+	// A state counts as a repeat if no frequency is further than this from the saved one. With a
+	// tolerance of 0, that's a few units in the last place, as otherwise rounding that flips the
+	// last bit back and forth around a fixed point would be taken for a cycle...
+	const real repeat = tolerance > 0 ? tolerance : REPEATULPS * REAL_EPSILON;
+	
+	// For --trajectory: the next generation to record, if this run is being recorded (-1 if not)...
+	double snapshot[NGENOTYPES];
+	int record = recording ? 0 : -1;
+	
+	// For --popsize: this run's random number stream...
+	const int drifting = (popsize > 0);
+	struct rngstream stream;
+	
+	if (drifting) startstream(&stream, Q, F, f);
+	
+	for (n = 0; n < endpoint; n++)
+	{
+		// Record this generation's frequencies, if it's one that --trajectory wants.......
+		
+		if (n == record)
+		{
+			snapshot[0] = f_AA_MM;
+			snapshot[1] = f_AA_Mm;
+			snapshot[2] = f_AA_mm;
+			snapshot[3] = f_Aa_MM;
+			snapshot[4] = f_Aa_Mm;
+			snapshot[5] = f_Aa_mm;
+			snapshot[6] = f_aa_MM;
+			snapshot[7] = f_aa_Mm;
+			snapshot[8] = f_aa_mm;
+			record = recordstate(n, snapshot);
+		}
+		
+		// Outcrossed pollen frequencies....................................................
+		//
+		// Here we sum up the 4 types of pollen (containing the 4 possible allele combinations)
+		// from the various possible sources. We could do this in 4 equations (as in the paper)
+		// but it's simpler to consider each source in turn and add to the totals.
+		
+		p_A_M = 0;
+		p_A_m = 0;
+		p_a_M = 0;
+		p_a_m = 0;
+		
+		// From AA MM pure females (genotype 1)
+		;
+		
+		// From AA Mm pure females (genotype 2)
+		;
+		
+		// From AA mm pure females (genotype 3)
+		;
+		
+		// From Aa MM inconstants (genotype 4) as cosexes
+		p_A_M += f_Aa_MM * 0.5 * h * Q;
+		p_a_M += f_Aa_MM * 0.5 * h * Q;
+		
+		// From Aa MM inconstants (genotype 4) as males
+		p_A_M += f_Aa_MM * 0.5 * (1 - h);
+		p_a_M += f_Aa_MM * 0.5 * (1 - h);
+		
+		// From Aa Mm inconstants (genotype 5) as cosexes
+		p_A_M += f_Aa_Mm * 0.25 * h * Q;
+		p_A_m += f_Aa_Mm * 0.25 * h * Q;
+		p_a_M += f_Aa_Mm * 0.25 * h * Q;
+		p_a_m += f_Aa_Mm * 0.25 * h * Q;
+		
+		// From Aa Mm inconstants (genotype 5) as males
+		p_A_M += f_Aa_Mm * 0.25 * (1 - h);
+		p_A_m += f_Aa_Mm * 0.25 * (1 - h);
+		p_a_M += f_Aa_Mm * 0.25 * (1 - h);
+		p_a_m += f_Aa_Mm * 0.25 * (1 - h);
+		
+		// From Aa mm pure males (genotype 6)
+		p_A_m += f_Aa_mm * 0.5;
+		p_a_m += f_Aa_mm * 0.5;
+		
+		// From aa MM inconstants (genotype 7) as cosexes
+		p_a_M += f_aa_MM * h * Q;
+		
+		// From aa MM inconstants (genotype 7) as males
+		p_a_M += f_aa_MM * (1 - h);
+		
+		// From aa Mm inconstants (genotype 8) as cosexes
+		p_a_M += f_aa_Mm * 0.5 * h * Q;
+		p_a_m += f_aa_Mm * 0.5 * h * Q;
+		
+		// From aa Mm inconstants (genotype 8) as males
+		p_a_M += f_aa_Mm * 0.5 * (1 - h);
+		p_a_m += f_aa_Mm * 0.5 * (1 - h);
+		
+		// From aa mm pure males (genotype 9)
+		p_a_m += f_aa_mm;
+		
+		// Normalise pollen frequencies to add up to 1......................................
+		
+		totalpollen = p_A_M + p_A_m + p_a_M + p_a_m;
+		if (totalpollen > 0)
+		{
+			p_A_M /= totalpollen;
+			p_A_m /= totalpollen;
+			p_a_M /= totalpollen;
+			p_a_m /= totalpollen;
+		}
+		
+		// Outcrossed egg frequencies.......................................................
+		
+		// Calculate pollen required to fertilise a cosex's outcrossing ovules:
+		PSatC = PSatF * F * (1 - S);
+		
+		e_A_M = 0;
+		e_A_m = 0;
+		e_a_M = 0;
+		e_a_m = 0;
+		
+		// From AA MM pure females (genotype 1)
+		if (limited == 0 || totalpollen >= PSatF)
+		{
+			e_A_M += f_AA_MM;
+		} else {
+			e_A_M += f_AA_MM * totalpollen / PSatF;
+		}
+		
+		// From AA Mm pure females (genotype 2)
+		if (limited == 0 || totalpollen >= PSatF)
+		{
+			e_A_M += f_AA_Mm * 0.5;
+			e_A_m += f_AA_Mm * 0.5;
+		} else {
+			e_A_M += f_AA_Mm * 0.5 * totalpollen / PSatF;
+			e_A_m += f_AA_Mm * 0.5 * totalpollen / PSatF;
+		}
+		
+		// From AA mm pure females (genotype 3)
+		if (limited == 0 || totalpollen >= PSatF)
+		{
+			e_A_m += f_AA_mm;
+		} else {
+			e_A_m += f_AA_mm * totalpollen / PSatF;
+		}
+		
+		// From Aa MM inconstants (genotype 4) as cosexes
+		if (limited == 0 || totalpollen >= PSatC)
+		{
+			e_A_M += f_Aa_MM * h * 0.5 * (1 - S) * F;
+			e_a_M += f_Aa_MM * h * 0.5 * (1 - S) * F;
+		} else {
+			e_A_M += f_Aa_MM * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+			e_a_M += f_Aa_MM * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+		}
+		
+		// From Aa Mm inconstants (genotype 5) as cosexes
+		if (limited == 0 || totalpollen >= PSatC)
+		{
+			e_A_M += f_Aa_Mm * h * 0.25 * (1 - S) * F;
+			e_A_m += f_Aa_Mm * h * 0.25 * (1 - S) * F;
+			e_a_M += f_Aa_Mm * h * 0.25 * (1 - S) * F;
+			e_a_m += f_Aa_Mm * h * 0.25 * (1 - S) * F;
+		} else {
+			e_A_M += f_Aa_Mm * h * 0.25 * (1 - S) * F * totalpollen / PSatC;
+			e_A_m += f_Aa_Mm * h * 0.25 * (1 - S) * F * totalpollen / PSatC;
+			e_a_M += f_Aa_Mm * h * 0.25 * (1 - S) * F * totalpollen / PSatC;
+			e_a_m += f_Aa_Mm * h * 0.25 * (1 - S) * F * totalpollen / PSatC;
+		}
+		
+		// From Aa mm pure males (genotype 6)
+		;
+		
+		// From aa MM inconstants (genotype 7) as cosexes
+		if (limited == 0 || totalpollen >= PSatC)
+		{
+			e_a_M += f_aa_MM * h * (1 - S) * F;
+		} else {
+			e_a_M += f_aa_MM * h * (1 - S) * F * totalpollen / PSatC;
+		}
+		
+		// From aa Mm inconstants (genotype 8) as cosexes
+		if (limited == 0 || totalpollen >= PSatC)
+		{
+			e_a_M += f_aa_Mm * h * 0.5 * (1 - S) * F;
+			e_a_m += f_aa_Mm * h * 0.5 * (1 - S) * F;
+		} else {
+			e_a_M += f_aa_Mm * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+			e_a_m += f_aa_Mm * h * 0.5 * (1 - S) * F * totalpollen / PSatC;
+		}
+		
+		// From aa mm pure males (genotype 9)
+		;
+		
+		// WE CANNOT AND MUST NOT NORMALISE THE EGG FREQUENCIES, AS WE HAVEN'T
+		// YET CONSIDERED THE SELFED EGGS. BUT WE DON'T NEED TO NORMALISE.
+		
+		// Plant frequencies from outcrossing...............................................
+		
+		next_f_AA_MM = p_A_M * e_A_M;
+		next_f_AA_Mm = p_A_M * e_A_m + p_A_m * e_A_M;
+		next_f_AA_mm = p_A_m * e_A_m;
+		next_f_Aa_MM = p_A_M * e_a_M + p_a_M * e_A_M;
+		next_f_Aa_Mm = p_A_M * e_a_m + p_A_m * e_a_M + p_a_M * e_A_m + p_a_m * e_A_M;
+		next_f_Aa_mm = p_A_m * e_a_m + p_a_m * e_A_m;
+		next_f_aa_MM = p_a_M * e_a_M;
+		next_f_aa_Mm = p_a_M * e_a_m + p_a_m * e_a_M;
+		next_f_aa_mm = p_a_m * e_a_m;
+		
+		// Additional plants from selfing...................................................
+		
+		if (selfing)
+		{
+			// From AA MM pure females (genotype 1)
+			;
+			
+			// From AA Mm pure females (genotype 2)
+			;
+			
+			// From AA mm pure females (genotype 3)
+			;
+			
+			// From Aa MM inconstants (genotype 4)
+			next_f_AA_MM += f_Aa_MM * 0.25 * S * (1 - d) * h * F;
+			next_f_Aa_MM += f_Aa_MM * 0.5 * S * (1 - d) * h * F;
+			next_f_aa_MM += f_Aa_MM * 0.25 * S * (1 - d) * h * F;
+			
+			// From Aa Mm inconstants (genotype 5)
+			next_f_AA_MM += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+			next_f_AA_Mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+			next_f_AA_mm += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+			next_f_Aa_MM += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+			next_f_Aa_Mm += f_Aa_Mm * 0.25 * S * (1 - d) * h * F;
+			next_f_Aa_mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+			next_f_aa_MM += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+			next_f_aa_Mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+			next_f_aa_mm += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+			
+			// From Aa mm pure males (genotype 6)
+			;
+			
+			// From aa MM inconstants (genotype 7)
+			next_f_aa_MM += f_aa_MM * S * (1 - d) * h * F;
+			
+			// From aa Mm inconstants (genotype 8)
+			next_f_aa_MM += f_aa_Mm * 0.25 * S * (1 - d) * h * F;
+			next_f_aa_Mm += f_aa_Mm * 0.5 * S * (1 - d) * h * F;
+			next_f_aa_mm += f_aa_Mm * 0.25 * S * (1 - d) * h * F;
+			
+			// From aa mm pure males (genotype 9)
+			;
+		}
+		
+		// Apply YY penalty.................................................................
+		
+		next_f_aa_MM *= V;
+		next_f_aa_Mm *= V;
+		next_f_aa_mm *= V;
+		
+		last_f_AA_MM = f_AA_MM;
+		last_f_AA_Mm = f_AA_Mm;
+		last_f_AA_mm = f_AA_mm;
+		last_f_Aa_MM = f_Aa_MM;
+		last_f_Aa_Mm = f_Aa_Mm;
+		last_f_Aa_mm = f_Aa_mm;
+		last_f_aa_MM = f_aa_MM;
+		last_f_aa_Mm = f_aa_Mm;
+		last_f_aa_mm = f_aa_mm;
+		
+		// Copy.............................................................................
+		
+		f_AA_MM = next_f_AA_MM;
+		f_AA_Mm = next_f_AA_Mm;
+		f_AA_mm = next_f_AA_mm;
+		f_Aa_MM = next_f_Aa_MM;
+		f_Aa_Mm = next_f_Aa_Mm;
+		f_Aa_mm = next_f_Aa_mm;
+		f_aa_MM = next_f_aa_MM;
+		f_aa_Mm = next_f_aa_Mm;
+		f_aa_mm = next_f_aa_mm;
+	
+		// Normalise plant frequencies to add up to 1.......................................
+		
+		totalplants = f_AA_MM + f_AA_Mm + f_AA_mm + f_Aa_MM + f_Aa_Mm + f_Aa_mm + f_aa_MM + f_aa_Mm + f_aa_mm;
+		if (totalplants > 0)
+		{
+			f_AA_MM /= totalplants;
+			f_AA_Mm /= totalplants;
+			f_AA_mm /= totalplants;
+			f_Aa_MM /= totalplants;
+			f_Aa_Mm /= totalplants;
+			f_Aa_mm /= totalplants;
+			f_aa_MM /= totalplants;
+			f_aa_Mm /= totalplants;
+			f_aa_mm /= totalplants;
+		}
+		
+		// Extinction clamp and check for subnormals, if wanted......................................
+		
+		if (guarded)
+		{
+			KERNEL(guardfrequency)(&f_AA_MM, extinction, flags);
+			KERNEL(guardfrequency)(&f_AA_Mm, extinction, flags);
+			KERNEL(guardfrequency)(&f_AA_mm, extinction, flags);
+			KERNEL(guardfrequency)(&f_Aa_MM, extinction, flags);
+			KERNEL(guardfrequency)(&f_Aa_Mm, extinction, flags);
+			KERNEL(guardfrequency)(&f_Aa_mm, extinction, flags);
+			KERNEL(guardfrequency)(&f_aa_MM, extinction, flags);
+			KERNEL(guardfrequency)(&f_aa_Mm, extinction, flags);
+			KERNEL(guardfrequency)(&f_aa_mm, extinction, flags);
+		}
+		
+		// Genetic drift, with --popsize: the frequencies just worked out are only the expected ones,
+		// and the plants of the next generation are a sample of popsize from them..................
+		
+		if (drifting)
+		{
+			snapshot[0] = f_AA_MM;
+			snapshot[1] = f_AA_Mm;
+			snapshot[2] = f_AA_mm;
+			snapshot[3] = f_Aa_MM;
+			snapshot[4] = f_Aa_Mm;
+			snapshot[5] = f_Aa_mm;
+			snapshot[6] = f_aa_MM;
+			snapshot[7] = f_aa_Mm;
+			snapshot[8] = f_aa_mm;
+			drawgeneration(snapshot, &stream);
+			f_AA_MM = snapshot[0];
+			f_AA_Mm = snapshot[1];
+			f_AA_mm = snapshot[2];
+			f_Aa_MM = snapshot[3];
+			f_Aa_Mm = snapshot[4];
+			f_Aa_mm = snapshot[5];
+			f_aa_MM = snapshot[6];
+			f_aa_Mm = snapshot[7];
+			f_aa_mm = snapshot[8];
+		}
+		
+		// Absorbing state: once every genotype carrying M has gone (exactly, e.g. through --extinction),
+		// no inconstants can ever be produced again, and this is an ordinary dioecious population,
+		// which within two generations reaches AA mm : Aa mm = 1 : 1 (aa mm having no mothers), and
+		// stays there. So go straight there (as long as there are females and Aa mm males; without
+		// Aa mm males, there would be no females in the next generation)...
+		
+		if (absorbing && f_AA_MM == 0 && f_AA_Mm == 0 && f_Aa_MM == 0 && f_Aa_Mm == 0 && f_aa_MM == 0 && f_aa_Mm == 0
+		 && f_AA_mm > 0 && f_Aa_mm > 0)
+		{
+			f_AA_mm = 0.5;
+			f_Aa_mm = 0.5;
+			f_aa_mm = 0;
+			stopped = n + 1;
+			break;
+		}
+		
+		// Convergence check, if wanted: note the last generation in which anything moved, and
+		// (for --converge) stop at the first in which nothing did.........................
+		
+		if (tracked)
+		{
+			if (KERNEL(moved)(f_AA_MM, last_f_AA_MM)
+			 || KERNEL(moved)(f_AA_Mm, last_f_AA_Mm)
+			 || KERNEL(moved)(f_AA_mm, last_f_AA_mm)
+			 || KERNEL(moved)(f_Aa_MM, last_f_Aa_MM)
+			 || KERNEL(moved)(f_Aa_Mm, last_f_Aa_Mm)
+			 || KERNEL(moved)(f_Aa_mm, last_f_Aa_mm)
+			 || KERNEL(moved)(f_aa_MM, last_f_aa_MM)
+			 || KERNEL(moved)(f_aa_Mm, last_f_aa_Mm)
+			 || KERNEL(moved)(f_aa_mm, last_f_aa_mm))
+			{
+				converged = n + 1;
+			} else if (stopearly) {
+				break;
+			}
+		}
+		
+		// Cycle detection, if wanted (Brent's algorithm). Once a cycle has been found, the
+		// frequencies are averaged over one more turn of it, and the average is the result (it's only
+		// reported as a cycle if some state in that turn strays further than repeat from the saved one)...
+		
+		if (cycling)
+		{
+			if (period)
+			{
+				sum_f_AA_MM += f_AA_MM;
+				sum_f_AA_Mm += f_AA_Mm;
+				sum_f_AA_mm += f_AA_mm;
+				sum_f_Aa_MM += f_Aa_MM;
+				sum_f_Aa_Mm += f_Aa_Mm;
+				sum_f_Aa_mm += f_Aa_mm;
+				sum_f_aa_MM += f_aa_MM;
+				sum_f_aa_Mm += f_aa_Mm;
+				sum_f_aa_mm += f_aa_mm;
+				if (!swung
+				 && !(KERNEL(near)(f_AA_MM, tortoise_f_AA_MM, repeat)
+				 && KERNEL(near)(f_AA_Mm, tortoise_f_AA_Mm, repeat)
+				 && KERNEL(near)(f_AA_mm, tortoise_f_AA_mm, repeat)
+				 && KERNEL(near)(f_Aa_MM, tortoise_f_Aa_MM, repeat)
+				 && KERNEL(near)(f_Aa_Mm, tortoise_f_Aa_Mm, repeat)
+				 && KERNEL(near)(f_Aa_mm, tortoise_f_Aa_mm, repeat)
+				 && KERNEL(near)(f_aa_MM, tortoise_f_aa_MM, repeat)
+				 && KERNEL(near)(f_aa_Mm, tortoise_f_aa_Mm, repeat)
+				 && KERNEL(near)(f_aa_mm, tortoise_f_aa_mm, repeat)))
+				{
+					swung = 1;
+				}
+				if (--averaging == 0) break;
+			} else {
+				lambda++;
+				if (KERNEL(near)(f_AA_MM, tortoise_f_AA_MM, repeat)
+				 && KERNEL(near)(f_AA_Mm, tortoise_f_AA_Mm, repeat)
+				 && KERNEL(near)(f_AA_mm, tortoise_f_AA_mm, repeat)
+				 && KERNEL(near)(f_Aa_MM, tortoise_f_Aa_MM, repeat)
+				 && KERNEL(near)(f_Aa_Mm, tortoise_f_Aa_Mm, repeat)
+				 && KERNEL(near)(f_Aa_mm, tortoise_f_Aa_mm, repeat)
+				 && KERNEL(near)(f_aa_MM, tortoise_f_aa_MM, repeat)
+				 && KERNEL(near)(f_aa_Mm, tortoise_f_aa_Mm, repeat)
+				 && KERNEL(near)(f_aa_mm, tortoise_f_aa_mm, repeat))
+				{
+					period = lambda;
+					stopped = n + 1;
+					if (period == 1) break;		// A fixed point
+					averaging = period;
+				} else if (lambda == power) {
+					tortoise_f_AA_MM = f_AA_MM;
+					tortoise_f_AA_Mm = f_AA_Mm;
+					tortoise_f_AA_mm = f_AA_mm;
+					tortoise_f_Aa_MM = f_Aa_MM;
+					tortoise_f_Aa_Mm = f_Aa_Mm;
+					tortoise_f_Aa_mm = f_Aa_mm;
+					tortoise_f_aa_MM = f_aa_MM;
+					tortoise_f_aa_Mm = f_aa_Mm;
+					tortoise_f_aa_mm = f_aa_mm;
+					power *= 2;
+					lambda = 0;
+				}
+			}
+		}
+	}
+	
+	if (period > 1 && averaging == 0)
+	{
+		f_AA_MM = sum_f_AA_MM / period;
+		f_AA_Mm = sum_f_AA_Mm / period;
+		f_AA_mm = sum_f_AA_mm / period;
+		f_Aa_MM = sum_f_Aa_MM / period;
+		f_Aa_Mm = sum_f_Aa_Mm / period;
+		f_Aa_mm = sum_f_Aa_mm / period;
+		f_aa_MM = sum_f_aa_MM / period;
+		f_aa_Mm = sum_f_aa_Mm / period;
+		f_aa_mm = sum_f_aa_mm / period;
+		if (swung) *flags |= CYCLE | (period << PERIODSHIFT);
+		else *flags |= (1 << PERIODSHIFT);		// Never strayed further than repeat, so really a fixed point
+	} else if (period == 1) {
+		*flags |= (1 << PERIODSHIFT);		// A fixed point
+	}
+	
+	f[0] = f_AA_MM;
+	f[1] = f_AA_Mm;
+	f[2] = f_AA_mm;
+	f[3] = f_Aa_MM;
+	f[4] = f_Aa_Mm;
+	f[5] = f_Aa_mm;
+	f[6] = f_aa_MM;
+	f[7] = f_aa_Mm;
+	f[8] = f_aa_mm;
+	
+	// ...and the final frequencies (after the generation in which it stopped, if it stopped early)
+	
+	if (record >= 0) recordstate(n < endpoint ? n + 1 : n, f);
+	
+	return stopped ? stopped : (tracked ? converged : endpoint);
+}
+
+// A rearrangement of the recursion for --lazynorm. The divisions are replaced by a single reciprocal
+// per generation, coefficients that don't change are worked out once, and the plant frequencies are
+// only renormalised every lazynorm generations. This is allowed because the update is homogeneous
+// in the plant frequencies; the only places where their absolute scale matters are the PSatF and
+// PSatC comparisons, which here are made against pollen per plant. The results agree with the
+// exact recursion to within rounding error, which is measured and reported (see comparecell() in the main program).
+
+int KERNEL(simulate_lazy) (double * f, float Q, float F, int * flags)
+{
+	// Plant frequencies (not necessarily adding up to 1)...
+	real f_AA_MM = f[0];
+	real f_AA_Mm = f[1];
+	real f_AA_mm = f[2];
+	real f_Aa_MM = f[3];
+	real f_Aa_Mm = f[4];
+	real f_Aa_mm = f[5];
+	real f_aa_MM = f[6];
+	real f_aa_Mm = f[7];
+	real f_aa_mm = f[8];
+	
+	real next_f_AA_MM;
+	real next_f_AA_Mm;
+	real next_f_AA_mm;
+	real next_f_Aa_MM;
+	real next_f_Aa_Mm;
+	real next_f_Aa_mm;
+	real next_f_aa_MM;
+	real next_f_aa_Mm;
+	real next_f_aa_mm;
+	
+	// Pollen and egg production (not normalised)...
+	real p_A_M;
+	real p_A_m;
+	real p_a_M;
+	real p_a_m;
+	real e_A_M;
+	real e_A_m;
+	real e_a_M;
+	real e_a_m;
+	
+	real limitF;				// Proportion of a female's ovules that are fertilised
+	real limitC;				// Proportion of a cosex's outcrossing ovules that are fertilised
+	real reciprocal;
+	real totalpollen;
+	real totalplants;
+	real ratio;
+	int countdown = lazynorm;
+	int stopped = 0;
+	int n;
+	
+	const int guarded = (extinction > 0 || countsubnormals);
+	
+	// Contributions that don't change from one generation to the next...
+	
+	real inconstantpollen = h * Q + (1 - h);							// Pollen, as cosex and as male
+	real inconstanteggs = h * (1 - S) * F;								// Outcrossed eggs, as cosex
+	real selfed = S * (1 - d) * h * F;									// Selfed offspring
+	real PSatC = PSatF * F * (1 - S);
+	real PSatratio = (PSatC > 0) ? PSatF / PSatC : 0;
+	
+	totalplants = f_AA_MM + f_AA_Mm + f_AA_mm + f_Aa_MM + f_Aa_Mm + f_Aa_mm + f_aa_MM + f_aa_Mm + f_aa_mm;
+	
+	for (n = 0; n < endpoint; n++)
+	{
+		// Outcrossed pollen...
+		
+		p_A_M = (f_Aa_MM * 0.5 + f_Aa_Mm * 0.25) * inconstantpollen;
+		p_A_m = f_Aa_Mm * 0.25 * inconstantpollen + f_Aa_mm * 0.5;
+		p_a_M = (f_Aa_MM * 0.5 + f_Aa_Mm * 0.25 + f_aa_MM + f_aa_Mm * 0.5) * inconstantpollen;
+		p_a_m = (f_Aa_Mm * 0.25 + f_aa_Mm * 0.5) * inconstantpollen + f_Aa_mm * 0.5 + f_aa_mm;
+		
+		totalpollen = p_A_M + p_A_m + p_a_M + p_a_m;
+		
+		// Pollen limitation. One reciprocal gives both 1 / totalpollen (to normalise the pollen) and
+		// pollen per plant, relative to PSatF...
+		
+		limitF = 1;
+		limitC = 1;
+		reciprocal = 1;
+		
+		if (PSatF > 0 && totalpollen > 0)
+		{
+			reciprocal = 1 / (totalpollen * PSatF * totalplants);
+			ratio = totalpollen * totalpollen * reciprocal;
+			reciprocal *= PSatF * totalplants;
+			
+			if (ratio < 1) limitF = ratio;
+			if (PSatC > 0 && ratio * PSatratio < 1) limitC = ratio * PSatratio;
+		} else if (totalpollen > 0) {
+			reciprocal = 1 / totalpollen;
+		} else if (PSatF > 0) {
+			limitF = 0;
+			if (PSatC > 0) limitC = 0;
+		}
+		
+		// Outcrossed eggs, with the pollen normalisation folded in...
+		
+		limitF *= reciprocal;
+		limitC *= inconstanteggs * reciprocal;
+		
+		e_A_M = (f_AA_MM + f_AA_Mm * 0.5) * limitF + (f_Aa_MM * 0.5 + f_Aa_Mm * 0.25) * limitC;
+		e_A_m = (f_AA_Mm * 0.5 + f_AA_mm) * limitF + f_Aa_Mm * 0.25 * limitC;
+		e_a_M = (f_Aa_MM * 0.5 + f_Aa_Mm * 0.25 + f_aa_MM + f_aa_Mm * 0.5) * limitC;
+		e_a_m = (f_Aa_Mm * 0.25 + f_aa_Mm * 0.5) * limitC;
+		
+		// Plant frequencies from outcrossing...
+		
+		next_f_AA_MM = p_A_M * e_A_M;
+		next_f_AA_Mm = p_A_M * e_A_m + p_A_m * e_A_M;
+		next_f_AA_mm = p_A_m * e_A_m;
+		next_f_Aa_MM = p_A_M * e_a_M + p_a_M * e_A_M;
+		next_f_Aa_Mm = p_A_M * e_a_m + p_A_m * e_a_M + p_a_M * e_A_m + p_a_m * e_A_M;
+		next_f_Aa_mm = p_A_m * e_a_m + p_a_m * e_A_m;
+		next_f_aa_MM = p_a_M * e_a_M;
+		next_f_aa_Mm = p_a_M * e_a_m + p_a_m * e_a_M;
+		next_f_aa_mm = p_a_m * e_a_m;
+		
+		// ...and from selfing (by Aa MM, Aa Mm, aa MM and aa Mm inconstants)...
+		
+		if (selfed > 0)
+		{
+			next_f_AA_MM += (f_Aa_MM * 0.25 + f_Aa_Mm * 0.0625) * selfed;
+			next_f_AA_Mm += f_Aa_Mm * 0.125 * selfed;
+			next_f_AA_mm += f_Aa_Mm * 0.0625 * selfed;
+			next_f_Aa_MM += (f_Aa_MM * 0.5 + f_Aa_Mm * 0.125) * selfed;
+			next_f_Aa_Mm += f_Aa_Mm * 0.25 * selfed;
+			next_f_Aa_mm += f_Aa_Mm * 0.125 * selfed;
+			next_f_aa_MM += (f_Aa_MM * 0.25 + f_Aa_Mm * 0.0625 + f_aa_MM + f_aa_Mm * 0.25) * selfed;
+			next_f_aa_Mm += (f_Aa_Mm * 0.125 + f_aa_Mm * 0.5) * selfed;
+			next_f_aa_mm += (f_Aa_Mm * 0.0625 + f_aa_Mm * 0.25) * selfed;
+		}
+		
+		// YY penalty, and copy...
+		
+		f_AA_MM = next_f_AA_MM;
+		f_AA_Mm = next_f_AA_Mm;
+		f_AA_mm = next_f_AA_mm;
+		f_Aa_MM = next_f_Aa_MM;
+		f_Aa_Mm = next_f_Aa_Mm;
+		f_Aa_mm = next_f_Aa_mm;
+		f_aa_MM = next_f_aa_MM * V;
+		f_aa_Mm = next_f_aa_Mm * V;
+		f_aa_mm = next_f_aa_mm * V;
+		
+		// Renormalise every lazynorm generations (and at the end), or sooner if the total is
+		// drifting towards overflow or underflow...
+		
+		totalplants = f_AA_MM + f_AA_Mm + f_AA_mm + f_Aa_MM + f_Aa_Mm + f_Aa_mm + f_aa_MM + f_aa_Mm + f_aa_mm;
+		countdown--;
+		if (countdown == 0 || n == endpoint - 1 || totalplants > LAZYMAX || totalplants < LAZYMIN)
+		{
+			countdown = lazynorm;
+			if (totalplants > 0)
+			{
+				reciprocal = 1 / totalplants;
+				f_AA_MM *= reciprocal;
+				f_AA_Mm *= reciprocal;
+				f_AA_mm *= reciprocal;
+				f_Aa_MM *= reciprocal;
+				f_Aa_Mm *= reciprocal;
+				f_Aa_mm *= reciprocal;
+				f_aa_MM *= reciprocal;
+				f_aa_Mm *= reciprocal;
+				f_aa_mm *= reciprocal;
+				totalplants = 1;
+			}
+		}
+		
+		// Extinction clamp (relative to the current total) and check for subnormals, if wanted...
+		
+		if (guarded)
+		{
+			KERNEL(guardfrequency)(&f_AA_MM, extinction * totalplants, flags);
+			KERNEL(guardfrequency)(&f_AA_Mm, extinction * totalplants, flags);
+			KERNEL(guardfrequency)(&f_AA_mm, extinction * totalplants, flags);
+			KERNEL(guardfrequency)(&f_Aa_MM, extinction * totalplants, flags);
+			KERNEL(guardfrequency)(&f_Aa_Mm, extinction * totalplants, flags);
+			KERNEL(guardfrequency)(&f_Aa_mm, extinction * totalplants, flags);
+			KERNEL(guardfrequency)(&f_aa_MM, extinction * totalplants, flags);
+			KERNEL(guardfrequency)(&f_aa_Mm, extinction * totalplants, flags);
+			KERNEL(guardfrequency)(&f_aa_mm, extinction * totalplants, flags);
+		}
+		
+		// Absorbing state: once every genotype carrying M has gone (exactly, e.g. through --extinction),
+		// no inconstants can ever be produced again, and this is an ordinary dioecious population,
+		// which within two generations reaches AA mm : Aa mm = 1 : 1 (aa mm having no mothers), and
+		// stays there. So go straight there (as long as there are females and Aa mm males; without
+		// Aa mm males, there would be no females in the next generation)...
+		
+		if (absorbing && f_AA_MM == 0 && f_AA_Mm == 0 && f_Aa_MM == 0 && f_Aa_Mm == 0 && f_aa_MM == 0 && f_aa_Mm == 0
+		 && f_AA_mm > 0 && f_Aa_mm > 0)
+		{
+			f_AA_mm = 0.5;
+			f_Aa_mm = 0.5;
+			f_aa_mm = 0;
+			stopped = n + 1;
+			break;
+		}
+	}
+	
+	f[0] = f_AA_MM;
+	f[1] = f_AA_Mm;
+	f[2] = f_AA_mm;
+	f[3] = f_Aa_MM;
+	f[4] = f_Aa_Mm;
+	f[5] = f_Aa_mm;
+	f[6] = f_aa_MM;
+	f[7] = f_aa_Mm;
+	f[8] = f_aa_mm;
+	
+	return stopped ? stopped : endpoint;
+}
+
+// The specialisations. The names say what has been removed: pollen limitation (PSatF = 0)
+// and selfing (S = 0).
+
+int KERNEL(simulate_generic) (double * f, float Q, float F, int * flags) { return KERNEL(simulate_body)(f, Q, F, flags, h, S, d, V, PSatF, 1, 1); }
+int KERNEL(simulate_nolimit) (double * f, float Q, float F, int * flags) { return KERNEL(simulate_body)(f, Q, F, flags, h, S, d, V, 0, 0, 1); }
+int KERNEL(simulate_noself) (double * f, float Q, float F, int * flags) { return KERNEL(simulate_body)(f, Q, F, flags, h, 0, d, V, PSatF, 1, 0); }
+int KERNEL(simulate_nolimit_noself) (double * f, float Q, float F, int * flags) { return KERNEL(simulate_body)(f, Q, F, flags, h, 0, d, V, 0, 0, 0); }
+
+// For --area and --sensitivity, which vary the other parameters as well as Q and F: h, S, d, V and
+// PSatF (in that order, followed by ppY, which isn't used here) are taken from parameters[] instead
+// of the globals, so that points with different parameters can be run at the same time.
+
+int KERNEL(simulate_parameters) (double * f, float Q, float F, int * flags, const float * parameters)
+{
+	return KERNEL(simulate_body)(f, Q, F, flags, parameters[0], parameters[1], parameters[2], parameters[3], parameters[4], 1, 1);
+}
+
+// Pick the specialisation for the current parameters, and say which it is.
+
+simulate_function KERNEL(specialise) (const char ** description)
+{
+	int nolimit = (PSatF == 0);
+	int noself = (S == 0);
+	
+	if (nolimit && noself)	{ *description = "no pollen limitation, no selfing";	return KERNEL(simulate_nolimit_noself); }
+	else if (nolimit)	{ *description = "no pollen limitation";	return KERNEL(simulate_nolimit); }
+	else if (noself)	{ *description = "no selfing";	return KERNEL(simulate_noself); }
+	else	{ *description = "generic";	return KERNEL(simulate_generic); }
+}
+
+#endif
+
+// THE GRID ENGINE (--engine grid)...
+//
+// One generation of the recursion for every live cell of a tile. The frequencies of each genotype
+// are held in their own array (g_AA_MM[] etc., one element per cell), as are Q and F, so this is a
+// single loop over the cells that the compiler can vectorise (at -O3, or -O2 -ftree-vectorize).
+// The arithmetic is exactly that of simulate_body(), but written without branches: both sides of
+// each pollen limitation test are worked out and one is chosen (keeping the type each expression
+// has there, hence wide), and a division by the total is replaced by a division by 1 when the total
+// is zero. The results are therefore bit-identical. The other parameters are the same for every
+// cell, except in the dual number instantiation, where they're arrays like Q and F (see
+// generationjacobian_dual()).
+
+static ALWAYS_INLINE void KERNEL(advancetile_body) (real * restrict g_AA_MM, real * restrict g_AA_Mm, real * restrict g_AA_mm,
+	real * restrict g_Aa_MM, real * restrict g_Aa_Mm, real * restrict g_Aa_mm, real * restrict g_aa_MM, real * restrict g_aa_Mm, real * restrict g_aa_mm,
+	const param * restrict Qs, const param * restrict Fs, int live, shared hs, shared Ss, shared ds, shared Vs, shared PSatFs, const int limited, const int selfing)
+{
+#ifdef DERIVATIVES
+	const int guarded = 0;			// The derivatives are of the recursion itself, without the extinction limit
+#else
+	const int guarded = (extinction > 0);
+#endif
+	const real absorbed = 0.5;		// The absorbing state's AA mm and Aa mm
+	int i;
+	
+	for (i = 0; i < live; i++)
+	{
+		real f_AA_MM = g_AA_MM[i];
+		real f_AA_Mm = g_AA_Mm[i];
+		real f_AA_mm = g_AA_mm[i];
+		real f_Aa_MM = g_Aa_MM[i];
+		real f_Aa_Mm = g_Aa_Mm[i];
+		real f_Aa_mm = g_Aa_mm[i];
+		real f_aa_MM = g_aa_MM[i];
+		real f_aa_Mm = g_aa_Mm[i];
+		real f_aa_mm = g_aa_mm[i];
+		const param Q = Qs[i];
+		const param F = Fs[i];
+		const param h = SHARED(hs);
+		const param S = SHARED(Ss);
+		const param d = SHARED(ds);
+		const param V = SHARED(Vs);
+		const param PSatF = SHARED(PSatFs);
+		
+		real next_f_AA_MM;
+		real next_f_AA_Mm;
+		real next_f_AA_mm;
+		real next_f_Aa_MM;
+		real next_f_Aa_Mm;
+		real next_f_Aa_mm;
+		real next_f_aa_MM;
+		real next_f_aa_Mm;
+		real next_f_aa_mm;
+		real p_A_M;
+		real p_A_m;
+		real p_a_M;
+		real p_a_m;
+		real e_A_M;
+		real e_A_m;
+		real e_a_M;
+		real e_a_m;
+		real PSatC;
+		real totalpollen;
+		real totalplants;
+		real divisor;
+		int saturatedF;
+		int saturatedC;
+		int dioecious;
+		wide ovules_AA_Mm;			// Outcrossed eggs from each female (where not just f) and inconstant,
+		wide ovules_Aa_MM;			// without pollen limitation...
+		wide ovules_Aa_Mm;
+		real ovules_aa_MM;
+		wide ovules_aa_Mm;
+		real limited_AA_MM;			// ...and with it (worked out whether or not it applies)
+		wide limited_AA_Mm;
+		real limited_AA_mm;
+		wide limited_Aa_MM;
+		wide limited_Aa_Mm;
+		real limited_aa_MM;
+		wide limited_aa_Mm;
+		
+		// Outcrossed pollen frequencies...
+		
+		p_A_M = 0;
+		p_A_m = 0;
+		p_a_M = 0;
+		p_a_m = 0;
+		
+		p_A_M += f_Aa_MM * 0.5 * h * Q;
+		p_a_M += f_Aa_MM * 0.5 * h * Q;
+		
+		p_A_M += f_Aa_MM * 0.5 * (1 - h);
+		p_a_M += f_Aa_MM * 0.5 * (1 - h);
+		
+		p_A_M += f_Aa_Mm * 0.25 * h * Q;
+		p_A_m += f_Aa_Mm * 0.25 * h * Q;
+		p_a_M += f_Aa_Mm * 0.25 * h * Q;
+		p_a_m += f_Aa_Mm * 0.25 * h * Q;
+		
+		p_A_M += f_Aa_Mm * 0.25 * (1 - h);
+		p_A_m += f_Aa_Mm * 0.25 * (1 - h);
+		p_a_M += f_Aa_Mm * 0.25 * (1 - h);
+		p_a_m += f_Aa_Mm * 0.25 * (1 - h);
+		
+		p_A_m += f_Aa_mm * 0.5;
+		p_a_m += f_Aa_mm * 0.5;
+		
+		p_a_M += f_aa_MM * h * Q;
+		
+		p_a_M += f_aa_MM * (1 - h);
+		
+		p_a_M += f_aa_Mm * 0.5 * h * Q;
+		p_a_m += f_aa_Mm * 0.5 * h * Q;
+		
+		p_a_M += f_aa_Mm * 0.5 * (1 - h);
+		p_a_m += f_aa_Mm * 0.5 * (1 - h);
+		
+		p_a_m += f_aa_mm;
+		
+		totalpollen = p_A_M + p_A_m + p_a_M + p_a_m;
+		divisor = totalpollen + (VALUE(totalpollen) <= 0);
+		p_A_M /= divisor;
+		p_A_m /= divisor;
+		p_a_M /= divisor;
+		p_a_m /= divisor;
+		
+		// Outcrossed egg frequencies...
+		
+		PSatC = PSatF * F * (1 - S);
+		saturatedF = (limited == 0) | (VALUE(totalpollen) >= VALUE(PSatF));
+		saturatedC = (limited == 0) | (VALUE(totalpollen) >= VALUE(PSatC));
+		
+		ovules_AA_Mm = f_AA_Mm * 0.5;
+		ovules_Aa_MM = f_Aa_MM * h * 0.5 * (1 - S) * F;
+		ovules_Aa_Mm = f_Aa_Mm * h * 0.25 * (1 - S) * F;
+		ovules_aa_MM = f_aa_MM * h * (1 - S) * F;
+		ovules_aa_Mm = f_aa_Mm * h * 0.5 * (1 - S) * F;
+		limited_AA_MM = f_AA_MM * totalpollen / PSatF;
+		limited_AA_Mm = ovules_AA_Mm * totalpollen / PSatF;
+		limited_AA_mm = f_AA_mm * totalpollen / PSatF;
+		limited_Aa_MM = ovules_Aa_MM * totalpollen / PSatC;
+		limited_Aa_Mm = ovules_Aa_Mm * totalpollen / PSatC;
+		limited_aa_MM = ovules_aa_MM * totalpollen / PSatC;
+		limited_aa_Mm = ovules_aa_Mm * totalpollen / PSatC;
+		
+		e_A_M = 0;
+		e_A_m = 0;
+		e_a_M = 0;
+		e_a_m = 0;
+		
+		e_A_M += saturatedF ? f_AA_MM : limited_AA_MM;
+		
+		e_A_M += saturatedF ? ovules_AA_Mm : limited_AA_Mm;
+		e_A_m += saturatedF ? ovules_AA_Mm : limited_AA_Mm;
+		
+		e_A_m += saturatedF ? f_AA_mm : limited_AA_mm;
+		
+		e_A_M += saturatedC ? ovules_Aa_MM : limited_Aa_MM;
+		e_a_M += saturatedC ? ovules_Aa_MM : limited_Aa_MM;
+		
+		e_A_M += saturatedC ? ovules_Aa_Mm : limited_Aa_Mm;
+		e_A_m += saturatedC ? ovules_Aa_Mm : limited_Aa_Mm;
+		e_a_M += saturatedC ? ovules_Aa_Mm : limited_Aa_Mm;
+		e_a_m += saturatedC ? ovules_Aa_Mm : limited_Aa_Mm;
+		
+		e_a_M += saturatedC ? ovules_aa_MM : limited_aa_MM;
+		
+		e_a_M += saturatedC ? ovules_aa_Mm : limited_aa_Mm;
+		e_a_m += saturatedC ? ovules_aa_Mm : limited_aa_Mm;
+		
+		// Plant frequencies from outcrossing, then selfing...
+		
+		next_f_AA_MM = p_A_M * e_A_M;
+		next_f_AA_Mm = p_A_M * e_A_m + p_A_m * e_A_M;
+		next_f_AA_mm = p_A_m * e_A_m;
+		next_f_Aa_MM = p_A_M * e_a_M + p_a_M * e_A_M;
+		next_f_Aa_Mm = p_A_M * e_a_m + p_A_m * e_a_M + p_a_M * e_A_m + p_a_m * e_A_M;
+		next_f_Aa_mm = p_A_m * e_a_m + p_a_m * e_A_m;
+		next_f_aa_MM = p_a_M * e_a_M;
+		next_f_aa_Mm = p_a_M * e_a_m + p_a_m * e_a_M;
+		next_f_aa_mm = p_a_m * e_a_m;
+		
+		if (selfing)
+		{
+			next_f_AA_MM += f_Aa_MM * 0.25 * S * (1 - d) * h * F;
+			next_f_Aa_MM += f_Aa_MM * 0.5 * S * (1 - d) * h * F;
+			next_f_aa_MM += f_Aa_MM * 0.25 * S * (1 - d) * h * F;
+			
+			next_f_AA_MM += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+			next_f_AA_Mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+			next_f_AA_mm += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+			next_f_Aa_MM += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+			next_f_Aa_Mm += f_Aa_Mm * 0.25 * S * (1 - d) * h * F;
+			next_f_Aa_mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+			next_f_aa_MM += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+			next_f_aa_Mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+			next_f_aa_mm += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+			
+			next_f_aa_MM += f_aa_MM * S * (1 - d) * h * F;
+			
+			next_f_aa_MM += f_aa_Mm * 0.25 * S * (1 - d) * h * F;
+			next_f_aa_Mm += f_aa_Mm * 0.5 * S * (1 - d) * h * F;
+			next_f_aa_mm += f_aa_Mm * 0.25 * S * (1 - d) * h * F;
+		}
+		
+		// YY penalty, and normalise...
+		
+		next_f_aa_MM *= V;
+		next_f_aa_Mm *= V;
+		next_f_aa_mm *= V;
+		
+		f_AA_MM = next_f_AA_MM;
+		f_AA_Mm = next_f_AA_Mm;
+		f_AA_mm = next_f_AA_mm;
+		f_Aa_MM = next_f_Aa_MM;
+		f_Aa_Mm = next_f_Aa_Mm;
+		f_Aa_mm = next_f_Aa_mm;
+		f_aa_MM = next_f_aa_MM;
+		f_aa_Mm = next_f_aa_Mm;
+		f_aa_mm = next_f_aa_mm;
+		
+		totalplants = f_AA_MM + f_AA_Mm + f_AA_mm + f_Aa_MM + f_Aa_Mm + f_Aa_mm + f_aa_MM + f_aa_Mm + f_aa_mm;
+		divisor = totalplants + (VALUE(totalplants) <= 0);
+		f_AA_MM /= divisor;
+		f_AA_Mm /= divisor;
+		f_AA_mm /= divisor;
+		f_Aa_MM /= divisor;
+		f_Aa_Mm /= divisor;
+		f_Aa_mm /= divisor;
+		f_aa_MM /= divisor;
+		f_aa_Mm /= divisor;
+		f_aa_mm /= divisor;
+		
+		if (guarded)
+		{
+			f_AA_MM = VALUE(f_AA_MM) < extinction ? 0 : f_AA_MM;
+			f_AA_Mm = VALUE(f_AA_Mm) < extinction ? 0 : f_AA_Mm;
+			f_AA_mm = VALUE(f_AA_mm) < extinction ? 0 : f_AA_mm;
+			f_Aa_MM = VALUE(f_Aa_MM) < extinction ? 0 : f_Aa_MM;
+			f_Aa_Mm = VALUE(f_Aa_Mm) < extinction ? 0 : f_Aa_Mm;
+			f_Aa_mm = VALUE(f_Aa_mm) < extinction ? 0 : f_Aa_mm;
+			f_aa_MM = VALUE(f_aa_MM) < extinction ? 0 : f_aa_MM;
+			f_aa_Mm = VALUE(f_aa_Mm) < extinction ? 0 : f_aa_Mm;
+			f_aa_mm = VALUE(f_aa_mm) < extinction ? 0 : f_aa_mm;
+		}
+		
+		// The absorbing state (see simulate_body()). A cell that reaches it is put back there exactly
+		// every generation, so it is found to have stopped at the next compaction...
+		
+		dioecious = (ABSORBING && VALUE(f_AA_MM) == 0 && VALUE(f_AA_Mm) == 0 && VALUE(f_Aa_MM) == 0 && VALUE(f_Aa_Mm) == 0
+		 && VALUE(f_aa_MM) == 0 && VALUE(f_aa_Mm) == 0 && VALUE(f_AA_mm) > 0 && VALUE(f_Aa_mm) > 0);
+		f_AA_mm = dioecious ? absorbed : f_AA_mm;
+		f_Aa_mm = dioecious ? absorbed : f_Aa_mm;
+		f_aa_mm = dioecious ? 0 : f_aa_mm;
+		
+		g_AA_MM[i] = f_AA_MM;
+		g_AA_Mm[i] = f_AA_Mm;
+		g_AA_mm[i] = f_AA_mm;
+		g_Aa_MM[i] = f_Aa_MM;
+		g_Aa_Mm[i] = f_Aa_Mm;
+		g_Aa_mm[i] = f_Aa_mm;
+		g_aa_MM[i] = f_aa_MM;
+		g_aa_Mm[i] = f_aa_Mm;
+		g_aa_mm[i] = f_aa_mm;
+	}
+}
+
+#ifdef DERIVATIVES
+
+// One generation of the recursion for a single cell, as generation() does it, with its derivatives,
+// for --continuation and --jacobian; this is the generationjacobian_dual() that they call. next[] is
+// the frequencies after it, and jacobian[] (NGENOTYPES rows, each of JACOBIANCOLUMNS elements) the
+// derivative of each with respect to each start frequency, then to each parameter, in the order of
+// continuationnames[]. (The working is all in double precision here, parameters included, so next[]
+// can differ from what generation() gives in about the 8th decimal place.)
+//
+// Each number is used as a dual number, x + x' DUALSTEP i: a direction is given an imaginary part
+// of DUALSTEP, and the arithmetic carries the derivative along in the imaginary parts (the product
+// of two of them underflows to 0, so it's exact, to rounding, with no step to choose). Every
+// direction (each start frequency, and each parameter) is given a cell of its own, and all of them
+// are worked out in a single pass over a tile of JACOBIANCOLUMNS cells, so the cost is one
+// generation of that tile, in complex arithmetic, and the extinction limit and the absorbing state
+// are left out (they would set the derivatives to 0).
+
+void KERNEL(generationjacobian) (const double * f, float Q, float F, double * next, double * jacobian)
+{
+	real g[NGENOTYPES][JACOBIANCOLUMNS];
+	real p[NCONTINUABLES][JACOBIANCOLUMNS];
+	int j;
+	int k;
+	
+	for (j = 0; j < JACOBIANCOLUMNS; j++)
+	{
+		for (k = 0; k < NGENOTYPES; k++) g[k][j] = CMPLX(f[k], (j == k) ? DUALSTEP : 0);
+		p[0][j] = CMPLX(Q, (j == NGENOTYPES) ? DUALSTEP : 0);
+		p[1][j] = CMPLX(F, (j == NGENOTYPES + 1) ? DUALSTEP : 0);
+		for (k = 2; k < NCONTINUABLES; k++) p[k][j] = CMPLX(*continuationvalues[k], (j == NGENOTYPES + k) ? DUALSTEP : 0);
+	}
+	KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], g[6], g[7], g[8], p[0], p[1], JACOBIANCOLUMNS, &p[2][0], &p[3][0], &p[4][0], &p[5][0], &p[6][0], 1, 1);
+	
+	for (k = 0; k < NGENOTYPES; k++)
+	{
+		next[k] = creal(g[k][0]);
+		for (j = 0; j < JACOBIANCOLUMNS; j++) jacobian[k * JACOBIANCOLUMNS + j] = cimag(g[k][j]) / DUALSTEP;
+	}
+}
+
+#else
+
+// One generation of the recursion for a single cell, as the grid engine does it, for --continuation
+// (which needs the map itself, rather than a run of it). f[] is updated in place.
+
+void KERNEL(generation) (double * f, float Q, float F)
+{
+	real g[NGENOTYPES];
+	int k;
+	
+	for (k = 0; k < NGENOTYPES; k++) g[k] = f[k];
+	KERNEL(advancetile_body)(&g[0], &g[1], &g[2], &g[3], &g[4], &g[5], &g[6], &g[7], &g[8], &Q, &F, 1, h, S, d, V, PSatF, 1, 1);
+	for (k = 0; k < NGENOTYPES; k++) f[k] = g[k];
+}
+
+// Run the recursion for a tile of cells at once, one generation of all of them at a time (see
+// above). Every GRIDCHECK generations, the cells whose frequencies didn't change in that generation
+// (by more than the tolerance, with --converge; at all, otherwise) are retired: their results are
+// written out, and the rest are moved down to fill the gaps, so the loop only ever runs over live
+// cells. On entry, f[] holds the start frequencies of each cell in turn (NGENOTYPES each); on exit,
+// the final frequencies, and generations[] the generation at which each cell was retired (endpoint
+// if it never was).
+
+void KERNEL(simulate_tile) (int cells, const float * tileQ, const float * tileF, double * f, int * generations)
+{
+	real * g[NGENOTYPES];
+	real * before[NGENOTYPES];
+	real * block;
+	float * Q;
+	float * F;
+	int * cell;
+	real limit = stopearly ? tolerance : 0;
+	int nolimit = (PSatF == 0);
+	int noself = (S == 0);
+	int live = cells;
+	int kept;
+	int moved;
+	int i;
+	int k;
+	int n;
+	
+	block = malloc(2 * NGENOTYPES * cells * sizeof(real));
+	Q = malloc(cells * sizeof(float));
+	F = malloc(cells * sizeof(float));
+	cell = malloc(cells * sizeof(int));
+	if (block == NULL || Q == NULL || F == NULL || cell == NULL)
+	{
+		printf("Out of memory!\n");
+		exit(1);
+	}
+	
+	for (k = 0; k < NGENOTYPES; k++)
+	{
+		g[k] = block + k * cells;
+		before[k] = block + (NGENOTYPES + k) * cells;
+	}
+	
+	for (i = 0; i < cells; i++)
+	{
+		for (k = 0; k < NGENOTYPES; k++) g[k][i] = f[i * NGENOTYPES + k];
+		Q[i] = tileQ[i];
+		F[i] = tileF[i];
+		cell[i] = i;
+	}
+	
+	for (n = 0; n < endpoint && live > 0; n++)
+	{
+		if ((n + 1) % GRIDCHECK == 0)
+		{
+			for (k = 0; k < NGENOTYPES; k++) memcpy(before[k], g[k], live * sizeof(real));
+		}
+		
+		if (nolimit && noself) KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], g[6], g[7], g[8], Q, F, live, h, 0, d, V, 0, 0, 0);
+		else if (nolimit) KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], g[6], g[7], g[8], Q, F, live, h, S, d, V, 0, 0, 1);
+		else if (noself) KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], g[6], g[7], g[8], Q, F, live, h, 0, d, V, PSatF, 1, 0);
+		else KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], g[6], g[7], g[8], Q, F, live, h, S, d, V, PSatF, 1, 1);
+		
+		if ((n + 1) % GRIDCHECK == 0)
+		{
+			kept = 0;
+			for (i = 0; i < live; i++)
+			{
+				moved = 0;
+				for (k = 0; k < NGENOTYPES; k++)
+				{
+					if (g[k][i] - before[k][i] > limit || before[k][i] - g[k][i] > limit) moved = 1;
+				}
+				
+				if (moved)
+				{
+					for (k = 0; k < NGENOTYPES; k++) g[k][kept] = g[k][i];
+					Q[kept] = Q[i];
+					F[kept] = F[i];
+					cell[kept] = cell[i];
+					kept++;
+				} else {
+					for (k = 0; k < NGENOTYPES; k++) f[cell[i] * NGENOTYPES + k] = g[k][i];
+					generations[cell[i]] = n + 1;
+				}
+			}
+			live = kept;
+		}
+	}
+	
+	for (i = 0; i < live; i++)
+	{
+		for (k = 0; k < NGENOTYPES; k++) f[cell[i] * NGENOTYPES + k] = g[k][i];
+		generations[cell[i]] = endpoint;
+	}
+	
+	free(block);
+	free(Q);
+	free(F);
+	free(cell);
+	
+	return;
+}
+
+// Run replicates of the finite population recursion (--popsize) for one cell, in the same way as
+// simulate_tile(): advancetile_body() works out the expected frequencies of every live replicate at
+// once, and then a sample of popsize plants is drawn for each (see drawgeneration()). A replicate is
+// retired as soon as the invader has been lost or has fixed (see replicateoutcome()), so the loop
+// only ever runs over the replicates still undecided. Replicates first to first + count - 1 are run,
+// each with its own random number stream, so that batches can be run in any order (or thread). On
+// exit, counts[] holds the number of each outcome (counts[0] being the replicates still undecided
+// after endpoint generations), and *generations the total generations run.
+
+void KERNEL(simulate_replicates) (float Q, float F, const double * start, long long first, int count, long long * counts, long long * generations)
+{
+	real * g[NGENOTYPES];
+	real * block;
+	float * Qs;
+	float * Fs;
+	struct rngstream * streams;
+	double snapshot[NGENOTYPES];
+	int nolimit = (PSatF == 0);
+	int noself = (S == 0);
+	int live = count;
+	int kept;
+	int outcome;
+	int i;
+	int k;
+	int n;
+	
+	block = malloc(NGENOTYPES * count * sizeof(real));
+	Qs = malloc(count * sizeof(float));
+	Fs = malloc(count * sizeof(float));
+	streams = malloc(count * sizeof(struct rngstream));
+	if (block == NULL || Qs == NULL || Fs == NULL || streams == NULL)
+	{
+		printf("Out of memory!\n");
+		exit(1);
+	}
+	
+	for (k = 0; k < NGENOTYPES; k++) g[k] = block + k * count;
+	
+	for (i = 0; i < count; i++)
+	{
+		for (k = 0; k < NGENOTYPES; k++) g[k][i] = start[k];
+		Qs[i] = Q;
+		Fs[i] = F;
+		replicatestream(&streams[i], Q, F, start, first + i);
+	}
+	
+	counts[0] = counts[LOST] = counts[FIXED] = 0;
+	*generations = 0;
+	
+	for (n = 0; n < endpoint && live > 0; n++)
+	{
+		if (nolimit && noself) KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], g[6], g[7], g[8], Qs, Fs, live, h, 0, d, V, 0, 0, 0);
+		else if (nolimit) KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], g[6], g[7], g[8], Qs, Fs, live, h, S, d, V, 0, 0, 1);
+		else if (noself) KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], g[6], g[7], g[8], Qs, Fs, live, h, 0, d, V, PSatF, 1, 0);
+		else KERNEL(advancetile_body)(g[0], g[1], g[2], g[3], g[4], g[5], g[6], g[7], g[8], Qs, Fs, live, h, S, d, V, PSatF, 1, 1);
+		
+		kept = 0;
+		for (i = 0; i < live; i++)
+		{
+			for (k = 0; k < NGENOTYPES; k++) snapshot[k] = g[k][i];
+			drawgeneration(snapshot, &streams[i]);
+			
+			outcome = replicateoutcome(snapshot);
+			if (outcome)
+			{
+				counts[outcome]++;
+				*generations += n + 1;
+			} else {
+				for (k = 0; k < NGENOTYPES; k++) g[k][kept] = snapshot[k];
+				streams[kept] = streams[i];
+				kept++;
+			}
+		}
+		live = kept;
+	}
+	
+	counts[0] += live;
+	*generations += (long long) live * endpoint;
+	
+	free(block);
+	free(Qs);
+	free(Fs);
+	free(streams);
+	
+	return;
+}
+
+// THE SPATIAL MODEL (--lattice)...
+//
+// Each deme of the lattice runs the recursion, except that its outcrossed pollen comes partly from
+// other demes. So that the pollen can be dispersed in between, a generation is split in two: first
+// the pollen each deme makes (the sums at the start of advancetile_body(), before they're normalised,
+// i.e. in proportion to the deme's output), for a row of demes...
+
+static ALWAYS_INLINE void KERNEL(latticepollen_body) (const real * restrict g_Aa_MM, const real * restrict g_Aa_Mm, const real * restrict g_Aa_mm,
+	const real * restrict g_aa_MM, const real * restrict g_aa_Mm, const real * restrict g_aa_mm,
+	real * restrict out_A_M, real * restrict out_A_m, real * restrict out_a_M, real * restrict out_a_m, int count, float Q)
+{
+	int i;
+	
+	for (i = 0; i < count; i++)
+	{
+		real f_Aa_MM = g_Aa_MM[i];
+		real f_Aa_Mm = g_Aa_Mm[i];
+		real f_Aa_mm = g_Aa_mm[i];
+		real f_aa_MM = g_aa_MM[i];
+		real f_aa_Mm = g_aa_Mm[i];
+		real f_aa_mm = g_aa_mm[i];
+		real p_A_M;
+		real p_A_m;
+		real p_a_M;
+		real p_a_m;
+		
+		p_A_M = 0;
+		p_A_m = 0;
+		p_a_M = 0;
+		p_a_m = 0;
+		
+		p_A_M += f_Aa_MM * 0.5 * h * Q;
+		p_a_M += f_Aa_MM * 0.5 * h * Q;
+		
+		p_A_M += f_Aa_MM * 0.5 * (1 - h);
+		p_a_M += f_Aa_MM * 0.5 * (1 - h);
+		
+		p_A_M += f_Aa_Mm * 0.25 * h * Q;
+		p_A_m += f_Aa_Mm * 0.25 * h * Q;
+		p_a_M += f_Aa_Mm * 0.25 * h * Q;
+		p_a_m += f_Aa_Mm * 0.25 * h * Q;
+		
+		p_A_M += f_Aa_Mm * 0.25 * (1 - h);
+		p_A_m += f_Aa_Mm * 0.25 * (1 - h);
+		p_a_M += f_Aa_Mm * 0.25 * (1 - h);
+		p_a_m += f_Aa_Mm * 0.25 * (1 - h);
+		
+		p_A_m += f_Aa_mm * 0.5;
+		p_a_m += f_Aa_mm * 0.5;
+		
+		p_a_M += f_aa_MM * h * Q;
+		
+		p_a_M += f_aa_MM * (1 - h);
+		
+		p_a_M += f_aa_Mm * 0.5 * h * Q;
+		p_a_m += f_aa_Mm * 0.5 * h * Q;
+		
+		p_a_M += f_aa_Mm * 0.5 * (1 - h);
+		p_a_m += f_aa_Mm * 0.5 * (1 - h);
+		
+		p_a_m += f_aa_mm;
+		
+		out_A_M[i] = p_A_M;
+		out_A_m[i] = p_A_m;
+		out_a_M[i] = p_a_M;
+		out_a_m[i] = p_a_m;
+	}
+}
+
+// ...and then, given the pollen each deme receives (in the same units), the rest of the generation,
+// in place. This is the rest of advancetile_body(), except that there's no absorbing state: a deme
+// that is dioecious can still be reached by inconstants from elsewhere.
+
+static ALWAYS_INLINE void KERNEL(latticeseeds_body) (real * restrict g_AA_MM, real * restrict g_AA_Mm, real * restrict g_AA_mm,
+	real * restrict g_Aa_MM, real * restrict g_Aa_Mm, real * restrict g_Aa_mm, real * restrict g_aa_MM, real * restrict g_aa_Mm, real * restrict g_aa_mm,
+	const real * restrict in_A_M, const real * restrict in_A_m, const real * restrict in_a_M, const real * restrict in_a_m,
+	int count, float F, float S, float PSatF, const int limited, const int selfing)
+{
+	const int guarded = (extinction > 0);
+	int i;
+	
+	for (i = 0; i < count; i++)
+	{
+		real f_AA_MM = g_AA_MM[i];
+		real f_AA_Mm = g_AA_Mm[i];
+		real f_AA_mm = g_AA_mm[i];
+		real f_Aa_MM = g_Aa_MM[i];
+		real f_Aa_Mm = g_Aa_Mm[i];
+		real f_Aa_mm = g_Aa_mm[i];
+		real f_aa_MM = g_aa_MM[i];
+		real f_aa_Mm = g_aa_Mm[i];
+		real f_aa_mm = g_aa_mm[i];
+		real p_A_M = in_A_M[i];
+		real p_A_m = in_A_m[i];
+		real p_a_M = in_a_M[i];
+		real p_a_m = in_a_m[i];
+		
+		real next_f_AA_MM;
+		real next_f_AA_Mm;
+		real next_f_AA_mm;
+		real next_f_Aa_MM;
+		real next_f_Aa_Mm;
+		real next_f_Aa_mm;
+		real next_f_aa_MM;
+		real next_f_aa_Mm;
+		real next_f_aa_mm;
+		real e_A_M;
+		real e_A_m;
+		real e_a_M;
+		real e_a_m;
+		real PSatC;
+		real totalpollen;
+		real totalplants;
+		real divisor;
+		int saturatedF;
+		int saturatedC;
+		wide ovules_AA_Mm;			// Outcrossed eggs from each female (where not just f) and inconstant,
+		wide ovules_Aa_MM;			// without pollen limitation...
+		wide ovules_Aa_Mm;
+		real ovules_aa_MM;
+		wide ovules_aa_Mm;
+		real limited_AA_MM;			// ...and with it (worked out whether or not it applies)
+		wide limited_AA_Mm;
+		real limited_AA_mm;
+		wide limited_Aa_MM;
+		wide limited_Aa_Mm;
+		real limited_aa_MM;
+		wide limited_aa_Mm;
+		
+		totalpollen = p_A_M + p_A_m + p_a_M + p_a_m;
+		divisor = totalpollen + (totalpollen <= 0);
+		p_A_M /= divisor;
+		p_A_m /= divisor;
+		p_a_M /= divisor;
+		p_a_m /= divisor;
+		
+		// Outcrossed egg frequencies...
+		
+		PSatC = PSatF * F * (1 - S);
+		saturatedF = (limited == 0) | (totalpollen >= PSatF);
+		saturatedC = (limited == 0) | (totalpollen >= PSatC);
+		
+		ovules_AA_Mm = f_AA_Mm * 0.5;
+		ovules_Aa_MM = f_Aa_MM * h * 0.5 * (1 - S) * F;
+		ovules_Aa_Mm = f_Aa_Mm * h * 0.25 * (1 - S) * F;
+		ovules_aa_MM = f_aa_MM * h * (1 - S) * F;
+		ovules_aa_Mm = f_aa_Mm * h * 0.5 * (1 - S) * F;
+		limited_AA_MM = f_AA_MM * totalpollen / PSatF;
+		limited_AA_Mm = ovules_AA_Mm * totalpollen / PSatF;
+		limited_AA_mm = f_AA_mm * totalpollen / PSatF;
+		limited_Aa_MM = ovules_Aa_MM * totalpollen / PSatC;
+		limited_Aa_Mm = ovules_Aa_Mm * totalpollen / PSatC;
+		limited_aa_MM = ovules_aa_MM * totalpollen / PSatC;
+		limited_aa_Mm = ovules_aa_Mm * totalpollen / PSatC;
+		
+		e_A_M = 0;
+		e_A_m = 0;
+		e_a_M = 0;
+		e_a_m = 0;
+		
+		e_A_M += saturatedF ? f_AA_MM : limited_AA_MM;
+		
+		e_A_M += saturatedF ? ovules_AA_Mm : limited_AA_Mm;
+		e_A_m += saturatedF ? ovules_AA_Mm : limited_AA_Mm;
+		
+		e_A_m += saturatedF ? f_AA_mm : limited_AA_mm;
+		
+		e_A_M += saturatedC ? ovules_Aa_MM : limited_Aa_MM;
+		e_a_M += saturatedC ? ovules_Aa_MM : limited_Aa_MM;
+		
+		e_A_M += saturatedC ? ovules_Aa_Mm : limited_Aa_Mm;
+		e_A_m += saturatedC ? ovules_Aa_Mm : limited_Aa_Mm;
+		e_a_M += saturatedC ? ovules_Aa_Mm : limited_Aa_Mm;
+		e_a_m += saturatedC ? ovules_Aa_Mm : limited_Aa_Mm;
+		
+		e_a_M += saturatedC ? ovules_aa_MM : limited_aa_MM;
+		
+		e_a_M += saturatedC ? ovules_aa_Mm : limited_aa_Mm;
+		e_a_m += saturatedC ? ovules_aa_Mm : limited_aa_Mm;
+		
+		// Plant frequencies from outcrossing, then selfing...
+		
+		next_f_AA_MM = p_A_M * e_A_M;
+		next_f_AA_Mm = p_A_M * e_A_m + p_A_m * e_A_M;
+		next_f_AA_mm = p_A_m * e_A_m;
+		next_f_Aa_MM = p_A_M * e_a_M + p_a_M * e_A_M;
+		next_f_Aa_Mm = p_A_M * e_a_m + p_A_m * e_a_M + p_a_M * e_A_m + p_a_m * e_A_M;
+		next_f_Aa_mm = p_A_m * e_a_m + p_a_m * e_A_m;
+		next_f_aa_MM = p_a_M * e_a_M;
+		next_f_aa_Mm = p_a_M * e_a_m + p_a_m * e_a_M;
+		next_f_aa_mm = p_a_m * e_a_m;
+		
+		if (selfing)
+		{
+			next_f_AA_MM += f_Aa_MM * 0.25 * S * (1 - d) * h * F;
+			next_f_Aa_MM += f_Aa_MM * 0.5 * S * (1 - d) * h * F;
+			next_f_aa_MM += f_Aa_MM * 0.25 * S * (1 - d) * h * F;
+			
+			next_f_AA_MM += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+			next_f_AA_Mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+			next_f_AA_mm += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+			next_f_Aa_MM += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+			next_f_Aa_Mm += f_Aa_Mm * 0.25 * S * (1 - d) * h * F;
+			next_f_Aa_mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+			next_f_aa_MM += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+			next_f_aa_Mm += f_Aa_Mm * 0.125 * S * (1 - d) * h * F;
+			next_f_aa_mm += f_Aa_Mm * 0.0625 * S * (1 - d) * h * F;
+			
+			next_f_aa_MM += f_aa_MM * S * (1 - d) * h * F;
+			
+			next_f_aa_MM += f_aa_Mm * 0.25 * S * (1 - d) * h * F;
+			next_f_aa_Mm += f_aa_Mm * 0.5 * S * (1 - d) * h * F;
+			next_f_aa_mm += f_aa_Mm * 0.25 * S * (1 - d) * h * F;
+		}
+		
+		// YY penalty, and normalise...
+		
+		next_f_aa_MM *= V;
+		next_f_aa_Mm *= V;
+		next_f_aa_mm *= V;
+		
+		f_AA_MM = next_f_AA_MM;
+		f_AA_Mm = next_f_AA_Mm;
+		f_AA_mm = next_f_AA_mm;
+		f_Aa_MM = next_f_Aa_MM;
+		f_Aa_Mm = next_f_Aa_Mm;
+		f_Aa_mm = next_f_Aa_mm;
+		f_aa_MM = next_f_aa_MM;
+		f_aa_Mm = next_f_aa_Mm;
+		f_aa_mm = next_f_aa_mm;
+		
+		totalplants = f_AA_MM + f_AA_Mm + f_AA_mm + f_Aa_MM + f_Aa_Mm + f_Aa_mm + f_aa_MM + f_aa_Mm + f_aa_mm;
+		divisor = totalplants + (totalplants <= 0);
+		f_AA_MM /= divisor;
+		f_AA_Mm /= divisor;
+		f_AA_mm /= divisor;
+		f_Aa_MM /= divisor;
+		f_Aa_Mm /= divisor;
+		f_Aa_mm /= divisor;
+		f_aa_MM /= divisor;
+		f_aa_Mm /= divisor;
+		f_aa_mm /= divisor;
+		
+		if (guarded)
+		{
+			f_AA_MM = f_AA_MM < extinction ? 0 : f_AA_MM;
+			f_AA_Mm = f_AA_Mm < extinction ? 0 : f_AA_Mm;
+			f_AA_mm = f_AA_mm < extinction ? 0 : f_AA_mm;
+			f_Aa_MM = f_Aa_MM < extinction ? 0 : f_Aa_MM;
+			f_Aa_Mm = f_Aa_Mm < extinction ? 0 : f_Aa_Mm;
+			f_Aa_mm = f_Aa_mm < extinction ? 0 : f_Aa_mm;
+			f_aa_MM = f_aa_MM < extinction ? 0 : f_aa_MM;
+			f_aa_Mm = f_aa_Mm < extinction ? 0 : f_aa_Mm;
+			f_aa_mm = f_aa_mm < extinction ? 0 : f_aa_mm;
+		}
+		
+		g_AA_MM[i] = f_AA_MM;
+		g_AA_Mm[i] = f_AA_Mm;
+		g_AA_mm[i] = f_AA_mm;
+		g_Aa_MM[i] = f_Aa_MM;
+		g_Aa_Mm[i] = f_Aa_Mm;
+		g_Aa_mm[i] = f_Aa_mm;
+		g_aa_MM[i] = f_aa_MM;
+		g_aa_Mm[i] = f_aa_Mm;
+		g_aa_mm[i] = f_aa_mm;
+	}
+}
+
+// Pollen dispersal (see latticesweep() for the dispersal kernel): for one gamete type, a row of the
+// pollen made, padded by dispersalradius demes at each end (reflected), is smoothed along the row...
+
+static ALWAYS_INLINE void KERNEL(disperserow) (const real * restrict padded, real * restrict out, const real * restrict weights, int size)
+{
+	int i;
+	int k;
+	
+	for (i = 0; i < size; i++) out[i] = 0;
+	for (k = 0; k <= 2 * dispersalradius; k++)
+	{
+		for (i = 0; i < size; i++) out[i] += weights[k] * padded[i + k];
+	}
+}
+
+// ...and then down the columns, one row of output at a time, from the rows within dispersalradius
+// (reflected at the edges). Each loop is over a row, so both vectorise.
+
+static ALWAYS_INLINE void KERNEL(dispersecolumns) (const real * restrict rows, real * restrict out, const real * restrict weights, int size, int y)
+{
+	const real * source;
+	int i;
+	int k;
+	
+	for (i = 0; i < size; i++) out[i] = 0;
+	for (k = 0; k <= 2 * dispersalradius; k++)
+	{
+		source = rows + (size_t) reflectindex(y + k - dispersalradius, size) * size;
+		for (i = 0; i < size; i++) out[i] += weights[k] * source[i];
+	}
+}
+
+// Run the recursion on a size x size lattice of demes for endpoint generations, starting every deme
+// from outside[], except those within patchradius of the centre, which start from inside[]. The
+// genotype frequencies are held as the grid engine holds a tile's (one array per genotype), a row of
+// demes at a time being contiguous. Each generation is two passes over the rows, shared between
+// threads in strips: the pollen made by each row, smoothed along the row into rows[]; then, for each
+// row, the smoothing down the columns, which gives the pollen the row receives, and the rest of the
+// generation. Every census generations (and at the end), census() is called for every deme in turn.
+
+void KERNEL(simulate_lattice) (int size, float Q, float F, const double * outside, const double * inside, double patchradius,
+	void (* census) (int generation, int x, int y, double * f))
+{
+	real * g[NGENOTYPES];
+	real * rows[NGAMETES];
+	real * block;
+	real weights[2 * MAXRADIUS + 1];
+	real stay;					// The pollen a deme receives is stay times its own, plus spread times
+	real spread;				// the smoothed pollen (which includes some of its own; see latticesweep())
+	double frequencies[NGENOTYPES];
+	size_t cells = (size_t) size * size;
+	size_t cell;
+	double dx;
+	double dy;
+	int nolimit = (PSatF == 0);
+	int noself = (S == 0);
+	int x;
+	int y;
+	int k;
+	int n;
+	
+	block = malloc((NGENOTYPES + NGAMETES) * cells * sizeof(real));
+	if (block == NULL)
+	{
+		printf("Out of memory!\n");
+		exit(1);
+	}
+	for (k = 0; k < NGENOTYPES; k++) g[k] = block + k * cells;
+	for (k = 0; k < NGAMETES; k++) rows[k] = block + (NGENOTYPES + k) * cells;
+	
+	for (k = 0; k <= 2 * dispersalradius; k++) weights[k] = dispersalweights[k];
+	spread = dispersal / (1 - dispersalweights[dispersalradius] * dispersalweights[dispersalradius]);
+	stay = 1 - spread;
+	if (dispersalradius == 0)
+	{
+		spread = 0;
+		stay = 1;
+	}
+	
+	for (y = 0; y < size; y++)
+	{
+		for (x = 0; x < size; x++)
+		{
+			dx = x - (size - 1) / 2.0;
+			dy = y - (size - 1) / 2.0;
+			cell = (size_t) y * size + x;
+			for (k = 0; k < NGENOTYPES; k++) g[k][cell] = (dx * dx + dy * dy <= patchradius * patchradius) ? inside[k] : outside[k];
+		}
+	}
+	
+	for (n = 0; ; n++)
+	{
+		if (n % censusevery == 0 || n == endpoint)
+		{
+			for (y = 0; y < size; y++)
+			{
+				for (x = 0; x < size; x++)
+				{
+					cell = (size_t) y * size + x;
+					for (k = 0; k < NGENOTYPES; k++) frequencies[k] = g[k][cell];
+					census(n, x, y, frequencies);
+				}
+			}
+		}
+		if (n == endpoint) break;
+		
+		// Pollen made, smoothed along the rows...
+		
+#ifdef _OPENMP
+		#pragma omp parallel private(x, y, k, cell)
+#endif
+		{
+			real * padded = malloc(NGAMETES * (size + 2 * dispersalradius) * sizeof(real));
+			real * p[NGAMETES];
+			
+			if (padded == NULL)
+			{
+				printf("Out of memory!\n");
+				exit(1);
+			}
+			for (k = 0; k < NGAMETES; k++) p[k] = padded + k * (size + 2 * dispersalradius);
+			
+#ifdef _OPENMP
+			#pragma omp for schedule(static)
+#endif
+			for (y = 0; y < size; y++)
+			{
+				cell = (size_t) y * size;
+				KERNEL(latticepollen_body)(g[3] + cell, g[4] + cell, g[5] + cell, g[6] + cell, g[7] + cell, g[8] + cell,
+					p[0] + dispersalradius, p[1] + dispersalradius, p[2] + dispersalradius, p[3] + dispersalradius, size, Q);
+				
+				for (k = 0; k < NGAMETES; k++)
+				{
+					for (x = 1; x <= dispersalradius; x++)
+					{
+						p[k][dispersalradius - x] = p[k][dispersalradius + reflectindex(-x, size)];
+						p[k][dispersalradius + size - 1 + x] = p[k][dispersalradius + reflectindex(size - 1 + x, size)];
+					}
+					KERNEL(disperserow)(p[k], rows[k] + cell, weights, size);
+				}
+			}
+			
+			free(padded);
+		}
+		
+		// ...then down the columns, and the rest of the generation...
+		
+#ifdef _OPENMP
+		#pragma omp parallel private(x, y, k, cell)
+#endif
+		{
+			real * received = malloc(2 * NGAMETES * size * sizeof(real));
+			real * r[NGAMETES];
+			real * own[NGAMETES];
+			
+			if (received == NULL)
+			{
+				printf("Out of memory!\n");
+				exit(1);
+			}
+			for (k = 0; k < NGAMETES; k++)
+			{
+				r[k] = received + k * size;
+				own[k] = received + (NGAMETES + k) * size;
+			}
+			
+#ifdef _OPENMP
+			#pragma omp for schedule(static)
+#endif
+			for (y = 0; y < size; y++)
+			{
+				cell = (size_t) y * size;
+				KERNEL(latticepollen_body)(g[3] + cell, g[4] + cell, g[5] + cell, g[6] + cell, g[7] + cell, g[8] + cell, own[0], own[1], own[2], own[3], size, Q);
+				
+				for (k = 0; k < NGAMETES; k++)
+				{
+					KERNEL(dispersecolumns)(rows[k], r[k], weights, size, y);
+					for (x = 0; x < size; x++) r[k][x] = stay * own[k][x] + spread * r[k][x];
+				}
+				
+				if (nolimit && noself) KERNEL(latticeseeds_body)(g[0] + cell, g[1] + cell, g[2] + cell, g[3] + cell, g[4] + cell, g[5] + cell, g[6] + cell, g[7] + cell, g[8] + cell, r[0], r[1], r[2], r[3], size, F, 0, 0, 0, 0);
+				else if (nolimit) KERNEL(latticeseeds_body)(g[0] + cell, g[1] + cell, g[2] + cell, g[3] + cell, g[4] + cell, g[5] + cell, g[6] + cell, g[7] + cell, g[8] + cell, r[0], r[1], r[2], r[3], size, F, S, 0, 0, 1);
+				else if (noself) KERNEL(latticeseeds_body)(g[0] + cell, g[1] + cell, g[2] + cell, g[3] + cell, g[4] + cell, g[5] + cell, g[6] + cell, g[7] + cell, g[8] + cell, r[0], r[1], r[2], r[3], size, F, 0, PSatF, 1, 0);
+				else KERNEL(latticeseeds_body)(g[0] + cell, g[1] + cell, g[2] + cell, g[3] + cell, g[4] + cell, g[5] + cell, g[6] + cell, g[7] + cell, g[8] + cell, r[0], r[1], r[2], r[3], size, F, S, PSatF, 1, 1);
+			}
+			
+			free(received);
+		}
+	}
+	
+	free(block);
+	
+	return;
+}
+
+#endif
+
+#undef param
+#undef shared
+#undef SHARED
+#undef VALUE
+#undef ABSORBING
@@ -0,0 +1,818 @@
+/*
+
+Kernel generator for user-defined variants of the inconstant males models.
+Code by Allan Crossman.
+
+Reads a small text description of a model and writes out a C file containing a specialised kernel,
+with the same update structure as the built-in recursion in deterministic_model1.c / deterministic_model2.c
+(outcrossed pollen, outcrossed eggs, outcrossing, selfing, YY penalty, normalisation). All the gamete
+proportions are worked out here, so the kernel is straight-line code with the constants already folded in.
+
+Usage:
+
+	gcc modelgen.c -o modelgen
+	./modelgen models/model1.txt kernel.c
+	gcc -O2 -shared -fPIC kernel.c -o kernel.so
+	./a.out --kernel ./kernel.so [usual options]
+
+where a.out is either of the main programs (they drive a loaded kernel in exactly the same way).
+
+
+MODEL DESCRIPTION FORMAT:
+
+One statement per line. Anything after a # is a comment.
+
+name <identifier>
+	Short name, used for output filenames (e.g. "model1" gives model1_startDIO_...bmp).
+
+description <text>
+	Longer description, printed in the settings banner.
+
+locus <allele> <allele> ...
+	Declares a locus and its alleles. Use one line per locus; the order of these lines is the order
+	in which alleles are given in genotypes. Allele names may contain letters, digits and *, and must
+	be unique across all loci. Loci are assumed to be unlinked.
+
+y <allele> ...
+	Marks alleles as Y-linked. Pollen carrying any of these is subject to the ppY viability penalty,
+	and genotypes homozygous for Y alleles at any locus are subject to the V (YY viability) penalty.
+
+genotype <name> <allele>/<allele> ... female|male|inconstant [h <value>] [selfing <factor>]
+	Declares a genotype: its name (letters, digits and _), one allele pair per locus, and its phenotype.
+	Every genotype that can be produced by mating must be declared. Optional settings for inconstants:
+	"h" fixes their probability of reproducing as a cosex (instead of using -h), which allows genotypes
+	with differing dominance; "selfing" multiplies the selfing rate S for this genotype only.
+
+start dio|pgd <name>=<frequency> ...
+	Start frequencies for the default (dioecy) run and for --pgd runs. Unlisted genotypes start at 0.
+
+See the models directory for descriptions of the two built-in models.
+
+*/
+
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAXLOCI 4
+#define MAXALLELES 8			// Per locus
+#define MAXGENOTYPES 64
+#define MAXHAPLOTYPES 256		// MAXALLELES ^ MAXLOCI would be more, but this is plenty in practice
+#define MAXNAME 32
+#define MAXLINE 1024
+
+#define FEMALE 1				// Phenotype codes, as used by the main programs
+#define MALE 2
+#define INCONSTANT 3
+
+
+char name[MAXNAME] = "";
+char description[MAXLINE] = "";
+
+int loci = 0;
+int alleles[MAXLOCI];									// Number of alleles at each locus
+char allelenames[MAXLOCI][MAXALLELES][MAXNAME];
+int isY[MAXLOCI][MAXALLELES];
+
+int genotypes = 0;
+char genotypenames[MAXGENOTYPES][MAXNAME];
+int genotypealleles[MAXGENOTYPES][MAXLOCI][2];
+int phenotype[MAXGENOTYPES];
+double fixedh[MAXGENOTYPES];							// -1 means use the h parameter
+double selfingfactor[MAXGENOTYPES];
+float start_dio[MAXGENOTYPES];
+float start_pgd[MAXGENOTYPES];
+int have_dio = 0;
+int have_pgd = 0;
+
+int haplotypes = 1;										// Number of possible gametes (product of allele counts)
+char haplotypenames[MAXHAPLOTYPES][MAXNAME * MAXLOCI];	// Used to name the kernel's p_ and e_ variables
+double gametes[MAXGENOTYPES][MAXHAPLOTYPES];			// Proportion of each genotype's gametes of each haplotype
+int ispollen[MAXHAPLOTYPES];							// Can this haplotype occur as pollen?
+int isegg[MAXHAPLOTYPES];								// Can this haplotype occur as an egg?
+
+char * inputname;
+int linenumber = 0;
+
+
+
+void fail (char * message, char * detail)
+{
+	printf("%s line %d: %s %s\n", inputname, linenumber, message, detail ? detail : "");
+	exit(1);
+}
+
+int findallele (char * allele, int locus)
+{
+	int n;
+
+	for (n = 0; n < alleles[locus]; n++)
+	{
+		if (strcmp(allelenames[locus][n], allele) == 0) return n;
+	}
+	return -1;
+}
+
+int findgenotype (char * genotype)
+{
+	int n;
+
+	for (n = 0; n < genotypes; n++)
+	{
+		if (strcmp(genotypenames[n], genotype) == 0) return n;
+	}
+	return -1;
+}
+
+int isidentifier (char * s, char * extra)
+{
+	if (*s == '\0') return 0;
+	for (; *s; s++)
+	{
+		if (isalnum((unsigned char) *s) == 0 && *s != '_' && strchr(extra, *s) == NULL) return 0;
+	}
+	return 1;
+}
+
+// Genotype index of the offspring of an egg and a pollen grain (given as haplotypes), or -1 if undeclared.
+
+int offspring (int egg, int pollen)
+{
+	int a[MAXLOCI];
+	int b[MAXLOCI];
+	int locus;
+	int n;
+
+	for (locus = loci - 1; locus >= 0; locus--)
+	{
+		a[locus] = egg % alleles[locus];
+		b[locus] = pollen % alleles[locus];
+		egg /= alleles[locus];
+		pollen /= alleles[locus];
+	}
+
+	for (n = 0; n < genotypes; n++)
+	{
+		for (locus = 0; locus < loci; locus++)
+		{
+			if (!(genotypealleles[n][locus][0] == a[locus] && genotypealleles[n][locus][1] == b[locus])
+			 && !(genotypealleles[n][locus][0] == b[locus] && genotypealleles[n][locus][1] == a[locus])) break;
+		}
+		if (locus == loci) return n;
+	}
+	return -1;
+}
+
+int haplotypeisY (int haplotype)
+{
+	int locus;
+
+	for (locus = loci - 1; locus >= 0; locus--)
+	{
+		if (isY[locus][haplotype % alleles[locus]]) return 1;
+		haplotype /= alleles[locus];
+	}
+	return 0;
+}
+
+int genotypeisYY (int g)
+{
+	int locus;
+
+	for (locus = 0; locus < loci; locus++)
+	{
+		if (isY[locus][genotypealleles[g][locus][0]] && isY[locus][genotypealleles[g][locus][1]]) return 1;
+	}
+	return 0;
+}
+
+void readmodel (void)
+{
+	FILE * infile;
+	char line[MAXLINE];
+	char * word[MAXLINE / 2];
+	char * p;
+	char * eq;
+	float * target;
+	int words;
+	int locus;
+	int g;
+	int n;
+
+	infile = fopen(inputname, "r");
+	if (infile == NULL)
+	{
+		printf("Failed to open %s\n", inputname);
+		exit(1);
+	}
+
+	while (fgets(line, MAXLINE, infile))
+	{
+		linenumber++;
+
+		p = strchr(line, '#');
+		if (p) *p = '\0';
+
+		// Keep the rest of a description line intact before splitting into words...
+
+		p = line;
+		while (isspace((unsigned char) *p)) p++;
+		if (strncmp(p, "description", 11) == 0 && isspace((unsigned char) p[11]))
+		{
+			p += 11;
+			while (isspace((unsigned char) *p)) p++;
+			for (n = strlen(p); n > 0 && isspace((unsigned char) p[n - 1]); n--) p[n - 1] = '\0';
+			if (strchr(p, '"') || strchr(p, '\\')) fail("Description may not contain quotes or backslashes", NULL);
+			strcpy(description, p);
+			continue;
+		}
+
+		words = 0;
+		for (p = strtok(line, " \t\r\n"); p; p = strtok(NULL, " \t\r\n"))
+		{
+			word[words++] = p;
+		}
+		if (words == 0) continue;
+
+		if (strcmp(word[0], "name") == 0)
+		{
+			if (words != 2 || strlen(word[1]) >= MAXNAME || isidentifier(word[1], "-.") == 0) fail("Bad name", NULL);
+			strcpy(name, word[1]);
+			continue;
+		}
+
+		if (strcmp(word[0], "locus") == 0)
+		{
+			if (genotypes) fail("Loci must be declared before genotypes", NULL);
+			if (loci == MAXLOCI) fail("Too many loci", NULL);
+			if (words < 3 || words - 1 > MAXALLELES) fail("A locus needs between 2 and 8 alleles", NULL);
+			for (n = 1; n < words; n++)
+			{
+				if (strlen(word[n]) >= MAXNAME || isidentifier(word[n], "*") == 0) fail("Bad allele name", word[n]);
+				for (locus = 0; locus < loci; locus++)
+				{
+					if (findallele(word[n], locus) >= 0) fail("Allele declared twice:", word[n]);
+				}
+				strcpy(allelenames[loci][n - 1], word[n]);
+				alleles[loci] = n;
+				if (findallele(word[n], loci) != n - 1) fail("Allele declared twice:", word[n]);
+			}
+			loci++;
+			continue;
+		}
+
+		if (strcmp(word[0], "y") == 0)
+		{
+			for (n = 1; n < words; n++)
+			{
+				for (locus = 0; locus < loci; locus++)
+				{
+					if (findallele(word[n], locus) >= 0) break;
+				}
+				if (locus == loci) fail("Unknown allele", word[n]);
+				isY[locus][findallele(word[n], locus)] = 1;
+			}
+			continue;
+		}
+
+		if (strcmp(word[0], "genotype") == 0)
+		{
+			if (loci == 0) fail("Loci must be declared before genotypes", NULL);
+			if (genotypes == MAXGENOTYPES) fail("Too many genotypes", NULL);
+			if (words < loci + 3) fail("Genotype needs a name, an allele pair per locus, and a phenotype", NULL);
+			if (strlen(word[1]) >= MAXNAME || isidentifier(word[1], "") == 0) fail("Bad genotype name", word[1]);
+			if (findgenotype(word[1]) >= 0) fail("Genotype declared twice:", word[1]);
+
+			g = genotypes;
+			strcpy(genotypenames[g], word[1]);
+
+			for (locus = 0; locus < loci; locus++)
+			{
+				p = strchr(word[2 + locus], '/');
+				if (p == NULL) fail("Expected an allele pair such as A/a, not", word[2 + locus]);
+				*p = '\0';
+				genotypealleles[g][locus][0] = findallele(word[2 + locus], locus);
+				genotypealleles[g][locus][1] = findallele(p + 1, locus);
+				if (genotypealleles[g][locus][0] < 0 || genotypealleles[g][locus][1] < 0)
+				{
+					fail("Unknown allele (or allele of a different locus) in genotype", word[1]);
+				}
+			}
+
+			n = 2 + loci;
+			if (strcmp(word[n], "female") == 0) phenotype[g] = FEMALE;
+			else if (strcmp(word[n], "male") == 0) phenotype[g] = MALE;
+			else if (strcmp(word[n], "inconstant") == 0) phenotype[g] = INCONSTANT;
+			else fail("Phenotype must be female, male or inconstant, not", word[n]);
+
+			fixedh[g] = -1;
+			selfingfactor[g] = 1;
+
+			for (n++; n < words; n += 2)
+			{
+				if (n == words - 1) fail("Missing value for", word[n]);
+				if (phenotype[g] != INCONSTANT) fail("Only inconstants can have", word[n]);
+				if (strcmp(word[n], "h") == 0)
+				{
+					fixedh[g] = atof(word[n + 1]);
+				} else if (strcmp(word[n], "selfing") == 0) {
+					selfingfactor[g] = atof(word[n + 1]);
+				} else {
+					fail("Unknown genotype setting", word[n]);
+				}
+			}
+
+			genotypes++;
+			continue;
+		}
+
+		if (strcmp(word[0], "start") == 0)
+		{
+			if (words < 2) fail("Expected start dio or start pgd", NULL);
+			if (strcmp(word[1], "dio") == 0)
+			{
+				target = start_dio;
+				have_dio = 1;
+			} else if (strcmp(word[1], "pgd") == 0) {
+				target = start_pgd;
+				have_pgd = 1;
+			} else {
+				fail("Expected start dio or start pgd, not start", word[1]);
+			}
+			for (n = 2; n < words; n++)
+			{
+				eq = strchr(word[n], '=');
+				if (eq == NULL) fail("Expected genotype=frequency, not", word[n]);
+				*eq = '\0';
+				g = findgenotype(word[n]);
+				if (g < 0) fail("Unknown genotype", word[n]);
+				target[g] = atof(eq + 1);
+			}
+			continue;
+		}
+
+		fail("Unknown statement", word[0]);
+	}
+	fclose(infile);
+
+	linenumber = 0;
+	if (name[0] == '\0') fail("No name given", NULL);
+	if (genotypes == 0) fail("No genotypes declared", NULL);
+	if (have_dio == 0 || have_pgd == 0) fail("Both start dio and start pgd are needed", NULL);
+	if (description[0] == '\0') strcpy(description, name);
+
+	return;
+}
+
+// Work out every genotype's gametes (free recombination between loci), and which haplotypes occur.
+
+void makegametes (void)
+{
+	int g;
+	int j;
+	int locus;
+	int rest;
+	int a;
+	char temp[MAXNAME * MAXLOCI];
+	char * c;
+
+	for (locus = 0; locus < loci; locus++)
+	{
+		haplotypes *= alleles[locus];
+	}
+	if (haplotypes > MAXHAPLOTYPES)
+	{
+		printf("Too many possible gametes (%d); the most that can be handled is %d.\n", haplotypes, MAXHAPLOTYPES);
+		exit(1);
+	}
+
+	for (j = 0; j < haplotypes; j++)
+	{
+		haplotypenames[j][0] = '\0';
+		rest = j;
+		for (locus = loci - 1; locus >= 0; locus--)
+		{
+			a = rest % alleles[locus];
+			rest /= alleles[locus];
+
+			// Built back-to-front, so prepend...
+			strcpy(temp, allelenames[locus][a]);
+			for (c = temp; *c; c++) if (*c == '*') *c = 's';
+			if (locus < loci - 1) strcat(temp, "_");
+			strcat(temp, haplotypenames[j]);
+			strcpy(haplotypenames[j], temp);
+		}
+	}
+
+	for (j = 0; j < haplotypes; j++)
+	{
+		for (a = 0; a < j; a++)
+		{
+			if (strcmp(haplotypenames[a], haplotypenames[j]) == 0)
+			{
+				printf("Allele names clash once * is replaced by s (gamete %s); please rename.\n", haplotypenames[j]);
+				exit(1);
+			}
+		}
+	}
+
+	for (g = 0; g < genotypes; g++)
+	{
+		for (j = 0; j < haplotypes; j++)
+		{
+			gametes[g][j] = 1;
+			rest = j;
+			for (locus = loci - 1; locus >= 0; locus--)
+			{
+				a = rest % alleles[locus];
+				rest /= alleles[locus];
+				gametes[g][j] *= 0.5 * (genotypealleles[g][locus][0] == a) + 0.5 * (genotypealleles[g][locus][1] == a);
+			}
+			if (gametes[g][j] > 0)
+			{
+				if (phenotype[g] != FEMALE) ispollen[j] = 1;
+				if (phenotype[g] != MALE) isegg[j] = 1;
+			}
+		}
+	}
+
+	return;
+}
+
+// Helpers for writing coefficients: " * 0.25" etc, with factors of 1 left out.
+
+char * factor (double value)
+{
+	static char buffer[8][64];
+	static int next = 0;
+
+	next = (next + 1) % 8;
+	if (value == 1) buffer[next][0] = '\0';
+	else sprintf(buffer[next], " * %.10g", value);
+	return buffer[next];
+}
+
+char * hterm (int g)
+{
+	static char buffer[64];
+
+	if (fixedh[g] < 0) return " * h";
+	sprintf(buffer, "%s", factor(fixedh[g]));
+	if (buffer[0] == '\0') return "";
+	return buffer;
+}
+
+char * notcosex (int g)
+{
+	static char buffer[64];
+
+	if (fixedh[g] < 0) return " * (1 - h)";
+	sprintf(buffer, "%s", factor(1 - fixedh[g]));
+	return buffer;
+}
+
+char * selfing (int g)
+{
+	static char buffer[64];
+
+	if (selfingfactor[g] == 1) return "S";
+	sprintf(buffer, "(S * %.10g)", selfingfactor[g]);
+	return buffer;
+}
+
+char * phenotypename (int g)
+{
+	if (phenotype[g] == FEMALE) return "pure females";
+	if (phenotype[g] == MALE) return "pure males";
+	return "inconstants";
+}
+
+void writekernel (FILE * out)
+{
+	int g;
+	int child;
+	int i;
+	int j;
+	int any;
+	double A0, A1, N0, N1;			// Selfing: non-Y and Y pollen, and offspring shares of each
+
+	fprintf(out, "/*\n\nKernel generated by modelgen from %s - edit that rather than this.\n\n%s\n\n*/\n\n\n", inputname, description);
+
+	// The description of the model, for the main program...
+
+	fprintf(out, "const char kernel_name[] = \"%s\";\n", name);
+	fprintf(out, "const char kernel_description[] = \"%s\";\n", description);
+	fprintf(out, "const int kernel_genotypes = %d;\n\n", genotypes);
+
+	fprintf(out, "const char * kernel_genotype_names[%d] = {", genotypes);
+	for (g = 0; g < genotypes; g++) fprintf(out, "%s\"%s\"", g ? ", " : "", genotypenames[g]);
+	fprintf(out, "};\n");
+
+	fprintf(out, "const int kernel_phenotypes[%d] = {", genotypes);
+	for (g = 0; g < genotypes; g++) fprintf(out, "%s%d", g ? ", " : "", phenotype[g]);
+	fprintf(out, "};\t\t// 1 = female, 2 = male, 3 = inconstant\n");
+
+	fprintf(out, "const float kernel_start_dio[%d] = {", genotypes);
+	for (g = 0; g < genotypes; g++) fprintf(out, "%s%.10g", g ? ", " : "", start_dio[g]);
+	fprintf(out, "};\n");
+
+	fprintf(out, "const float kernel_start_pgd[%d] = {", genotypes);
+	for (g = 0; g < genotypes; g++) fprintf(out, "%s%.10g", g ? ", " : "", start_pgd[g]);
+	fprintf(out, "};\n\n");
+
+	// The kernel itself...
+
+	fprintf(out, "void kernel_simulate (float * f, int endpoint, float Q, float F, float h, float S, float d, float V, float PSatF, float ppY)\n{\n");
+
+	fprintf(out, "\t// Plant frequencies...\n");
+	for (g = 0; g < genotypes; g++) fprintf(out, "\tfloat f_%s = f[%d];\n", genotypenames[g], g);
+	fprintf(out, "\t\n");
+	for (g = 0; g < genotypes; g++) fprintf(out, "\tfloat next_f_%s;\n", genotypenames[g]);
+	fprintf(out, "\t\n\t// Pollen frequencies...\n");
+	for (j = 0; j < haplotypes; j++) if (ispollen[j]) fprintf(out, "\tfloat p_%s;\n", haplotypenames[j]);
+	fprintf(out, "\t\n\t// Egg frequencies...\n");
+	for (j = 0; j < haplotypes; j++) if (isegg[j]) fprintf(out, "\tfloat e_%s;\n", haplotypenames[j]);
+	fprintf(out, "\t\n\tfloat PSatC;\t\t\t\t// Pollen saturation point for cosex receivers\n");
+	for (g = 0; g < genotypes; g++)
+	{
+		if (phenotype[g] == INCONSTANT && selfingfactor[g] != 1) fprintf(out, "\tfloat PSatC_%s;\n", genotypenames[g]);
+	}
+	fprintf(out, "\t\n\tfloat totalpollen;\n\tfloat totalplants;\n\tint n;\n\t\n");
+	fprintf(out, "\t(void) Q; (void) F; (void) h; (void) S; (void) d; (void) V; (void) PSatF; (void) ppY;\n\t\n");
+
+	fprintf(out, "\tfor (n = 0; n < endpoint; n++)\n\t{\n");
+
+	// Outcrossed pollen...
+
+	fprintf(out, "\t\t// Outcrossed pollen frequencies....................................................\n\t\t\n");
+	for (j = 0; j < haplotypes; j++) if (ispollen[j]) fprintf(out, "\t\tp_%s = 0;\n", haplotypenames[j]);
+	fprintf(out, "\t\t\n");
+
+	for (g = 0; g < genotypes; g++)
+	{
+		if (phenotype[g] == FEMALE)
+		{
+			fprintf(out, "\t\t// From %s pure females (genotype %d)\n\t\t;\n\t\t\n", genotypenames[g], g + 1);
+		}
+		if (phenotype[g] == MALE)
+		{
+			fprintf(out, "\t\t// From %s pure males (genotype %d)\n", genotypenames[g], g + 1);
+			for (j = 0; j < haplotypes; j++)
+			{
+				if (gametes[g][j] > 0) fprintf(out, "\t\tp_%s += f_%s%s;\n", haplotypenames[j], genotypenames[g], factor(gametes[g][j]));
+			}
+			fprintf(out, "\t\t\n");
+		}
+		if (phenotype[g] == INCONSTANT)
+		{
+			fprintf(out, "\t\t// From %s inconstants (genotype %d) as cosexes\n", genotypenames[g], g + 1);
+			for (j = 0; j < haplotypes; j++)
+			{
+				if (gametes[g][j] > 0) fprintf(out, "\t\tp_%s += f_%s%s%s * Q;\n", haplotypenames[j], genotypenames[g], factor(gametes[g][j]), hterm(g));
+			}
+			fprintf(out, "\t\t\n\t\t// From %s inconstants (genotype %d) as males\n", genotypenames[g], g + 1);
+			for (j = 0; j < haplotypes; j++)
+			{
+				if (gametes[g][j] > 0) fprintf(out, "\t\tp_%s += f_%s%s%s;\n", haplotypenames[j], genotypenames[g], factor(gametes[g][j]), notcosex(g));
+			}
+			fprintf(out, "\t\t\n");
+		}
+	}
+
+	any = 0;
+	for (j = 0; j < haplotypes; j++) if (ispollen[j] && haplotypeisY(j)) any = 1;
+	if (any)
+	{
+		fprintf(out, "\t\t// Apply Y pollen viability penalty.................................................\n\t\t\n");
+		for (j = 0; j < haplotypes; j++) if (ispollen[j] && haplotypeisY(j)) fprintf(out, "\t\tp_%s *= ppY;\n", haplotypenames[j]);
+		fprintf(out, "\t\t\n");
+	}
+
+	fprintf(out, "\t\t// Normalise pollen frequencies to add up to 1......................................\n\t\t\n");
+	fprintf(out, "\t\ttotalpollen =");
+	any = 0;
+	for (j = 0; j < haplotypes; j++) if (ispollen[j]) fprintf(out, "%s p_%s", any++ ? " +" : "", haplotypenames[j]);
+	if (any == 0) fprintf(out, " 0");
+	fprintf(out, ";\n\t\tif (totalpollen > 0)\n\t\t{\n");
+	for (j = 0; j < haplotypes; j++) if (ispollen[j]) fprintf(out, "\t\t\tp_%s /= totalpollen;\n", haplotypenames[j]);
+	fprintf(out, "\t\t}\n\t\t\n");
+
+	// Outcrossed eggs...
+
+	fprintf(out, "\t\t// Outcrossed egg frequencies.......................................................\n\t\t\n");
+	fprintf(out, "\t\t// Calculate pollen required to fertilise a cosex's outcrossing ovules:\n");
+	fprintf(out, "\t\tPSatC = PSatF * F * (1 - S);\n");
+	for (g = 0; g < genotypes; g++)
+	{
+		if (phenotype[g] == INCONSTANT && selfingfactor[g] != 1)
+		{
+			fprintf(out, "\t\tPSatC_%s = PSatF * F * (1 - %s);\n", genotypenames[g], selfing(g));
+		}
+	}
+	fprintf(out, "\t\t\n");
+	for (j = 0; j < haplotypes; j++) if (isegg[j]) fprintf(out, "\t\te_%s = 0;\n", haplotypenames[j]);
+	fprintf(out, "\t\t\n");
+
+	for (g = 0; g < genotypes; g++)
+	{
+		char psat[MAXNAME + 8];
+
+		if (phenotype[g] == MALE)
+		{
+			fprintf(out, "\t\t// From %s pure males (genotype %d)\n\t\t;\n\t\t\n", genotypenames[g], g + 1);
+			continue;
+		}
+
+		if (phenotype[g] == FEMALE)
+		{
+			fprintf(out, "\t\t// From %s pure females (genotype %d)\n", genotypenames[g], g + 1);
+			fprintf(out, "\t\tif (totalpollen >= PSatF)\n\t\t{\n");
+			for (j = 0; j < haplotypes; j++)
+			{
+				if (gametes[g][j] > 0) fprintf(out, "\t\t\te_%s += f_%s%s;\n", haplotypenames[j], genotypenames[g], factor(gametes[g][j]));
+			}
+			fprintf(out, "\t\t} else {\n");
+			for (j = 0; j < haplotypes; j++)
+			{
+				if (gametes[g][j] > 0) fprintf(out, "\t\t\te_%s += f_%s%s * totalpollen / PSatF;\n", haplotypenames[j], genotypenames[g], factor(gametes[g][j]));
+			}
+			fprintf(out, "\t\t}\n\t\t\n");
+			continue;
+		}
+
+		if (selfingfactor[g] == 1) strcpy(psat, "PSatC");
+		else sprintf(psat, "PSatC_%s", genotypenames[g]);
+
+		fprintf(out, "\t\t// From %s inconstants (genotype %d) as cosexes\n", genotypenames[g], g + 1);
+		fprintf(out, "\t\tif (totalpollen >= %s)\n\t\t{\n", psat);
+		for (j = 0; j < haplotypes; j++)
+		{
+			if (gametes[g][j] > 0)
+			{
+				fprintf(out, "\t\t\te_%s += f_%s%s%s * (1 - %s) * F;\n", haplotypenames[j], genotypenames[g], hterm(g), factor(gametes[g][j]), selfing(g));
+			}
+		}
+		fprintf(out, "\t\t} else {\n");
+		for (j = 0; j < haplotypes; j++)
+		{
+			if (gametes[g][j] > 0)
+			{
+				fprintf(out, "\t\t\te_%s += f_%s%s%s * (1 - %s) * F * totalpollen / %s;\n", haplotypenames[j], genotypenames[g], hterm(g), factor(gametes[g][j]), selfing(g), psat);
+			}
+		}
+		fprintf(out, "\t\t}\n\t\t\n");
+	}
+
+	fprintf(out, "\t\t// WE CANNOT AND MUST NOT NORMALISE THE EGG FREQUENCIES, AS WE HAVEN'T\n");
+	fprintf(out, "\t\t// YET CONSIDERED THE SELFED EGGS. BUT WE DON'T NEED TO NORMALISE.\n\t\t\n");
+
+	// Outcrossing...
+
+	fprintf(out, "\t\t// Plant frequencies from outcrossing...............................................\n\t\t\n");
+	for (child = 0; child < genotypes; child++)
+	{
+		fprintf(out, "\t\tnext_f_%s =", genotypenames[child]);
+		any = 0;
+		for (j = 0; j < haplotypes; j++)
+		{
+			for (i = 0; i < haplotypes; i++)
+			{
+				if (ispollen[j] && isegg[i] && offspring(i, j) == child) fprintf(out, "%s p_%s * e_%s", any++ ? " +" : "", haplotypenames[j], haplotypenames[i]);
+			}
+		}
+		fprintf(out, "%s;\n", any ? "" : " 0");
+	}
+	for (j = 0; j < haplotypes; j++)
+	{
+		for (i = 0; i < haplotypes; i++)
+		{
+			if (ispollen[j] && isegg[i] && offspring(i, j) < 0)
+			{
+				printf("Mating of egg %s with pollen %s produces a genotype that has not been declared.\n", haplotypenames[i], haplotypenames[j]);
+				exit(1);
+			}
+		}
+	}
+
+	// Selfing. Within a selfing plant, X and Y pollen compete, so pollen shares are weighted by viability...
+
+	fprintf(out, "\t\t\n\t\t// Additional plants from selfing...................................................\n\t\t\n");
+	for (g = 0; g < genotypes; g++)
+	{
+		if (phenotype[g] != INCONSTANT)
+		{
+			fprintf(out, "\t\t// From %s %s (genotype %d)\n\t\t;\n\t\t\n", genotypenames[g], phenotypename(g), g + 1);
+			continue;
+		}
+
+		fprintf(out, "\t\t// From %s inconstants (genotype %d)\n", genotypenames[g], g + 1);
+
+		A0 = 0;
+		A1 = 0;
+		for (j = 0; j < haplotypes; j++)
+		{
+			if (haplotypeisY(j)) A1 += gametes[g][j];
+			else A0 += gametes[g][j];
+		}
+
+		for (child = 0; child < genotypes; child++)
+		{
+			N0 = 0;
+			N1 = 0;
+			for (i = 0; i < haplotypes; i++)
+			{
+				for (j = 0; j < haplotypes; j++)
+				{
+					if (gametes[g][i] > 0 && gametes[g][j] > 0 && offspring(i, j) == child)
+					{
+						if (haplotypeisY(j)) N1 += gametes[g][i] * gametes[g][j];
+						else N0 += gametes[g][i] * gametes[g][j];
+					}
+				}
+			}
+			if (N0 == 0 && N1 == 0) continue;
+
+			for (i = 0; i < haplotypes; i++)
+			{
+				for (j = 0; j < haplotypes; j++)
+				{
+					if (gametes[g][i] > 0 && gametes[g][j] > 0 && offspring(i, j) < 0)
+					{
+						printf("Selfing of %s produces a genotype that has not been declared.\n", genotypenames[g]);
+						exit(1);
+					}
+				}
+			}
+
+			fprintf(out, "\t\tnext_f_%s += f_%s", genotypenames[child], genotypenames[g]);
+			if (A1 == 0 || A0 == 0)
+			{
+				fprintf(out, "%s", factor(A1 == 0 ? N0 / A0 : N1 / A1));
+			} else if (N1 == 0) {
+				fprintf(out, " * (%.10g / (%.10g + %.10g * ppY))", N0, A0, A1);
+			} else if (N0 == 0) {
+				fprintf(out, " * (%.10g * ppY / (%.10g + %.10g * ppY))", N1, A0, A1);
+			} else {
+				fprintf(out, " * ((%.10g + %.10g * ppY) / (%.10g + %.10g * ppY))", N0, N1, A0, A1);
+			}
+			fprintf(out, " * %s * (1 - d)%s * F;\n", selfing(g), hterm(g));
+		}
+		fprintf(out, "\t\t\n");
+	}
+
+	// YY penalty, copy and normalise...
+
+	any = 0;
+	for (g = 0; g < genotypes; g++) if (genotypeisYY(g)) any = 1;
+	if (any)
+	{
+		fprintf(out, "\t\t// Apply YY penalty.................................................................\n\t\t\n");
+		for (g = 0; g < genotypes; g++) if (genotypeisYY(g)) fprintf(out, "\t\tnext_f_%s *= V;\n", genotypenames[g]);
+		fprintf(out, "\t\t\n");
+	}
+
+	fprintf(out, "\t\t// Copy.............................................................................\n\t\t\n");
+	for (g = 0; g < genotypes; g++) fprintf(out, "\t\tf_%s = next_f_%s;\n", genotypenames[g], genotypenames[g]);
+
+	fprintf(out, "\t\t\n\t\t// Normalise plant frequencies to add up to 1.......................................\n\t\t\n");
+	fprintf(out, "\t\ttotalplants =");
+	for (g = 0; g < genotypes; g++) fprintf(out, "%s f_%s", g ? " +" : "", genotypenames[g]);
+	fprintf(out, ";\n\t\tif (totalplants > 0)\n\t\t{\n");
+	for (g = 0; g < genotypes; g++) fprintf(out, "\t\t\tf_%s /= totalplants;\n", genotypenames[g]);
+	fprintf(out, "\t\t}\n\t}\n\t\n");
+
+	for (g = 0; g < genotypes; g++) fprintf(out, "\tf[%d] = f_%s;\n", g, genotypenames[g]);
+	fprintf(out, "\t\n\treturn;\n}\n");
+
+	return;
+}
+
+int main (int argc, char * argv[])
+{
+	FILE * outfile;
+
+	if (argc != 3)
+	{
+		printf("Usage: %s <model description> <output .c file>\n", argv[0]);
+		exit(1);
+	}
+
+	inputname = argv[1];
+
+	readmodel();
+	makegametes();
+
+	outfile = fopen(argv[2], "w");
+	if (outfile == NULL)
+	{
+		printf("Failed to create output file!\n");
+		exit(1);
+	}
+	writekernel(outfile);
+	fclose(outfile);
+
+	printf("Wrote kernel for %s (%d genotypes) to %s\n", name, genotypes, argv[2]);
+	return 0;
+}
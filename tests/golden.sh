@@ -0,0 +1,80 @@
+#!/bin/sh
+
+# Regression test for the recursion: build both programs, draw a small graph for each of a few
+# canonical parameter sets, and check every cell against the states saved in tests/golden (by
+# --verifystate), and the .bmp against the one saved there. Run from the top of the repository:
+#
+#	sh tests/golden.sh
+#
+# The compiler and options can be changed, e.g. to check a fast build:
+#
+#	CC=gcc CFLAGS="-O3 -ffast-math -march=native" sh tests/golden.sh
+#
+# Set UPDATE=1 to save new golden outputs instead (only from a trusted build, e.g. plain gcc).
+# Exits with status 1 if any cell is classified differently, or any graph differs.
+
+CC=${CC:-gcc}
+CFLAGS=${CFLAGS:-"-O2"}
+UPDATE=${UPDATE:-0}
+SIZE=25
+
+top=$(pwd)
+golden="$top/tests/golden"
+work=$(mktemp -d)
+failed=0
+
+trap 'rm -rf "$work"' EXIT
+
+# Canonical parameter sets: <model> <name> <arguments>
+
+cases="
+1 default
+1 pgd --pgd -V 0
+1 selfing -S 0.5 -d 0.5 -h 0.3
+1 limited --PSatF 4 --ppY 0.5
+2 default
+2 pgd --pgd -V 0
+2 selfing -S 0.5 -d 0.5 -h 0.3
+2 limited --PSatF 4
+"
+
+for model in 1 2
+do
+	if ! $CC $CFLAGS "deterministic_model$model.c" -o "$work/model$model" -lm
+	then
+		echo "Failed to compile deterministic_model$model.c"
+		exit 1
+	fi
+done
+
+cd "$work" || exit 1
+
+echo "$cases" | while read -r model name args
+do
+	[ -z "$model" ] && continue
+	
+	state="model${model}_$name.state"
+	rm -f ./*.bmp
+	
+	if [ "$UPDATE" = 1 ]
+	then
+		# shellcheck disable=SC2086
+		./model$model --subdivisions $SIZE $args --state "$golden/$state" > output.txt || exit 1
+		cp ./*.bmp "$golden/model${model}_$name.bmp"
+		echo "Saved model $model, $name"
+		continue
+	fi
+	
+	# shellcheck disable=SC2086
+	if ./model$model --subdivisions $SIZE $args --verifystate "$golden/$state" > output.txt \
+		&& cmp -s ./*.bmp "$golden/model${model}_$name.bmp"
+	then
+		echo "ok    model $model, $name ($(grep "Largest difference" output.txt | sed 's/^ *//'))"
+	else
+		echo "FAIL  model $model, $name"
+		sed -n '/^Verification/,$p' output.txt
+		exit 1
+	fi
+done || failed=1
+
+exit $failed